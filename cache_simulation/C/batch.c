@@ -0,0 +1,389 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Manifest-driven simulation of many traces on a worker pool
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "report.h"
+
+//=============================================================================
+// MANIFEST
+//
+
+//@pre: none
+//@post: batch holds no traces, configurations or jobs
+//@return: none
+void initBatch(batchRun *batch){
+	memset(batch, 0, sizeof(*batch));
+	initSweep(&batch->configs);
+}
+
+//@pre: a batch set up by initBatch
+//@post: path is appended to the traces
+//@return: false (with a message) if memory is short
+static bool AddBatchTrace(batchRun *batch, const char *path){
+	if (batch->traceCount == batch->traceCapacity) {
+		int capacity = batch->traceCapacity ? 2 * batch->traceCapacity : 16;
+		char **traces = realloc(batch->traces, capacity * sizeof(char *));
+		if (traces == NULL) {
+			fprintf(stderr, "Out of memory for traces\n");
+			return false;
+		}
+		batch->traces = traces;
+		batch->traceCapacity = capacity;
+	}
+	batch->traces[batch->traceCount++] = strdup(path);
+	return true;
+}
+
+//@pre: a trace and a configuration of the batch
+//@post: the pair is appended to the jobs
+//@return: false (with a message) if memory is short
+static bool AddBatchJob(batchRun *batch, int trace, int config){
+	if (batch->jobCount == batch->jobCapacity) {
+		int capacity = batch->jobCapacity ? 2 * batch->jobCapacity : 16;
+		batchJob *jobs = realloc(batch->jobs, capacity * sizeof(batchJob));
+		if (jobs == NULL) {
+			fprintf(stderr, "Out of memory for jobs\n");
+			return false;
+		}
+		batch->jobs = jobs;
+		batch->jobCapacity = capacity;
+	}
+	batch->jobs[batch->jobCount++] = (batchJob){ .trace = trace, .config = config };
+	return true;
+}
+
+//@pre: a configuration that has been through ConfigureHierarchy
+//@return: the bytes a job simulating it is expected to hold
+//@brief: Counts the arrays that grow with the blocks of each level; the
+//        tables of fixed size are covered by the trace allowance.
+static size_t HierarchyStateBytes(const hierarchyConfig *config){
+	size_t bytes = BatchTrace_Bytes;
+	for (int i = 0; i < config->levelCount; i++) {
+		const levelConfig *level = &config->levels[i];
+		size_t blocks = (size_t)level->cache.lines_Nbr * level->cache.associativity;
+		// Tags, a byte of replacement state and the valid and dirty bits
+		bytes += blocks * (sizeof(uint32_t) + 1) + blocks / 4;
+		if (level->cache.associativity >= IndexedSet_MinWays) {
+			// Two index slots and a pair of recency links per way
+			bytes += blocks * (2 * sizeof(tagSlot) + 2 * sizeof(uint32_t));
+		}
+		if (level->prefetch.kind != PREFETCH_NONE) {
+			bytes += blocks * sizeof(uint64_t);
+		}
+	}
+	return bytes;
+}
+
+//@pre: a batch set up by initBatch; defaults holds the configurations of the
+//      traces the manifest gives none for
+//@post: every line of the manifest at path is added as one job per
+//       configuration
+//@return: false (with a message) if the file cannot be read, holds a bad
+//         configuration or no traces
+bool LoadBatchManifest(batchRun *batch, const char *path, const cacheSweep *defaults){
+	bool ok = true;
+	for (int i = 0; ok && i < defaults->count; i++) {
+		const char *spec = defaults->specs[i];
+		ok = AddSweepConfig(&batch->configs, spec != NULL ? spec : "", &defaults->configs[i]);
+	}
+	batch->defaultConfigs = batch->configs.count;
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		perror(path);
+		return false;
+	}
+
+	char text[4096];
+	int line = 0;
+	while (ok && fgets(text, sizeof(text), file) != NULL) {
+		line++;
+		text[strcspn(text, "#\r\n")] = '\0';
+		char *trace = text + strspn(text, " \t");
+		char *spec = trace + strcspn(trace, " \t");
+		if (*spec != '\0') {
+			*spec++ = '\0';
+			spec += strspn(spec, " \t");
+		}
+		size_t length = strlen(spec);
+		while (length > 0 && (spec[length - 1] == ' ' || spec[length - 1] == '\t')) {
+			spec[--length] = '\0';
+		}
+		if (*trace == '\0') {
+			continue;
+		}
+		ok = AddBatchTrace(batch, trace);
+		if (ok && length > 0) {
+			ok = AddSweepSpec(&batch->configs, spec) && AddBatchJob(batch, batch->traceCount - 1,
+				batch->configs.count - 1);
+		}
+		for (int i = 0; ok && length == 0 && i < batch->defaultConfigs; i++) {
+			ok = AddBatchJob(batch, batch->traceCount - 1, i);
+		}
+		if (!ok) {
+			fprintf(stderr, "(on line %d of %s)\n", line, path);
+		}
+	}
+	fclose(file);
+	if (ok && batch->jobCount == 0) {
+		fprintf(stderr, "%s lists no traces\n", path);
+		ok = false;
+	}
+
+	batch->levels = 1;
+	for (int i = 0; ok && i < batch->jobCount; i++) {
+		const hierarchyConfig *config = &batch->configs.configs[batch->jobs[i].config];
+		batch->jobs[i].stateBytes = HierarchyStateBytes(config);
+		if (config->levelCount > batch->levels) {
+			batch->levels = config->levelCount;
+		}
+	}
+	return ok;
+}
+
+//@pre: a batch set up by initBatch
+//@post: all traces, configurations, jobs and rows are released
+//@return: none
+void destroyBatch(batchRun *batch){
+	for (int i = 0; i < batch->traceCount; i++) {
+		free(batch->traces[i]);
+	}
+	for (int i = 0; i < batch->jobCount; i++) {
+		free(batch->jobs[i].row);
+	}
+	destroySweep(&batch->configs);
+	free(batch->traces);
+	free(batch->jobs);
+	free(batch->finishOrder);
+	initBatch(batch);
+}
+
+//=============================================================================
+// ROWS
+//
+
+//@pre: a job whose hierarchy has simulated its trace
+//@post: none
+//@return: the row of the job, without a line end, or NULL if memory is short
+static char *FormatRow(const batchRun *batch, const batchJob *job, const cacheHierarchy *hierarchy){
+	char *row = NULL;
+	size_t length = 0;
+	FILE *out = open_memstream(&row, &length);
+	if (out == NULL) {
+		return NULL;
+	}
+	const char *trace = batch->traces[job->trace];
+	const char *spec = batch->configs.specs[job->config];
+	if (!batch->json) {
+		WriteCsvString(out, trace);
+		fputc(',', out);
+		WriteSweepRow(out, spec, hierarchy, batch->levels);
+		fprintf(out, ",%.6f", job->seconds);
+		fclose(out);
+		return row;
+	}
+	fprintf(out, "{\"trace\": ");
+	WriteJsonString(out, trace);
+	fprintf(out, ", \"config\": ");
+	WriteJsonString(out, spec);
+	fprintf(out, ", \"accesses\": %llu, \"seconds\": %.6f,\n   \"levels\": [", (unsigned long long)job->accesses,
+		job->seconds);
+	for (int level = 0; level < hierarchy->levelCount; level++) {
+		const cacheLevel *cache = &hierarchy->levels[level];
+		uint64_t accesses = cache->hits + cache->misses;
+		fprintf(out, "%s{\"hits\": %llu, \"misses\": %llu, \"hit_ratio\": %.6f, \"writeback_bytes\": %llu,"
+			" \"writethrough_bytes\": %llu, \"prefetches\": %llu, \"prefetch_useful\": %llu}",
+			level > 0 ? ",\n    " : "", (unsigned long long)cache->hits, (unsigned long long)cache->misses,
+			accesses ? (double)cache->hits / accesses : 0.0, (unsigned long long)cache->writebackBytes,
+			(unsigned long long)cache->writeThroughBytes, (unsigned long long)hierarchy->prefetchers[level].issued,
+			(unsigned long long)hierarchy->prefetchers[level].useful);
+	}
+	fprintf(out, "]}");
+	fclose(out);
+	return row;
+}
+
+//=============================================================================
+// WORKERS
+//
+
+//@pre: a loaded batch and one of its jobs
+//@post: the job's trace has been simulated on a hierarchy of its own and its
+//       row and counts are set; the row stays NULL (with a message) if the
+//       hierarchy or the trace could not be set up or the trace could not
+//       be read to its end
+//@return: none
+static void RunJob(const batchRun *batch, batchJob *job){
+	const char *path = batch->traces[job->trace];
+	cacheHierarchy hierarchy;
+	if (!buildHierarchy(&hierarchy, &batch->configs.configs[job->config])) {
+		fprintf(stderr, "Unable to allocate configuration \"%s\"\n", batch->configs.specs[job->config]);
+		return;
+	}
+	traceReader trace;
+	if (!OpenTrace(&trace, path, batch->traceFlags)) {
+		destroyHierarchy(&hierarchy);
+		return;
+	}
+
+	double start = Now();
+	traceBatch items;
+	while (NextTraceBatch(&trace, &items) > 0) {
+		SimulateHierarchy(&hierarchy, &items);
+	}
+	job->seconds = Now() - start;
+	bool failed = trace.failed;
+	CloseTrace(&trace);
+	if (failed) {
+		fprintf(stderr, "Unable to read all of %s\n", path);
+		destroyHierarchy(&hierarchy);
+		return;
+	}
+
+	const cacheLevel *l1 = &hierarchy.levels[0];
+	job->accesses = l1->hits + l1->misses;
+	job->hitRatio = job->accesses ? (double)l1->hits / job->accesses : 0.0;
+	job->row = FormatRow(batch, job, &hierarchy);
+	if (job->row == NULL) {
+		fprintf(stderr, "Out of memory for the row of %s\n", path);
+	}
+	destroyHierarchy(&hierarchy);
+}
+
+//@pre: a batch being run by RunBatch
+//@post: jobs were taken in order and run until none were left
+//@return: NULL
+static void *BatchWorkerMain(void *argument){
+	batchRun *batch = argument;
+	pthread_mutex_lock(&batch->lock);
+	while (batch->next < batch->jobCount) {
+		batchJob *job = &batch->jobs[batch->next];
+		if (batch->running > 0 && batch->reserved + job->stateBytes > batch->memoryBudget) {
+			pthread_cond_wait(&batch->changed, &batch->lock);
+			continue;
+		}
+		batch->next++;
+		batch->reserved += job->stateBytes;
+		batch->running++;
+		pthread_mutex_unlock(&batch->lock);
+
+		RunJob(batch, job);
+
+		pthread_mutex_lock(&batch->lock);
+		batch->reserved -= job->stateBytes;
+		batch->running--;
+		job->finished = true;
+		batch->finishOrder[batch->finished++] = (int)(job - batch->jobs);
+		pthread_cond_broadcast(&batch->changed);
+	}
+	pthread_mutex_unlock(&batch->lock);
+	return NULL;
+}
+
+//@pre: a loaded batch; workers below 1 for one per online core
+//@post: every job has run on a pool of at most workers threads, its row
+//       written to out in manifest order under a CSV header or in one JSON
+//       array, and its progress noted on stderr
+//@return: false (with a message) if the workers could not start or any job
+//         failed
+bool RunBatch(batchRun *batch, int workers, unsigned traceFlags, FILE *out, bool json){
+	batch->traceFlags = traceFlags;
+	batch->json = json;
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long pageBytes = sysconf(_SC_PAGESIZE);
+	batch->memoryBudget = pages > 0 && pageBytes > 0 ? (size_t)pages * (size_t)pageBytes / 2 : SIZE_MAX;
+	if (workers < 1) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		workers = cores > 0 ? (int)cores : 1;
+	}
+	if (workers > batch->jobCount) {
+		workers = batch->jobCount;
+	}
+	batch->finishOrder = malloc(batch->jobCount * sizeof(int));
+	pthread_t *threads = malloc(workers * sizeof(pthread_t));
+	if (batch->finishOrder == NULL || threads == NULL) {
+		fprintf(stderr, "Unable to allocate the batch\n");
+		free(threads);
+		return false;
+	}
+	pthread_mutex_init(&batch->lock, NULL);
+	pthread_cond_init(&batch->changed, NULL);
+	int started = 0;
+	while (started < workers && pthread_create(&threads[started], NULL, BatchWorkerMain, batch) == 0) {
+		started++;
+	}
+	if (started == 0) {
+		fprintf(stderr, "Unable to start the batch workers\n");
+		pthread_mutex_destroy(&batch->lock);
+		pthread_cond_destroy(&batch->changed);
+		free(threads);
+		return false;
+	}
+	fprintf(stderr, "Batch: %d jobs of %d traces on %d worker%s\n", batch->jobCount, batch->traceCount, started,
+		started > 1 ? "s" : "");
+
+	if (json) {
+		fprintf(out, "[");
+	}
+	else {
+		fprintf(out, "trace,");
+		WriteSweepColumns(out, batch->levels);
+		fprintf(out, ",seconds\n");
+	}
+	double start = Now();
+	int written = 0;
+	int rows = 0;
+	int reported = 0;
+	int failed = 0;
+	pthread_mutex_lock(&batch->lock);
+	while (written < batch->jobCount) {
+		for (; reported < batch->finished; reported++) {
+			const batchJob *job = &batch->jobs[batch->finishOrder[reported]];
+			const char *spec = batch->configs.specs[job->config];
+			fprintf(stderr, "[%d/%d] %s %s: ", reported + 1, batch->jobCount, batch->traces[job->trace],
+				*spec != '\0' ? spec : "(command line configuration)");
+			if (job->row == NULL) {
+				fprintf(stderr, "failed\n");
+				continue;
+			}
+			fprintf(stderr, "%llu accesses, L1 hit ratio %.4f, %.2f s\n", (unsigned long long)job->accesses,
+				job->hitRatio, job->seconds);
+		}
+		for (; written < batch->jobCount && batch->jobs[written].finished; written++) {
+			const batchJob *job = &batch->jobs[written];
+			if (job->row == NULL) {
+				failed++;
+				continue;
+			}
+			if (json) {
+				fprintf(out, "%s\n  %s", rows > 0 ? "," : "", job->row);
+			}
+			else {
+				fprintf(out, "%s\n", job->row);
+			}
+			rows++;
+		}
+		fflush(out);
+		if (written < batch->jobCount) {
+			pthread_cond_wait(&batch->changed, &batch->lock);
+		}
+	}
+	pthread_mutex_unlock(&batch->lock);
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&batch->lock);
+	pthread_cond_destroy(&batch->changed);
+	free(threads);
+	if (json) {
+		fprintf(out, "\n]\n");
+	}
+
+	fprintf(stderr, "Batch: %d jobs, %d failed, %.2f s\n", batch->jobCount, failed, Now() - start);
+	return failed == 0;
+}
@@ -0,0 +1,93 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Many traces and configurations simulated on a pool of worker threads
+//
+//	Description:
+//			A manifest lists the traces to simulate, one per line, each
+//			optionally followed by a configuration in the -M syntax:
+//
+//			    # trace            configuration
+//			    traces/gcc.bin     size=32K,ways=8 ; size=1M,ways=16
+//			    traces/mcf.rec
+//
+//			A trace without a configuration runs against every configuration
+//			given with -M or -m, or the command line configuration without
+//			any. Every (trace, configuration) pair is one job.
+//
+//			Workers take the jobs in manifest order. Each builds a hierarchy
+//			of its own for the job and destroys it when done, so workers
+//			share nothing but the queue. Before starting a job a worker
+//			reserves its estimated memory (the state arrays of the hierarchy
+//			and the buffers of the trace reader) against a budget of half the
+//			physical memory. A job that does not fit waits for running jobs
+//			to release theirs, unless nothing else is running. Traces are
+//			mapped, so workers reading the same trace share its pages.
+//
+//			The main thread writes one row per job in manifest order
+//			whatever order they finish in, and notes each job on stderr as
+//			it finishes. Rows are CSV, the trace followed by the -M columns
+//			and the seconds the job took, or the objects of one JSON array.
+//
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "sweep.h"
+
+//
+//	Memory a trace reader may hold besides the mapped trace: the chunks and
+//	decoded batch of a packed trace, or the buffer of a streamed one
+//
+#define  BatchTrace_Bytes  ( 16 << 20 )
+
+typedef struct batchJob
+{
+	int trace;
+	int config;
+	size_t stateBytes;
+
+	//set by the worker that ran it; row is NULL if the job failed
+	char *row;
+	bool finished;
+	double seconds;
+	uint64_t accesses;
+	double hitRatio;
+} batchJob;
+
+typedef struct batchRun
+{
+	//configurations of the jobs, the defaults first
+	cacheSweep configs;
+	int defaultConfigs;
+	char **traces;
+	int traceCount;
+	int traceCapacity;
+	batchJob *jobs;
+	int jobCount;
+	int jobCapacity;
+	//most levels of any configuration, the CSV column count
+	int levels;
+
+	unsigned traceFlags;
+	bool json;
+	size_t memoryBudget;
+
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	//next job to start, bytes reserved by the running jobs and their number
+	int next;
+	size_t reserved;
+	int running;
+	//jobs in the order they finished
+	int *finishOrder;
+	int finished;
+} batchRun;
+
+void initBatch(batchRun *batch);
+bool LoadBatchManifest(batchRun *batch, const char *path, const cacheSweep *defaults);
+bool RunBatch(batchRun *batch, int workers, unsigned traceFlags, FILE *out, bool json);
+void destroyBatch(batchRun *batch);
+
+#endif /* BATCH_H_ */
@@ -0,0 +1,403 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Throughput benchmark of the simulator core
+//
+//	Description:
+//			Every generated stream (-g) is generated into memory once per
+//			size (-n) and then run through every configuration (-M) with
+//			SimulateHierarchy, as cachesim runs a single configuration. Only
+//			the simulation is timed. Each case runs in a child process of its
+//			own so that the peak resident set reported is the case's (the
+//			trace in memory included, reported as trace_bytes); the
+//			fastest of the repetitions (-r), each on a freshly built
+//			hierarchy, is reported.
+//
+//			Cycles come from a perf_event_open counter of the CPU cycles
+//			spent in user mode where the kernel allows it, else from the
+//			time stamp counter (rdtsc, which counts reference cycles), else
+//			they are left out. The results are written as one JSON document.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "hierarchy.h"
+#include "report.h"
+#include "trace.h"
+
+#define  Default_BenchRepetitions  3
+#define  BenchItems_Max            64
+
+//
+//	Streams and configurations run when none are given
+//
+static const char *DefaultGenerators[] = {
+	"sequential",
+	"uniform,footprint=64M",
+	"zipf,footprint=64M,alpha=0.9",
+};
+
+static const char *DefaultConfigs[] = {
+	"size=32K,ways=3",
+	"size=32K,ways=8,replacement=lru",
+	"size=1M,ways=64,replacement=lru",
+	"size=32K,ways=8,replacement=lru;size=256K,ways=8;size=8M,ways=16,replacement=srrip",
+};
+
+static const char *DefaultSizes = "1M,4M,16M";
+
+typedef enum {CYCLES_NONE = 0, CYCLES_PERF, CYCLES_TSC} cycleSource;
+
+static const char *CycleSourceNames[] = { "none", "perf", "rdtsc" };
+
+//A generated stream held in memory
+typedef struct benchTrace
+{
+	void *items;
+	size_t count;
+	size_t itemBytes;
+} benchTrace;
+
+//Result of one case, as the child sends it to the parent
+typedef struct benchResult
+{
+	bool ok;
+	double seconds;
+	uint64_t cycles;
+	cycleSource source;
+	uint64_t hits;
+	uint64_t misses;
+} benchResult;
+
+//=============================================================================
+// MEASUREMENT
+//
+
+//@pre: none
+//@post: a disabled counter of the user mode CPU cycles of this process is open
+//@return: its file descriptor, or -1 if the kernel does not allow one
+static int OpenCycleCounter(void){
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+//@return: the time stamp counter, or 0 where there is none
+static inline uint64_t ReadTsc(void){
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+//=============================================================================
+// CASES
+//
+
+//@pre: spec is a generator spec without a count
+//@post: trace holds the first count accesses of the stream
+//@return: false (with a message) if the spec is bad or memory is short
+static bool GenerateTrace(benchTrace *trace, const char *spec, uint64_t count){
+	char full[512];
+	snprintf(full, sizeof(full), "%s,count=%llu", spec, (unsigned long long)count);
+	traceReader reader;
+	memset(trace, 0, sizeof(*trace));
+	if (!OpenGeneratedTrace(&reader, full)) {
+		return false;
+	}
+	trace->itemBytes = TraceHasRecords(&reader) ? sizeof(traceRecord) : sizeof(uint32_t);
+	trace->items = malloc(count * trace->itemBytes);
+	if (trace->items == NULL) {
+		fprintf(stderr, "Unable to hold %llu accesses in memory\n", (unsigned long long)count);
+		CloseTrace(&reader);
+		return false;
+	}
+	traceBatch batch;
+	while (NextTraceBatch(&reader, &batch) > 0) {
+		const void *items = batch.records != NULL ? (const void *)batch.records : (const void *)batch.addresses;
+		memcpy((uint8_t *)trace->items + trace->count * trace->itemBytes, items, batch.count * trace->itemBytes);
+		trace->count += batch.count;
+	}
+	CloseTrace(&reader);
+	return true;
+}
+
+//@pre: a generated trace and a configured hierarchy
+//@post: the trace is run through a new hierarchy repetitions times
+//@return: the fastest run, with the L1 counters of the last one
+static benchResult RunCase(const benchTrace *trace, const hierarchyConfig *config, int repetitions){
+	benchResult result = { false, 0.0, 0, CYCLES_NONE, 0, 0 };
+	int counter = OpenCycleCounter();
+	result.source = counter >= 0 ? CYCLES_PERF : ReadTsc() != 0 ? CYCLES_TSC : CYCLES_NONE;
+	for (int rep = 0; rep < repetitions; rep++) {
+		cacheHierarchy hierarchy;
+		if (!buildHierarchy(&hierarchy, config)) {
+			fprintf(stderr, "Unable to allocate the hierarchy\n");
+			result.ok = false;
+			break;
+		}
+		if (counter >= 0) {
+			ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+			ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+		}
+		uint64_t tscStart = ReadTsc();
+		double start = Now();
+		for (size_t done = 0; done < trace->count; done += TraceBatch_Nbr) {
+			size_t count = trace->count - done < TraceBatch_Nbr ? trace->count - done : TraceBatch_Nbr;
+			const uint8_t *items = (const uint8_t *)trace->items + done * trace->itemBytes;
+			traceBatch batch = { NULL, NULL, count };
+			if (trace->itemBytes == sizeof(traceRecord)) {
+				batch.records = (const traceRecord *)items;
+			}
+			else {
+				batch.addresses = (const uint32_t *)items;
+			}
+			SimulateHierarchy(&hierarchy, &batch);
+		}
+		double seconds = Now() - start;
+		uint64_t cycles = ReadTsc() - tscStart;
+		if (counter >= 0) {
+			ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+			if (read(counter, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+				cycles = 0;
+			}
+		}
+		if (!result.ok || seconds < result.seconds) {
+			result.seconds = seconds;
+			result.cycles = cycles;
+		}
+		result.ok = true;
+		result.hits = hierarchy.levels[0].hits;
+		result.misses = hierarchy.levels[0].misses;
+		destroyHierarchy(&hierarchy);
+	}
+	if (counter >= 0) {
+		close(counter);
+	}
+	return result;
+}
+
+//@pre: a generated trace and a configured hierarchy
+//@post: the case has run in a child process
+//@return: its result, and the child's peak resident set in *peakKb
+static benchResult ForkCase(const benchTrace *trace, const hierarchyConfig *config, int repetitions,
+	long *peakKb){
+	benchResult result = { false, 0.0, 0, CYCLES_NONE, 0, 0 };
+	*peakKb = 0;
+	int channel[2];
+	if (pipe(channel) != 0) {
+		perror("pipe");
+		return result;
+	}
+	fflush(NULL);
+	pid_t child = fork();
+	if (child < 0) {
+		perror("fork");
+		close(channel[0]);
+		close(channel[1]);
+		return result;
+	}
+	if (child == 0) {
+		close(channel[0]);
+		benchResult measured = RunCase(trace, config, repetitions);
+		bool sent = write(channel[1], &measured, sizeof(measured)) == sizeof(measured);
+		_exit(sent ? 0 : 1);
+	}
+
+	close(channel[1]);
+	if (read(channel[0], &result, sizeof(result)) != sizeof(result)) {
+		result.ok = false;
+	}
+	close(channel[0]);
+	int status = 0;
+	struct rusage usage;
+	if (wait4(child, &status, 0, &usage) == child) {
+		*peakKb = usage.ru_maxrss;
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		result.ok = false;
+	}
+	return result;
+}
+
+//=============================================================================
+// OUTPUT
+//
+
+//@pre: an open output with a "cases" array begun; first if no case was
+//      written yet
+//@post: the case is written as one JSON object
+//@return: none
+static void WriteCase(FILE *output, bool first, const char *generator, const benchTrace *trace,
+	const char *config, const benchResult *result, long peakKb){
+	double accesses = (double)trace->count;
+	fprintf(output, "%s\n    {\"generator\": ", first ? "" : ",");
+	WriteJsonString(output, generator);
+	fprintf(output, ", \"accesses\": %zu, \"records\": %s, \"config\": ", trace->count,
+		trace->itemBytes == sizeof(traceRecord) ? "true" : "false");
+	WriteJsonString(output, config);
+	fprintf(output, ",\n     \"seconds\": %.6f, \"accesses_per_second\": %.0f, \"ns_per_access\": %.3f, ",
+		result->seconds, accesses / result->seconds, 1e9 * result->seconds / accesses);
+	if (result->source != CYCLES_NONE && result->cycles > 0) {
+		fprintf(output, "\"cycles_per_access\": %.3f, ", result->cycles / accesses);
+	}
+	else {
+		fprintf(output, "\"cycles_per_access\": null, ");
+	}
+	fprintf(output, "\"cycle_source\": \"%s\",\n     \"peak_rss_kb\": %ld, \"trace_bytes\": %zu, \"l1_hits\": %llu, \"l1_misses\": %llu}",
+		CycleSourceNames[result->source], peakKb, trace->count * trace->itemBytes, (unsigned long long)result->hits,
+		(unsigned long long)result->misses);
+}
+
+void PrintUsage (const char *program) {
+	printf("USAGE: %s [options]\n", program);
+	printf("  -g <spec>   add a generated stream, without a count (see cachesim -h)\n");
+	printf("  -n <sizes>  comma separated accesses per stream, e.g. 1M,4M (default %s)\n", DefaultSizes);
+	printf("  -M <spec>   add a configuration, levels separated by ';' as in cachesim -M\n");
+	printf("  -r <n>      repetitions of every case; the fastest is kept (default %d)\n",
+		Default_BenchRepetitions);
+	printf("  -L <label>  label recorded in the results, e.g. a version\n");
+	printf("  -o <file>   write the JSON results to a file instead of stdout\n");
+	printf("Without -g or -M a default set of streams and configurations is run.\n");
+}
+
+//=============================================================================
+//
+//	Main function
+//
+int main (int argc, char * const argv[]) {
+	const char *generators[BenchItems_Max];
+	const char *configSpecs[BenchItems_Max];
+	int generatorCount = 0;
+	int configCount = 0;
+	const char *sizeList = DefaultSizes;
+	const char *label = "";
+	const char *outputName = NULL;
+	int repetitions = Default_BenchRepetitions;
+	int option;
+	while ((option = getopt(argc, argv, "g:n:M:r:L:o:h")) != -1) {
+		switch (option) {
+			case 'g':
+			case 'M':
+				if ((option == 'g' ? generatorCount : configCount) == BenchItems_Max) {
+					fprintf(stderr, "At most %d streams and %d configurations\n", BenchItems_Max, BenchItems_Max);
+					return 2;
+				}
+				if (option == 'g') {
+					generators[generatorCount++] = optarg;
+				}
+				else {
+					configSpecs[configCount++] = optarg;
+				}
+				break;
+			case 'n': sizeList = optarg; break;
+			case 'r':
+				repetitions = atoi(optarg);
+				if (repetitions < 1) {
+					fprintf(stderr, "Repetitions must be at least 1\n");
+					return 2;
+				}
+				break;
+			case 'L': label = optarg; break;
+			case 'o': outputName = optarg; break;
+			case 'h': PrintUsage(argv[0]); return 0;
+			default: return 2;
+		}
+	}
+	if (generatorCount == 0) {
+		generatorCount = (int)(sizeof(DefaultGenerators) / sizeof(DefaultGenerators[0]));
+		memcpy(generators, DefaultGenerators, sizeof(DefaultGenerators));
+	}
+	if (configCount == 0) {
+		configCount = (int)(sizeof(DefaultConfigs) / sizeof(DefaultConfigs[0]));
+		memcpy(configSpecs, DefaultConfigs, sizeof(DefaultConfigs));
+	}
+
+	uint64_t sizes[BenchItems_Max];
+	int sizeCount = 0;
+	char *sizeCopy = strdup(sizeList);
+	char *saveptr = NULL;
+	bool ok = true;
+	for (char *item = strtok_r(sizeCopy, ",", &saveptr); ok && item != NULL; item = strtok_r(NULL, ",", &saveptr)) {
+		ok = sizeCount < BenchItems_Max && ParseSize(item, &sizes[sizeCount]) && sizes[sizeCount] > 0;
+		if (!ok) {
+			fprintf(stderr, "Bad stream size: %s\n", item);
+		}
+		sizeCount++;
+	}
+	free(sizeCopy);
+
+	hierarchyConfig configs[BenchItems_Max];
+	for (int i = 0; ok && i < configCount; i++) {
+		ok = ParseHierarchySpec(&configs[i], configSpecs[i]) && ConfigureHierarchy(&configs[i]);
+		if (!ok) {
+			fprintf(stderr, "(in configuration \"%s\")\n", configSpecs[i]);
+		}
+	}
+	if (!ok) {
+		return 2;
+	}
+
+	FILE *output = stdout;
+	if (outputName != NULL && (output = fopen(outputName, "w")) == NULL) {
+		perror(outputName);
+		return 2;
+	}
+	char date[32];
+	time_t now = time(NULL);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+	fprintf(output, "{\n  \"benchmark\": \"cachebench\",\n  \"label\": ");
+	WriteJsonString(output, label);
+	fprintf(output, ",\n  \"date\": \"%s\",\n  \"repetitions\": %d,\n  \"batch_accesses\": %d,\n  \"cases\": [",
+		date, repetitions, TraceBatch_Nbr);
+
+	bool first = true;
+	for (int g = 0; ok && g < generatorCount; g++) {
+		for (int s = 0; ok && s < sizeCount; s++) {
+			benchTrace trace;
+			if (!GenerateTrace(&trace, generators[g], sizes[s])) {
+				ok = false;
+				break;
+			}
+			for (int c = 0; ok && c < configCount; c++) {
+				long peakKb = 0;
+				benchResult result = ForkCase(&trace, &configs[c], repetitions, &peakKb);
+				if (!result.ok) {
+					fprintf(stderr, "Case failed: %s, %zu accesses, %s\n", generators[g], trace.count, configSpecs[c]);
+					ok = false;
+					break;
+				}
+				WriteCase(output, first, generators[g], &trace, configSpecs[c], &result, peakKb);
+				first = false;
+				fprintf(stderr, "%-32s %10zu  %-40s %8.2f ns/access\n", generators[g], trace.count,
+					configSpecs[c], 1e9 * result.seconds / trace.count);
+			}
+			free(trace.items);
+		}
+	}
+	fprintf(output, "\n  ]\n}\n");
+	if (output != stdout && fclose(output) != 0) {
+		perror(outputName);
+		ok = false;
+	}
+	return ok ? 0 : 2;
+}
@@ -0,0 +1,673 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Cache configuration, construction and lookup for the cache simulation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "cache.h"
+
+//=============================================================================
+// CONFIGURATION
+//
+
+//@pre: none
+//@post: config holds the geometry the simulator used to be compiled with
+//@return: none
+void DefaultCacheConfig(cacheConfig *config){
+	memset(config, 0, sizeof(*config));
+	config->cacheSize_Exp = Default_CacheSize_Exp;
+	config->addressSize_Exp = Default_AddressSize_Exp;
+	config->associativity = Default_Associativity;
+	config->blockSize_Exp = Default_BlockSize_Exp;
+	config->replacement = Default_Replacement;
+	config->writeBack = Default_WriteBack;
+	config->writeAllocate = Default_WriteAllocate;
+}
+
+//@pre: a string such as "64", "32K" or "8M"
+//@post: *value holds the number of bytes
+//@return: true if the string was a number with an optional K/M/G suffix
+bool ParseSize(const char *text, uint64_t *value){
+	char *end;
+	unsigned long long number = strtoull(text, &end, 0);
+	if (end == text) {
+		return false;
+	}
+	switch (toupper((unsigned char)*end)) {
+		case 'K': number <<= 10; end++; break;
+		case 'M': number <<= 20; end++; break;
+		case 'G': number <<= 30; end++; break;
+		default: break;
+	}
+	if (toupper((unsigned char)*end) == 'B') {
+		end++;
+	}
+	*value = number;
+	return *end == '\0';
+}
+
+//@pre: text of a whole number, such as "4"
+//@post: *value holds it
+//@return: false unless text is a number from least to most
+bool ParseCount(const char *text, uint32_t least, uint32_t most, uint32_t *value){
+	char *end = NULL;
+	unsigned long number = strtoul(text, &end, 10);
+	if (end == text || *end != '\0' || number < least || number > most) {
+		return false;
+	}
+	*value = (uint32_t)number;
+	return true;
+}
+
+//@pre: text such as "4:14:40"
+//@post: the first values are replaced by the numbers of text
+//@return: false if text is not a list of up to count numbers
+bool ParseNumberList(const char *text, uint32_t *values, int count){
+	const char *cursor = text;
+	for (int i = 0; i < count; i++) {
+		char *end = NULL;
+		unsigned long value = strtoul(cursor, &end, 10);
+		if (end == cursor) {
+			return false;
+		}
+		values[i] = (uint32_t)value;
+		if (*end == '\0') {
+			return true;
+		}
+		if (*end != ':') {
+			return false;
+		}
+		cursor = end + 1;
+	}
+	return false;
+}
+
+//@pre: a power of two
+//@return: its base 2 logarithm, or -1 if value is not a power of two
+static int ExponentOf(uint64_t value){
+	if (value == 0 || (value & (value - 1)) != 0) {
+		return -1;
+	}
+	return __builtin_ctzll(value);
+}
+
+//@pre: a string such as "yes" or "off"
+//@post: *value holds its truth value
+//@return: false if the string is not a yes/no word
+static bool ParseFlag(const char *text, bool *value){
+	static const char *Yes[] = { "yes", "true", "on", "1" };
+	static const char *No[] = { "no", "false", "off", "0" };
+	for (size_t i = 0; i < sizeof(Yes) / sizeof(Yes[0]); i++) {
+		if (strcasecmp(text, Yes[i]) == 0) {
+			*value = true;
+			return true;
+		}
+		if (strcasecmp(text, No[i]) == 0) {
+			*value = false;
+			return true;
+		}
+	}
+	return false;
+}
+
+//@pre: key is one of cache_size, block_size, associativity, address_size,
+//      replacement, write_policy, write_allocate
+//@post: the matching input field of config is set; derived fields are stale
+//@return: false (with a message) if the key or value is not understood
+bool SetCacheOption(cacheConfig *config, const char *key, const char *value){
+	if (strcasecmp(key, "replacement") == 0 || strcasecmp(key, "policy") == 0) {
+		if (!ParseReplacementPolicy(value, &config->replacement)) {
+			fprintf(stderr, "Unknown replacement policy: %s\n", value);
+			return false;
+		}
+		return true;
+	}
+	if (strcasecmp(key, "write_policy") == 0 || strcasecmp(key, "write") == 0) {
+		if (strcasecmp(value, "writeback") == 0 || strcasecmp(value, "wb") == 0) {
+			config->writeBack = true;
+		}
+		else if (strcasecmp(value, "writethrough") == 0 || strcasecmp(value, "wt") == 0) {
+			config->writeBack = false;
+		}
+		else {
+			fprintf(stderr, "Unknown write policy: %s\n", value);
+			return false;
+		}
+		return true;
+	}
+	if (strcasecmp(key, "write_allocate") == 0 || strcasecmp(key, "allocate") == 0) {
+		if (!ParseFlag(value, &config->writeAllocate)) {
+			fprintf(stderr, "Bad value for %s: %s\n", key, value);
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t number;
+	if (!ParseSize(value, &number)) {
+		fprintf(stderr, "Bad value for %s: %s\n", key, value);
+		return false;
+	}
+
+	if (strcasecmp(key, "cache_size") == 0 || strcasecmp(key, "size") == 0) {
+		int exp = ExponentOf(number);
+		if (exp < 0) {
+			fprintf(stderr, "cache_size must be a power of two: %s\n", value);
+			return false;
+		}
+		config->cacheSize_Exp = exp;
+	}
+	else if (strcasecmp(key, "block_size") == 0 || strcasecmp(key, "block") == 0) {
+		int exp = ExponentOf(number);
+		if (exp < 0) {
+			fprintf(stderr, "block_size must be a power of two: %s\n", value);
+			return false;
+		}
+		config->blockSize_Exp = exp;
+	}
+	else if (strcasecmp(key, "associativity") == 0 || strcasecmp(key, "ways") == 0) {
+		if (number == 0) {
+			fprintf(stderr, "associativity must be at least 1\n");
+			return false;
+		}
+		config->associativity = (uint32_t)number;
+	}
+	else if (strcasecmp(key, "address_size") == 0 || strcasecmp(key, "address_bits") == 0) {
+		if (number == 0 || number > 64) {
+			fprintf(stderr, "address_size must be between 1 and 64 bits\n");
+			return false;
+		}
+		config->addressSize_Exp = (uint32_t)number;
+	}
+	else {
+		fprintf(stderr, "Unknown cache option: %s\n", key);
+		return false;
+	}
+	return true;
+}
+
+//@pre: the input fields of config are set
+//@post: lines and tag fields are derived from them
+//@return: false (with a message) if the geometry cannot be built
+//@brief: The number of lines is the largest power of two whose sets fit in
+//        the cache size, so an associativity that is not a power of two
+//        leaves part of the requested capacity unused.
+bool ConfigureCache(cacheConfig *config){
+	uint64_t cacheBytes = 1ull << config->cacheSize_Exp;
+	uint64_t setBytes = (uint64_t)config->associativity << config->blockSize_Exp;
+	if (setBytes > cacheBytes) {
+		fprintf(stderr, "A single set (%u ways of %llu bytes) is larger than the cache\n",
+			config->associativity, 1ull << config->blockSize_Exp);
+		return false;
+	}
+
+	uint64_t lines = cacheBytes / setBytes;
+	config->lines_Exp = 63 - __builtin_clzll(lines);
+	config->lines_Nbr = 1u << config->lines_Exp;
+	config->lines_Mask = config->lines_Nbr - 1;
+
+	if (config->addressSize_Exp <= config->blockSize_Exp + config->lines_Exp) {
+		fprintf(stderr, "Address size of %u bits leaves no tag bits\n", config->addressSize_Exp);
+		return false;
+	}
+	config->tag_Exp = config->addressSize_Exp - config->blockSize_Exp - config->lines_Exp;
+	if (config->tag_Exp > 32) {
+		fprintf(stderr, "Tag of %u bits does not fit the 32-bit tag store\n", config->tag_Exp);
+		return false;
+	}
+	config->tag_Mask = (uint32_t)((1ull << config->tag_Exp) - 1);
+	return CheckReplacementPolicy(config->replacement, config->lines_Nbr, config->associativity);
+}
+
+//@pre: a cache config
+//@return: the name of its write policy
+const char *WritePolicyName(const cacheConfig *config){
+	return config->writeBack ? "write-back" : "write-through";
+}
+
+//@pre: a cache config
+//@return: the name of its write miss policy
+const char *AllocatePolicyName(const cacheConfig *config){
+	return config->writeAllocate ? "write-allocate" : "no-write-allocate";
+}
+
+//=============================================================================
+// CACHE STATE
+//
+
+//@pre: config has been through ConfigureCache
+//@post: cache holds lines_Nbr sets of associativity invalid ways
+//@return: false if the cache could not be allocated
+//@brief: This fucntion builds out the cache object that we will use
+bool buildCache(cacheLevel *cache, const cacheConfig *config){
+	memset(cache, 0, sizeof(*cache));
+	cache->config = *config;
+
+	// Pad every set's tags to a whole vector so the search never reads past it
+	uint32_t ways = config->associativity;
+	uint32_t lanes = ways <= 4 ? 4 : TagVector_Nbr;
+	cache->tagStride = (ways + lanes - 1) / lanes * lanes;
+	cache->validWords = (ways + 63) / 64;
+
+	size_t tagBytes = (size_t)config->lines_Nbr * cache->tagStride * sizeof(uint32_t);
+	tagBytes = (tagBytes + 63) / 64 * 64;
+	cache->tags = aligned_alloc(64, tagBytes);
+	cache->valid = calloc((size_t)config->lines_Nbr * cache->validWords, sizeof(uint64_t));
+	cache->dirty = calloc((size_t)config->lines_Nbr * cache->validWords, sizeof(uint64_t));
+	bool policyBuilt = buildReplacementState(&cache->replacement, config->replacement,
+		config->lines_Nbr, ways);
+	bool indexBuilt = true;
+	if (ways >= IndexedSet_MinWays) {
+		while ((1u << cache->indexBits) < 2 * ways) {
+			cache->indexBits++;
+		}
+		cache->tagIndex = calloc((size_t)config->lines_Nbr << cache->indexBits, sizeof(tagSlot));
+		cache->occupancy = calloc(config->lines_Nbr, sizeof(setOccupancy));
+		indexBuilt = cache->tagIndex != NULL && cache->occupancy != NULL;
+	}
+	if (cache->tags == NULL || cache->valid == NULL || cache->dirty == NULL || !policyBuilt || !indexBuilt) {
+		destroyCache(cache);
+		return false;
+	}
+	memset(cache->tags, 0, tagBytes);
+	return true;
+}
+
+//@pre: cache was built by buildCache
+//@post: all memory held by the cache is released
+//@return: none
+void destroyCache(cacheLevel *cache){
+	free(cache->tags);
+	free(cache->valid);
+	free(cache->dirty);
+	free(cache->tagIndex);
+	free(cache->occupancy);
+	destroyReplacementState(&cache->replacement);
+	free(cache->setStats);
+	cache->setStats = NULL;
+	cache->tagIndex = NULL;
+	cache->occupancy = NULL;
+	cache->tags = NULL;
+	cache->valid = NULL;
+	cache->dirty = NULL;
+}
+
+//@pre: a built cache
+//@post: demand accesses and misses are counted per set from now on
+//@return: false if memory is short
+bool CountSetAccesses(cacheLevel *cache){
+	cache->setStats = calloc(cache->config.lines_Nbr, sizeof(setStat));
+	return cache->setStats != NULL;
+}
+
+//=============================================================================
+// LOOKUP
+//
+
+//@pre: tags points at up to 64 ways of a set, padded to a whole vector
+//@return: a bitmask with bit i set where tags[i] equals tag
+//@brief: One compare-and-movemask per vector of tags. The bits above ways
+//        are garbage and must be masked off with the valid bits.
+static inline __attribute__((always_inline))
+uint64_t MatchTags(const uint32_t *tags, uint32_t ways, uint32_t tag){
+	uint64_t match = 0;
+	if (ways == 1) {
+		return tags[0] == tag;
+	}
+#if defined(__SSE2__)
+	if (ways <= 4) {
+		__m128i key = _mm_set1_epi32((int)tag);
+		__m128i lane = _mm_loadu_si128((const __m128i *)tags);
+		return (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lane, key)));
+	}
+#endif
+#if defined(__AVX2__)
+	__m256i key = _mm256_set1_epi32((int)tag);
+	for (uint32_t i = 0; i < ways; i += 8) {
+		__m256i lane = _mm256_loadu_si256((const __m256i *)(tags + i));
+		uint64_t bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(lane, key)));
+		match |= bits << i;
+	}
+#elif defined(__SSE2__)
+	__m128i key = _mm_set1_epi32((int)tag);
+	for (uint32_t i = 0; i < ways; i += 4) {
+		__m128i lane = _mm_loadu_si128((const __m128i *)(tags + i));
+		uint64_t bits = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(lane, key)));
+		match |= bits << i;
+	}
+#else
+	for (uint32_t i = 0; i < ways; i++) {
+		match |= (uint64_t)(tags[i] == tag) << i;
+	}
+#endif
+	return match;
+}
+
+//@pre: a cache with indexed sets
+//@return: the slot of the index of set line holding tag, or the empty slot
+//         that ends its probe
+static inline uint32_t FindTagSlot(const cacheLevel *cache, uint32_t line, uint32_t tag){
+	const tagSlot *index = cache->tagIndex + ((size_t)line << cache->indexBits);
+	uint32_t mask = (1u << cache->indexBits) - 1;
+	uint32_t slot = (uint32_t)(((uint64_t)tag * 0x9E3779B97F4A7C15ull) >> (64 - cache->indexBits));
+	while (index[slot].way != 0 && index[slot].tag != tag) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+//@pre: slot of the index of set line is occupied
+//@post: the slot is empty and the entries after it are moved back so that
+//       every probe still reaches its tag
+//@return: none
+static void RemoveTagSlot(cacheLevel *cache, uint32_t line, uint32_t slot){
+	tagSlot *index = cache->tagIndex + ((size_t)line << cache->indexBits);
+	uint32_t mask = (1u << cache->indexBits) - 1;
+	uint32_t hole = slot;
+	for (uint32_t next = (hole + 1) & mask; index[next].way != 0; next = (next + 1) & mask) {
+		uint32_t home = (uint32_t)(((uint64_t)index[next].tag * 0x9E3779B97F4A7C15ull) >> (64 - cache->indexBits));
+		if (((next - home) & mask) >= ((next - hole) & mask)) {
+			index[hole] = index[next];
+			hole = next;
+		}
+	}
+	index[hole].way = 0;
+}
+
+//@pre: a configured cache
+//@return: the way of set line holding tag, or ways if the tag is not present
+static inline __attribute__((always_inline))
+uint32_t FindWay(const cacheLevel *cache, uint32_t line, uint32_t ways, uint32_t tag){
+	if (ways >= IndexedSet_MinWays) {
+		uint32_t slot = FindTagSlot(cache, line, tag);
+		uint32_t way = cache->tagIndex[((size_t)line << cache->indexBits) + slot].way;
+		return way != 0 ? way - 1 : ways;
+	}
+	const uint32_t *tags = SetTags(cache, line);
+	const uint64_t *valid = SetValid(cache, line);
+	for (uint32_t base = 0; base < ways; base += 64) {
+		uint32_t span = ways - base < 64 ? ways - base : 64;
+		uint64_t match = MatchTags(tags + base, span, tag) & valid[base / 64];
+		if (match != 0) {
+			return base + (uint32_t)__builtin_ctzll(match);
+		}
+	}
+	return ways;
+}
+
+//@pre: the block is missing from set line
+//@post: the replacement state of the set is advanced if a valid block is chosen
+//@return: the first invalid way, or the replacement policy's victim
+static inline __attribute__((always_inline))
+uint32_t ChooseVictim(cacheLevel *cache, uint32_t line, uint32_t ways){
+	const uint64_t *valid = SetValid(cache, line);
+	if (ways >= IndexedSet_MinWays) {
+		// Search from the hint only while the set has an invalid way; the
+		// bits past the last way are never set but lie above every real one
+		const setOccupancy *set = &cache->occupancy[line];
+		if (set->validWays == ways) {
+			return ReplacementVictim(&cache->replacement, line, ways);
+		}
+		uint32_t word = set->firstFree / 64;
+		uint64_t empty = ~valid[word] & (~0ull << (set->firstFree % 64));
+		while (empty == 0) {
+			empty = ~valid[++word];
+		}
+		return word * 64 + (uint32_t)__builtin_ctzll(empty);
+	}
+	for (uint32_t base = 0; base < ways; base += 64) {
+		uint32_t span = ways - base < 64 ? ways - base : 64;
+		uint64_t mask = span == 64 ? ~0ull : (1ull << span) - 1;
+		uint64_t empty = ~valid[base / 64] & mask;
+		if (empty != 0) {
+			return base + (uint32_t)__builtin_ctzll(empty);
+		}
+	}
+	// Reached the end of the set. Ask the policy which block to replace.
+	return ReplacementVictim(&cache->replacement, line, ways);
+}
+
+//@pre: way of set line, the way ChooseVictim chose, is about to hold tag
+//@post: the way is valid and holds tag
+static inline __attribute__((always_inline))
+void PlaceTag(cacheLevel *cache, uint32_t line, uint32_t way, uint32_t tag, uint32_t ways){
+	uint32_t *tags = SetTags(cache, line);
+	uint64_t *valid = &SetValid(cache, line)[way / 64];
+	uint64_t bit = 1ull << (way % 64);
+	if (ways >= IndexedSet_MinWays) {
+		setOccupancy *set = &cache->occupancy[line];
+		if (*valid & bit) {
+			RemoveTagSlot(cache, line, FindTagSlot(cache, line, tags[way]));
+		}
+		else {
+			// An invalid way is only chosen when it is the first one
+			set->validWays++;
+			set->firstFree = way + 1;
+		}
+		uint32_t slot = FindTagSlot(cache, line, tag);
+		cache->tagIndex[((size_t)line << cache->indexBits) + slot] = (tagSlot){ tag, way + 1 };
+	}
+	tags[way] = tag;
+	*valid |= bit;
+}
+
+//@pre: a configured cache; ways and blockExp equal the cache's own values
+//@post: the block holding address is present in the cache
+//@return: true on a hit
+//@brief: Written so that callers passing constant ways/blockExp get a fully
+//        unrolled search.
+static inline __attribute__((always_inline))
+bool LookupAndFill(cacheLevel *cache, uint64_t address, uint32_t ways, uint32_t blockExp){
+	const cacheConfig *config = &cache->config;
+	uint32_t line = (uint32_t)(address >> blockExp) & config->lines_Mask;
+	uint32_t tag = (uint32_t)(address >> (blockExp + config->lines_Exp)) & config->tag_Mask;
+
+	uint32_t way = FindWay(cache, line, ways, tag);
+	if (way != ways) {
+		ReplacementHit(&cache->replacement, line, way, ways);
+		return true;
+	}
+	way = ChooseVictim(cache, line, ways);
+	PlaceTag(cache, line, way, tag, ways);
+	ReplacementInsert(&cache->replacement, line, way, ways);
+	return false;
+}
+
+//@pre: a configured cache
+//@post: the block holding address is present and the hit/miss counters updated
+//@return: true on a hit
+//@brief: Like the batch loop this neither reads nor clears dirty bits; it is
+//        for load-only simulation.
+bool AccessCache(cacheLevel *cache, uint64_t address){
+	bool hit = LookupAndFill(cache, address, cache->config.associativity, cache->config.blockSize_Exp);
+	if (hit) {
+		cache->hits++;
+	}
+	else {
+		cache->misses++;
+	}
+	return hit;
+}
+
+//@pre: a configured cache
+//@post: a hit is recorded by the replacement policy; counters are unchanged
+//@return: the way of the block's set holding address, or associativity if
+//         the block is not present
+uint32_t LookupWay(cacheLevel *cache, uint64_t address){
+	uint32_t ways = cache->config.associativity;
+	uint32_t line = ParseLineFromAddress(cache, address);
+	uint32_t way = FindWay(cache, line, ways, ParseTagFromAddress(cache, address));
+	if (way != ways) {
+		ReplacementHit(&cache->replacement, line, way, ways);
+	}
+	return way;
+}
+
+//@pre: a configured cache
+//@post: no change to the cache or its counters
+//@return: the way of the block's set holding address, or associativity if
+//         the block is not present
+uint32_t ProbeWay(const cacheLevel *cache, uint64_t address){
+	uint32_t ways = cache->config.associativity;
+	uint32_t line = ParseLineFromAddress(cache, address);
+	return FindWay(cache, line, ways, ParseTagFromAddress(cache, address));
+}
+
+//@pre: a configured cache
+//@post: a hit is recorded by the replacement policy; counters are unchanged
+//@return: true if the block holding address is present
+bool LookupCache(cacheLevel *cache, uint64_t address){
+	return LookupWay(cache, address) != cache->config.associativity;
+}
+
+//@pre: a configured cache
+//@post: no change to the cache or its counters
+//@return: true if the block holding address is present
+bool ProbeCache(const cacheLevel *cache, uint64_t address){
+	return ProbeWay(cache, address) != cache->config.associativity;
+}
+
+//@pre: the block holding address is not in the cache
+//@post: the block is present, dirty if asked; a valid block may have been replaced
+//@return: true if a valid block was evicted, its block address in *victim and
+//         whether it was dirty in *victimDirty
+bool FillCache(cacheLevel *cache, uint64_t address, bool dirty, uint64_t *victim, bool *victimDirty){
+	uint32_t ways = cache->config.associativity;
+	uint32_t line = ParseLineFromAddress(cache, address);
+
+	uint32_t way = ChooseVictim(cache, line, ways);
+	bool evicted = IsWayValid(cache, line, way);
+	if (evicted) {
+		*victim = BlockAddress(cache, SetTags(cache, line)[way], line);
+		*victimDirty = IsWayDirty(cache, line, way);
+		cache->evictions++;
+	}
+	PlaceTag(cache, line, way, ParseTagFromAddress(cache, address), ways);
+	uint64_t bit = 1ull << (way % 64);
+	uint64_t *dirtyWord = &SetDirty(cache, line)[way / 64];
+	*dirtyWord = dirty ? *dirtyWord | bit : *dirtyWord & ~bit;
+	ReplacementInsert(&cache->replacement, line, way, ways);
+	cache->fills++;
+	return evicted;
+}
+
+//@pre: a configured cache
+//@post: the block holding address is no longer present
+//@return: true if the block was present, and in *dirty (if not NULL) whether
+//         it was dirty
+bool InvalidateCache(cacheLevel *cache, uint64_t address, bool *dirty){
+	uint32_t ways = cache->config.associativity;
+	uint32_t line = ParseLineFromAddress(cache, address);
+	uint32_t way = FindWay(cache, line, ways, ParseTagFromAddress(cache, address));
+	if (way == ways) {
+		return false;
+	}
+	if (dirty != NULL) {
+		*dirty = IsWayDirty(cache, line, way);
+	}
+	if (ways >= IndexedSet_MinWays) {
+		setOccupancy *set = &cache->occupancy[line];
+		RemoveTagSlot(cache, line, FindTagSlot(cache, line, SetTags(cache, line)[way]));
+		set->validWays--;
+		if (way < set->firstFree) {
+			set->firstFree = way;
+		}
+	}
+	SetValid(cache, line)[way / 64] &= ~(1ull << (way % 64));
+	SetDirty(cache, line)[way / 64] &= ~(1ull << (way % 64));
+	return true;
+}
+
+//@pre: a configured cache
+//@post: the block holding address, if present, is dirty
+//@return: true if the block was present
+bool MarkDirty(cacheLevel *cache, uint64_t address){
+	uint32_t ways = cache->config.associativity;
+	uint32_t line = ParseLineFromAddress(cache, address);
+	uint32_t way = FindWay(cache, line, ways, ParseTagFromAddress(cache, address));
+	if (way == ways) {
+		return false;
+	}
+	SetDirty(cache, line)[way / 64] |= 1ull << (way % 64);
+	return true;
+}
+
+//@brief: The batch loop, instantiated below for fixed geometries
+static inline __attribute__((always_inline))
+void SimulateAddressesWith(cacheLevel *cache, const uint32_t *addresses, size_t count,
+	uint32_t ways, uint32_t blockExp){
+	uint64_t hits = 0;
+	if (cache->setStats != NULL) {
+		setStat *__restrict sets = cache->setStats;
+		uint32_t mask = cache->config.lines_Mask;
+		for (size_t i = 0; i < count; i++) {
+			bool hit = LookupAndFill(cache, addresses[i], ways, blockExp);
+			setStat *set = &sets[(addresses[i] >> blockExp) & mask];
+			set->accesses++;
+			set->misses += !hit;
+			hits += hit;
+		}
+	}
+	else {
+		for (size_t i = 0; i < count; i++) {
+			hits += LookupAndFill(cache, addresses[i], ways, blockExp);
+		}
+	}
+	cache->hits += hits;
+	cache->misses += count - hits;
+}
+
+typedef void (*simulateFunction)(cacheLevel *, const uint32_t *, size_t);
+
+#define DEFINE_SIMULATE(WAYS, BLOCK_EXP) \
+	static void SimulateAddresses_##WAYS##_##BLOCK_EXP(cacheLevel *cache, \
+		const uint32_t *addresses, size_t count){ \
+		SimulateAddressesWith(cache, addresses, count, WAYS, BLOCK_EXP); \
+	}
+
+#define DEFINE_SIMULATE_WAYS(WAYS) \
+	DEFINE_SIMULATE(WAYS, 5) \
+	DEFINE_SIMULATE(WAYS, 6) \
+	DEFINE_SIMULATE(WAYS, 7)
+
+DEFINE_SIMULATE_WAYS(1)
+DEFINE_SIMULATE_WAYS(2)
+DEFINE_SIMULATE_WAYS(4)
+DEFINE_SIMULATE_WAYS(8)
+DEFINE_SIMULATE_WAYS(16)
+
+#define SIMULATE_ROW(WAYS) \
+	{ SimulateAddresses_##WAYS##_5, SimulateAddresses_##WAYS##_6, SimulateAddresses_##WAYS##_7 }
+
+//Specializations indexed by [log2(ways)][blockSize_Exp - 5]
+static const simulateFunction SimulateTable[5][3] = {
+	SIMULATE_ROW(1), SIMULATE_ROW(2), SIMULATE_ROW(4), SIMULATE_ROW(8), SIMULATE_ROW(16)
+};
+
+static void SimulateAddressesGeneric(cacheLevel *cache, const uint32_t *addresses, size_t count){
+	SimulateAddressesWith(cache, addresses, count,
+		cache->config.associativity, cache->config.blockSize_Exp);
+}
+
+//@pre: a configured cache
+//@post: every address is looked up in order and the counters updated
+//@return: none
+//@brief: Runs a batch through the specialization for the cache's geometry,
+//        falling back to the generic loop for uncommon geometries
+void SimulateAddresses(cacheLevel *cache, const uint32_t *addresses, size_t count){
+	uint32_t ways = cache->config.associativity;
+	uint32_t blockExp = cache->config.blockSize_Exp;
+	simulateFunction simulate = SimulateAddressesGeneric;
+	if (ways <= 16 && (ways & (ways - 1)) == 0 && blockExp >= 5 && blockExp <= 7) {
+		simulate = SimulateTable[__builtin_ctz(ways)][blockExp - 5];
+	}
+	simulate(cache, addresses, count);
+}
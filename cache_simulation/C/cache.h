@@ -0,0 +1,191 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Cache geometry and per-level cache state for the cache simulation
+//
+//	Description:
+//			The cache used to be described entirely by compile-time macros
+//			(CacheSize_Exp, CacheAssociativity, BlockSize_Exp, AddressSize_Exp).
+//			The same values now live in a cacheConfig filled in at run time,
+//			and every derived value (lines, tag size, masks) is computed once
+//			by ConfigureCache.
+//
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "policy.h"
+
+//
+//	Default geometry, matching the values the simulator was built with
+//
+#define  Default_CacheSize_Exp     15
+#define  Default_AddressSize_Exp   32
+#define  Default_Associativity     3
+#define  Default_BlockSize_Exp     6
+#define  Default_Replacement       ROUND_ROBIN
+#define  Default_WriteBack         true
+#define  Default_WriteAllocate     true
+
+//Cache geometry, replacement and write policies. The first seven fields are
+//inputs, the rest are derived.
+typedef struct cacheConfig
+{
+	uint32_t cacheSize_Exp;
+	uint32_t addressSize_Exp;
+	uint32_t associativity;
+	uint32_t blockSize_Exp;
+	replacementPolicy replacement;
+	bool writeBack;
+	bool writeAllocate;
+
+	uint32_t lines_Exp;
+	uint32_t lines_Nbr;
+	uint32_t lines_Mask;
+	uint32_t tag_Exp;
+	uint32_t tag_Mask;
+} cacheConfig;
+
+//Demand accesses and misses of one set
+typedef struct setStat
+{
+	uint64_t accesses;
+	uint64_t misses;
+} setStat;
+
+//
+//	Tags compared per vector by the way search
+//
+#define  TagVector_Nbr  8
+
+//One slot of the tag index of a set: a valid tag and its way + 1, or way 0
+//for an empty slot
+typedef struct tagSlot
+{
+	uint32_t tag;
+	uint32_t way;
+} tagSlot;
+
+//Valid ways of an indexed set, and a way no higher than its first invalid one
+typedef struct setOccupancy
+{
+	uint32_t validWays;
+	uint32_t firstFree;
+} setOccupancy;
+
+//One cache: lines_Nbr sets of associativity ways. The tags of a set are
+//contiguous (tagStride slots, padded to whole vectors) and bitmasks of
+//validWords words per set record which ways hold a block and which of those
+//blocks are dirty.
+//
+//Sets of IndexedSet_MinWays or more ways are too wide to compare every tag,
+//so each also keeps an open-addressing index of its valid tags, 2^indexBits
+//slots of at most half load, and its occupancy for finding an invalid way.
+typedef struct cacheLevel
+{
+	cacheConfig config;
+	uint32_t *tags;
+	uint64_t *valid;
+	uint64_t *dirty;
+	uint32_t tagStride;
+	uint32_t validWords;
+	replacementState replacement;
+	//NULL unless the sets are indexed
+	tagSlot *tagIndex;
+	setOccupancy *occupancy;
+	uint32_t indexBits;
+
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t fills;
+	uint64_t evictions;
+	//dirty blocks evicted, and the bytes of block and store data sent to the
+	//level below (or memory)
+	uint64_t writebacks;
+	uint64_t writebackBytes;
+	uint64_t writeThroughBytes;
+	//per set, NULL unless CountSetAccesses was called
+	setStat *setStats;
+} cacheLevel;
+
+bool ParseSize(const char *text, uint64_t *value);
+bool ParseCount(const char *text, uint32_t least, uint32_t most, uint32_t *value);
+bool ParseNumberList(const char *text, uint32_t *values, int count);
+void DefaultCacheConfig(cacheConfig *config);
+bool SetCacheOption(cacheConfig *config, const char *key, const char *value);
+bool ConfigureCache(cacheConfig *config);
+const char *WritePolicyName(const cacheConfig *config);
+const char *AllocatePolicyName(const cacheConfig *config);
+
+bool buildCache(cacheLevel *cache, const cacheConfig *config);
+void destroyCache(cacheLevel *cache);
+bool CountSetAccesses(cacheLevel *cache);
+
+bool AccessCache(cacheLevel *cache, uint64_t address);
+bool LookupCache(cacheLevel *cache, uint64_t address);
+uint32_t LookupWay(cacheLevel *cache, uint64_t address);
+uint32_t ProbeWay(const cacheLevel *cache, uint64_t address);
+bool ProbeCache(const cacheLevel *cache, uint64_t address);
+bool FillCache(cacheLevel *cache, uint64_t address, bool dirty, uint64_t *victim, bool *victimDirty);
+bool InvalidateCache(cacheLevel *cache, uint64_t address, bool *dirty);
+bool MarkDirty(cacheLevel *cache, uint64_t address);
+void SimulateAddresses(cacheLevel *cache, const uint32_t *addresses, size_t count);
+
+//@pre: an address and a configured cache
+//@post: no change to the cache
+//@return: Extracted Line From Address
+static inline uint32_t ParseLineFromAddress(const cacheLevel *cache, uint64_t MyAddress){
+	return (uint32_t)(MyAddress >> cache->config.blockSize_Exp) & cache->config.lines_Mask;
+}
+
+//@pre: an address and a configured cache
+//@post: no change to the cache
+//@return: Extracted Tag From address
+static inline uint32_t ParseTagFromAddress(const cacheLevel *cache, uint64_t MyAddress){
+	return (uint32_t)(MyAddress >> (cache->config.blockSize_Exp + cache->config.lines_Exp)) & cache->config.tag_Mask;
+}
+
+//@return: the tags of set line
+static inline uint32_t *SetTags(const cacheLevel *cache, uint32_t line){
+	return cache->tags + (size_t)line * cache->tagStride;
+}
+
+//@return: the valid bitmask of set line
+static inline uint64_t *SetValid(const cacheLevel *cache, uint32_t line){
+	return cache->valid + (size_t)line * cache->validWords;
+}
+
+//@return: the dirty bitmask of set line
+static inline uint64_t *SetDirty(const cacheLevel *cache, uint32_t line){
+	return cache->dirty + (size_t)line * cache->validWords;
+}
+
+//@return: true if way of set line holds a block
+static inline bool IsWayValid(const cacheLevel *cache, uint32_t line, uint32_t way){
+	return (SetValid(cache, line)[way / 64] >> (way % 64)) & 1;
+}
+
+//@return: true if way of set line holds a modified block
+static inline bool IsWayDirty(const cacheLevel *cache, uint32_t line, uint32_t way){
+	return (SetDirty(cache, line)[way / 64] >> (way % 64)) & 1;
+}
+
+//@pre: a cache counting set accesses
+//@post: a demand access to address that hit or missed is counted in its set
+//@return: none
+static inline void CountSetAccess(cacheLevel *cache, uint64_t address, bool hit){
+	setStat *set = &cache->setStats[ParseLineFromAddress(cache, address)];
+	set->accesses++;
+	set->misses += !hit;
+}
+
+//@pre: a tag and line taken from this cache
+//@post: no change to the cache
+//@return: Address of the first byte of the block
+static inline uint64_t BlockAddress(const cacheLevel *cache, uint32_t tag, uint32_t line){
+	return (((uint64_t)tag << cache->config.lines_Exp) | line) << cache->config.blockSize_Exp;
+}
+
+#endif /* CACHE_H_ */
@@ -7,6 +7,51 @@
 //
 //      B40922 -- Added a loop with random indices
 //
+//      Cache geometry is read from the command line or a config file
+//      instead of being compiled in.
+//
+//      Added L2/L3 levels below the L1 with per-level inclusion policies.
+//
+//      Replacement policy is selectable per level.
+//
+//      Traces are memory mapped instead of read 4 bytes at a time.
+//
+//      Added sweeps: many configurations simulated in one pass of the trace.
+//
+//      Added set-sharded multithreaded simulation.
+//
+//      Added LRU stack distance profiling (miss ratio curves).
+//
+//      Added record traces with loads and stores, write-back/write-through
+//      and write-allocate policies, and write traffic counters.
+//
+//      Added packed (delta encoded, optionally LZ compressed) traces.
+//
+//      Added synthetic trace generators (-g) in place of a trace file.
+//
+//      Added per-core private L1s kept coherent with MESI or MOESI (-C).
+//
+//      Added next-line, stride, stream and SMS prefetchers with accuracy
+//      and coverage counters.
+//
+//      Added compulsory/capacity/conflict miss classification (-3).
+//
+//      Added interval statistics (-i) and per-set access histograms (-x, -X).
+//
+//      Added dTLB/STLB translation with page walks through the caches (-T).
+//
+//      Added set-sampled approximate simulation with confidence intervals (-e).
+//
+//      Added victim caches and miss caches beside any level (-v).
+//
+//      Added warm-state checkpoints (-k) and restores (-R).
+//
+//      Added live streaming from pipes with a report per window (-L).
+//
+//      Added a timing model with MSHRs, AMAT and memory-level parallelism (-P).
+//
+//      Added a batch mode running a manifest of traces on a worker pool (-B).
+//
 //
 //	Description:
 //			This program simulates a multi-way direct mapped cache.
@@ -14,6 +59,7 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -21,161 +67,711 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <math.h>
 
-//Cache Block Struct
-typedef struct cacheBlock
-{
-	uint32_t valid;
-	uint32_t tag;
-	uint32_t line;
-
-} cacheBlock;
-//global round robin state array to keep track of the RRstate for every set
-// initialize values of RRstate array to all 0's
-int RRstate [64] = {0};
+#include "batch.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "coherence.h"
+#include "hierarchy.h"
+#include "sample.h"
+#include "shard.h"
+#include "stackdist.h"
+#include "stats.h"
+#include "sweep.h"
+#include "timing.h"
+#include "tlb.h"
+#include "trace.h"
 
+//=============================================================================
+// FUNCTION DECLARATIONS
 //
-//	Definitions of the cache
-//
-//	The cache size exponent and capacity in bytes
+//	Function to report defined values.
 //
-#define  CacheSize_Exp  15
-#define  CacheSize_Nbr  ( 1 << CacheSize_Exp )
+void ReportParameters (const char* theFilename, const hierarchyConfig *hierarchy ) {
+	const cacheConfig *config = &hierarchy->levels[0].cache;
+
+	printf( "Filename: %s\n", theFilename );
+
+	printf( "Cache Parameters: CacheSize_Exp: %08X; CacheSize_Nbr: %08llX\n",
+	config->cacheSize_Exp, 1ull << config->cacheSize_Exp );
+
+	printf( "Address size: AddressSize_Exp: %08X\n", config->addressSize_Exp );
+
+	printf( "Cache Associativity: %08X\n", config->associativity );
+
+	printf( "Replacement Policy: %s\n", ReplacementPolicyName(config->replacement) );
+
+	printf( "Write Policy: %s, %s\n", WritePolicyName(config), AllocatePolicyName(config) );
+
+	printf( "Block Parameters: BlockSize_Exp: %08X; BlockSize_Nbr: %08X; BlockSize_Mask: %08X\n",
+	config->blockSize_Exp, 1u << config->blockSize_Exp, (1u << config->blockSize_Exp) - 1 );
+
+	printf( "Line Parameters: Lines_Exp: %08X; Lines_Nbr: %08X; Lines_Mask: %08X\n",
+	config->lines_Exp, config->lines_Nbr, config->lines_Mask );
+
+	printf( "Tag Parameters: Tag_Exp: %08X; Tag_Nbr: %08llX; Tag_Mask: %08X\n",
+	config->tag_Exp, 1ull << config->tag_Exp, config->tag_Mask );
+
+	const prefetchConfig *prefetch = &hierarchy->levels[0].prefetch;
+	if (prefetch->kind != PREFETCH_NONE) {
+		printf( "Prefetcher: %s; Degree: %u; Latency: %u\n", PrefetchKindName(prefetch->kind),
+		prefetch->degree, prefetch->latency );
+	}
+
+	const victimConfig *victim = &hierarchy->levels[0].victim;
+	if (victim->kind != VICTIM_NONE) {
+		printf( "Buffer: %s cache; Entries: %u\n", VictimKindName(victim->kind), victim->entries );
+	}
+
+	for (int i = 1; i < hierarchy->levelCount; i++) {
+		const levelConfig *level = &hierarchy->levels[i];
+		printf( "L%d Parameters: CacheSize_Nbr: %08llX; Associativity: %u; BlockSize_Nbr: %u; Lines_Nbr: %u; Inclusion: %s; Replacement: %s; Write: %s, %s\n",
+		i + 1, 1ull << level->cache.cacheSize_Exp, level->cache.associativity,
+		1u << level->cache.blockSize_Exp, level->cache.lines_Nbr, InclusionName(level->inclusion),
+		ReplacementPolicyName(level->cache.replacement),
+		WritePolicyName(&level->cache), AllocatePolicyName(&level->cache) );
+		if (level->prefetch.kind != PREFETCH_NONE) {
+			printf( "L%d Prefetcher: %s; Degree: %u; Latency: %u\n", i + 1,
+			PrefetchKindName(level->prefetch.kind), level->prefetch.degree, level->prefetch.latency );
+		}
+		if (level->victim.kind != VICTIM_NONE) {
+			printf( "L%d Buffer: %s cache; Entries: %u\n", i + 1, VictimKindName(level->victim.kind),
+			level->victim.entries );
+		}
+	}
+
+}
 
 //
-//	Address size exponent
+//	Function to report per-level results for a hierarchy. The write traffic
+//	columns are only shown for record traces, which are the only ones with
+//	stores. Levels are numbered from firstLevel.
 //
-#define  AddressSize_Exp  32
+void ReportHierarchy (const cacheHierarchy *hierarchy, int firstLevel, bool writes) {
+	printf("\n%-6s %14s %14s %10s %14s %14s", "Level", "Hits", "Misses", "Hit Ratio", "Evictions", "BackInvals");
+	if (writes) {
+		printf(" %14s %16s %16s", "Writebacks", "WB Bytes", "WT Bytes");
+	}
+	printf("\n");
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		const cacheLevel *level = &hierarchy->levels[i];
+		uint64_t accesses = level->hits + level->misses;
+		printf("L%-5d %14llu %14llu %9.4f%% %14llu %14llu", i + firstLevel,
+			(unsigned long long)level->hits, (unsigned long long)level->misses,
+			accesses ? 100.0 * level->hits / accesses : 0.0,
+			(unsigned long long)level->evictions,
+			(unsigned long long)hierarchy->backInvalidations[i]);
+		if (writes) {
+			printf(" %14llu %16llu %16llu", (unsigned long long)level->writebacks,
+				(unsigned long long)level->writebackBytes,
+				(unsigned long long)level->writeThroughBytes);
+		}
+		printf("\n");
+	}
+	if (writes) {
+		const cacheLevel *last = &hierarchy->levels[hierarchy->levelCount - 1];
+		printf("Bytes written to memory: %llu\n",
+			(unsigned long long)(last->writebackBytes + last->writeThroughBytes));
+	}
+}
 
 //
-//	The cache associativity
+//	Function to report the prefetchers of a hierarchy. Accuracy is the share
+//	of prefetches that were used, coverage the share of would-be misses they
+//	removed.
 //
-#define  CacheAssociativity_Exp 0
-#define  CacheAssociativity ( 3 << CacheAssociativity_Exp )
+void ReportPrefetchers (const cacheHierarchy *hierarchy, int firstLevel) {
+	bool header = false;
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		const prefetcher *prefetch = &hierarchy->prefetchers[i];
+		if (prefetch->config.kind == PREFETCH_NONE) {
+			continue;
+		}
+		if (!header) {
+			printf("\n%-6s %-9s %14s %14s %14s %14s %14s %10s %10s\n", "Level", "Prefetch",
+				"Issued", "Useful", "Late", "Unused", "Polluting", "Accuracy", "Coverage");
+			header = true;
+		}
+		uint64_t misses = hierarchy->levels[i].misses;
+		printf("L%-5d %-9s %14llu %14llu %14llu %14llu %14llu %9.4f%% %9.4f%%\n", i + firstLevel,
+			PrefetchKindName(prefetch->config.kind), (unsigned long long)prefetch->issued,
+			(unsigned long long)prefetch->useful, (unsigned long long)prefetch->late,
+			(unsigned long long)prefetch->unused, (unsigned long long)prefetch->polluting,
+			prefetch->issued ? 100.0 * prefetch->useful / prefetch->issued : 0.0,
+			prefetch->useful + misses ? 100.0 * prefetch->useful / (prefetch->useful + misses) : 0.0);
+	}
+}
 
 //
-//	The cache block size exponent, capacity in bytes, and mask
+//	Function to report the victim and miss caches of a hierarchy. Recovered
+//	is the share of the level's would-be misses that the buffer served.
 //
-#define  BlockSize_Exp  6
-#define  BlockSize_Nbr  ( 1 << BlockSize_Exp )
-#define  BlockSize_Mask  ( BlockSize_Nbr - 1 )
+void ReportVictimBuffers (const cacheHierarchy *hierarchy, int firstLevel) {
+	bool header = false;
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		const victimBuffer *buffer = &hierarchy->victims[i];
+		if (buffer->config.kind == VICTIM_NONE) {
+			continue;
+		}
+		if (!header) {
+			printf("\n%-6s %-7s %8s %14s %14s %14s %14s %10s\n", "Level", "Buffer", "Entries",
+				"Probes", "Hits", "Fills", "Evictions", "Recovered");
+			header = true;
+		}
+		printf("L%-5d %-7s %8u %14llu %14llu %14llu %14llu %9.4f%%\n", i + firstLevel,
+			VictimKindName(buffer->config.kind), buffer->config.entries,
+			(unsigned long long)buffer->probes, (unsigned long long)buffer->hits,
+			(unsigned long long)buffer->blocks.fills, (unsigned long long)buffer->blocks.evictions,
+			buffer->probes ? 100.0 * buffer->hits / buffer->probes : 0.0);
+	}
+}
 
 //
-//	The number of lines in the cache. A line can contain multiple blocks
+//	Function to report the compulsory, capacity and conflict misses of every
+//	level, as counts and shares of the level's misses.
 //
-#define  Lines_Exp   ( (CacheSize_Exp) - (CacheAssociativity_Exp + BlockSize_Exp) )
-#define  Lines_Nbr   ( 1 << Lines_Exp )
-#define  Lines_Mask   ( Lines_Nbr - 1 )
+void ReportMissClasses (const cacheHierarchy *hierarchy) {
+	printf("\n%-6s %14s %9s %14s %9s %14s %9s\n", "Level", "Compulsory", "Share", "Capacity", "Share",
+		"Conflict", "Share");
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		const missClassifier *classifier = hierarchy->classifiers[i];
+		uint64_t misses = hierarchy->levels[i].misses;
+		double scale = misses ? 100.0 / misses : 0.0;
+		printf("L%-5d %14llu %8.4f%% %14llu %8.4f%% %14llu %8.4f%%\n", i + 1,
+			(unsigned long long)classifier->compulsory, classifier->compulsory * scale,
+			(unsigned long long)classifier->capacity, classifier->capacity * scale,
+			(unsigned long long)classifier->conflict, classifier->conflict * scale);
+	}
+}
 
 //
-//	Tag size exponent and mask
+//	Function to report the TLB arrays, the page walks and the cache traffic
+//	they caused.
 //
-#define  Tag_Exp    ( AddressSize_Exp - BlockSize_Exp - Lines_Exp )
-#define  Tag_Nbr    ( 1 << Tag_Exp )
-#define  Tag_Mask   ( Tag_Nbr - 1 )
-
-//Global Cache variable
-cacheBlock cache[Lines_Nbr][CacheAssociativity];
+void ReportTlb (const tlbSystem *tlb, const cacheHierarchy *hierarchy) {
+	static const char *const levelNames[] = {"dTLB", "STLB"};
+	const tlbConfig *config = &tlb->config;
+	printf("\nTLB: %s pages", PageSizeName(config->hugePage));
+	if (config->hugePage != PAGE_4K && config->hugeFraction < 1.0) {
+		printf(" for %.2f%% of %s regions, 4K pages elsewhere", 100.0 * config->hugeFraction,
+			PageSizeName(config->hugePage));
+	}
+	printf("\n%-6s %-5s %8s %6s %14s %14s %10s\n", "Level", "Page", "Entries", "Ways", "Hits", "Misses", "Hit Ratio");
+	for (int level = 0; level < TlbLevels_Nbr; level++) {
+		for (int size = 0; size < PageSizes_Nbr; size++) {
+			const cacheLevel *array = &tlb->arrays[level][size];
+			if (array->tags == NULL || tlb->accesses[size] == 0) {
+				continue;
+			}
+			uint64_t accesses = array->hits + array->misses;
+			printf("%-6s %-5s %8u %6u %14llu %14llu %9.4f%%\n", levelNames[level], PageSizeName((pageSize)size),
+				config->arrays[level][size].entries, config->arrays[level][size].ways,
+				(unsigned long long)array->hits, (unsigned long long)array->misses,
+				accesses ? 100.0 * array->hits / accesses : 0.0);
+		}
+	}
 
-//Globals for tracking hits and misses
-int hits = 0;
-int misses = 0;
+	uint64_t walks = tlb->walks[PAGE_4K] + tlb->walks[PAGE_2M] + tlb->walks[PAGE_1G];
+	printf("Page walks: %llu (4K %llu, 2M %llu, 1G %llu)\n", (unsigned long long)walks,
+		(unsigned long long)tlb->walks[PAGE_4K], (unsigned long long)tlb->walks[PAGE_2M],
+		(unsigned long long)tlb->walks[PAGE_1G]);
+	printf("Paging-structure cache hits: PML4E %llu, PDPTE %llu, PDE %llu\n",
+		(unsigned long long)tlb->walkCacheHits[0], (unsigned long long)tlb->walkCacheHits[1],
+		(unsigned long long)tlb->walkCacheHits[2]);
+	printf("Walk loads: %llu (%.3f per walk); served by", (unsigned long long)tlb->walkLoads,
+		walks ? (double)tlb->walkLoads / walks : 0.0);
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		printf(" L%d %llu,", i + 1, (unsigned long long)tlb->walkLoadsServed[i]);
+	}
+	printf(" memory %llu\n", (unsigned long long)tlb->walkLoadsServed[hierarchy->levelCount]);
+	uint64_t accesses = tlb->accesses[PAGE_4K] + tlb->accesses[PAGE_2M] + tlb->accesses[PAGE_1G];
+	printf("Translation cycles: %llu (%.3f per access)\n", (unsigned long long)tlb->cycles,
+		accesses ? (double)tlb->cycles / accesses : 0.0);
+}
 
-//=============================================================================
-// FUNCTION DECLARATIONS
 //
-//	Function to report defined values.
+//	Function to report the cycles of a timed run: AMAT, memory-level
+//	parallelism and the stalls of issue.
 //
-void ReportParameters (const char* theFilename ) {
-
-	printf( "Filename: %s\n", theFilename );
-
-	printf( "Cache Parameters: CacheSize_Exp: %08X; CacheSize_Nbr: %08X\n",
-	CacheSize_Exp, CacheSize_Nbr );
-
-	printf( "Address size: AddressSize_Exp: %08X\n", AddressSize_Exp );
-
-	printf( "Cache Associativity: %08X\n", CacheAssociativity );
-
-	printf( "Block Parameters: BlockSize_Exp: %08X; BlockSize_Nbr: %08X; BlockSize_Mask: %08X\n",
-	BlockSize_Exp, BlockSize_Nbr, BlockSize_Mask );
+void ReportTiming (const timingModel *timing, const cacheHierarchy *hierarchy) {
+	const timingConfig *config = &timing->config;
+	uint64_t cycles = TimedCycles(timing);
+	printf("\nTiming: issue width %u, window %u, %u MSHRs; load latency", config->issueWidth,
+		config->window, config->mshrs);
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		printf(" L%d %u,", i + 1, config->latencies[i]);
+	}
+	printf(" memory %u\n", config->memoryLatency);
+	printf("Instructions: %llu; cycles: %llu; IPC: %.4f\n", (unsigned long long)timing->instructions,
+		(unsigned long long)cycles, cycles ? (double)timing->instructions / cycles : 0.0);
+	printf("AMAT: %.3f cycles; accesses served by", timing->accesses
+		? (double)timing->accessCycles / timing->accesses : 0.0);
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		printf(" L%d %llu,", i + 1, (unsigned long long)timing->served[i]);
+	}
+	printf(" memory %llu\n", (unsigned long long)timing->served[hierarchy->levelCount]);
+	printf("L1 misses: %llu primary, %llu merged into an MSHR; MLP: %.3f\n",
+		(unsigned long long)timing->primaryMisses, (unsigned long long)timing->mergedMisses,
+		timing->missBusyCycles ? (double)timing->missCycles / timing->missBusyCycles : 0.0);
+	printf("Stall cycles: %llu with every MSHR busy, %llu with the window full\n",
+		(unsigned long long)timing->mshrStallCycles, (unsigned long long)timing->windowStallCycles);
+}
 
-	printf( "Line Parameters: Lines_Exp: %08X; Lines_Nbr: %08X; Lines_Mask: %08X\n",
-	Lines_Exp, Lines_Nbr, Lines_Mask );
+//
+//	Function to report the estimates of a set-sampled simulation for the
+//	whole trace of accesses addresses.
+//
+bool ReportSampling (const setSampler *sampler, const cacheHierarchy *hierarchy, uint64_t accesses) {
+	printf("\nSet sampling: %llu of %llu set groups (%.4f%%), %llu of %llu accesses simulated\n",
+		(unsigned long long)sampler->sampledGroups, (unsigned long long)sampler->groups,
+		100.0 * sampler->sampledGroups / sampler->groups, (unsigned long long)sampler->kept,
+		(unsigned long long)sampler->seen);
+	if (sampler->sampledGroups < Sample_MinGroups) {
+		fprintf(stderr, "Only %llu set groups are sampled; the intervals are unreliable below %d, "
+			"so sample a larger fraction\n", (unsigned long long)sampler->sampledGroups, Sample_MinGroups);
+	}
+	printf("%-6s %14s %12s %12s %12s %16s\n", "Level", "Est Hit Ratio", "95% CI", "Est MPKA", "95% CI",
+		"Est Misses");
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		sampleEstimate estimate;
+		if (!EstimateLevel(sampler, hierarchy, i, &estimate)) {
+			fprintf(stderr, "Out of memory for the sampling estimates\n");
+			return false;
+		}
+		printf("L%-5d %13.4f%%", i + 1, 100.0 * estimate.hitRatio);
+		if (isnan(estimate.hitRatioError)) {
+			printf(" %12s", "-");
+		}
+		else {
+			printf(" +/-%8.4f%%", 100.0 * estimate.hitRatioError);
+		}
+		printf(" %12.3f", estimate.mpka);
+		if (isnan(estimate.mpkaError)) {
+			printf(" %12s", "-");
+		}
+		else {
+			printf(" +/-%9.3f", estimate.mpkaError);
+		}
+		printf(" %16.0f\n", estimate.mpka * accesses / 1000.0);
+	}
+	return true;
+}
 
-	printf( "Tag Parameters: Tag_Exp: %08X; Tag_Nbr: %08X; Tag_Mask: %08X\n",
-	Tag_Exp, Tag_Nbr, Tag_Mask );
+//
+//	Function to report per-core results of a coherent simulation, then the
+//	shared levels below the L1s.
+//
+void ReportCoherence (const coherentSystem *system, uint64_t limit) {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	for (int i = 0; i < system->coreCount; i++) {
+		hits += system->cores[i].l1.hits;
+		misses += system->cores[i].l1.misses;
+	}
+	printf("\nTotal Addresses processed: %llu", (unsigned long long)limit);
+	printf("\nHits: %llu", (unsigned long long)hits);
+	printf("\nMisses: %llu", (unsigned long long)misses);
+	printf("\nHit Ratio: %f\n", hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
 
+	printf("\n%-6s %12s %12s %12s %12s %10s %12s %12s %12s %12s %12s %12s %12s\n", "Core",
+		"Loads", "Stores", "Hits", "Misses", "Hit Ratio", "True Share", "False Share",
+		"Upgrades", "Invals", "C2C In", "C2C Out", "Writebacks");
+	for (int i = 0; i < system->coreCount; i++) {
+		const coreCache *core = &system->cores[i];
+		uint64_t accesses = core->l1.hits + core->l1.misses;
+		printf("%-6d %12llu %12llu %12llu %12llu %9.4f%% %12llu %12llu %12llu %12llu %12llu %12llu %12llu\n", i,
+			(unsigned long long)core->loads, (unsigned long long)core->stores,
+			(unsigned long long)core->l1.hits, (unsigned long long)core->l1.misses,
+			accesses ? 100.0 * core->l1.hits / accesses : 0.0,
+			(unsigned long long)core->trueSharingMisses, (unsigned long long)core->falseSharingMisses,
+			(unsigned long long)core->upgrades,
+			(unsigned long long)core->invalidations, (unsigned long long)core->transfersIn,
+			(unsigned long long)core->transfersOut, (unsigned long long)core->l1.writebacks);
+	}
+	if (system->shared.levelCount > 0) {
+		ReportHierarchy(&system->shared, 2, true);
+		ReportPrefetchers(&system->shared, 2);
+		ReportVictimBuffers(&system->shared, 2);
+	}
+	else {
+		printf("Memory reads: %llu\nBytes written to memory: %llu\n",
+			(unsigned long long)system->memoryReads, (unsigned long long)system->memoryWriteBytes);
+	}
 }
 
-bool RoundRobin(cacheBlock *line, uint32_t j, int RRstate[]) {
-	for(int i = 0; i < 8; i++) {
-		// if valid = 1 means that a value exists at that index
-		if (cache[i][j].valid == 1 && cache[i][j].tag == line->tag) {
-			// value trying to insert already exists
-			return true;
+//
+//	Function to run one batch of a single configuration, on the shards if
+//	there are any, filtered to the sampled sets if there is a sampler,
+//	translated first if there is a TLB, timed if there is a timing model, and
+//	split at interval boundaries when intervals is not NULL. before is the
+//	number of accesses ahead of the batch.
+//
+bool SimulateBatch (cacheSweep *sweep, shardedSim *shards, tlbSystem *tlb, timingModel *timing,
+	setSampler *sampler, intervalLog *intervals, const traceBatch *batch, uint64_t before) {
+	traceBatch kept;
+	if (sampler != NULL) {
+		if (!SampleBatch(sampler, batch, &kept)) {
+			fprintf(stderr, "Out of memory for the sampled batch\n");
+			return false;
+		}
+		batch = &kept;
+	}
+	if (intervals == NULL) {
+		if (shards != NULL) {
+			ShardBatch(shards, batch);
+		}
+		else if (tlb != NULL) {
+			SimulateTranslated(tlb, &sweep->hierarchies[0], batch);
+		}
+		else if (timing != NULL) {
+			SimulateTimed(timing, &sweep->hierarchies[0], batch);
 		}
 		else {
-			// found an empty line
-			cache[i][j] = *line;
-			cache[i][j].valid = 1;
-			return false;
+			SimulateSweep(sweep, batch);
 		}
+		return true;
 	}
-	// Reached the end of the set. Need to round robin replace.
-	// finds where the new line should go
-	int new_line = RRstate[j]%8;
-	// puts the new line into the cache where the RRstate said it belongs
-	cache[new_line][j] = *line;
-	// increments RRstate to know where to insert a new line next time
-	RRstate[j]++;
-	return false;
-}
-//@pre: Cache is not initialized
-//@post: initialize cache sequentially
-//@return: none
-//@brief: This fucntion builds out the global cache object that we will use
-void buildCache(){
-	for(size_t i = 0; i < Lines_Nbr; i++) {
-		for (size_t j = 0; j < CacheAssociativity; j++) {
-			cache[i][j].valid = 0;
-			cache[i][j].tag = 0;
-			cache[i][j].line = 0;
+	for (size_t done = 0; done < batch->count; ) {
+		bool boundary = false;
+		traceBatch chunk = NextIntervalChunk(intervals, batch, done, &boundary);
+		done += chunk.count;
+		if (shards != NULL) {
+			ShardBatch(shards, &chunk);
+			if (boundary) {
+				ShardInterval(shards);
+			}
+		}
+		else {
+			if (tlb != NULL) {
+				SimulateTranslated(tlb, &sweep->hierarchies[0], &chunk);
+			}
+			else if (timing != NULL) {
+				SimulateTimed(timing, &sweep->hierarchies[0], &chunk);
+			}
+			else {
+				SimulateSweep(sweep, &chunk);
+			}
+			if (boundary && !RecordInterval(intervals, &sweep->hierarchies[0], before + done)) {
+				fprintf(stderr, "Out of memory for the interval statistics\n");
+				return false;
+			}
 		}
 	}
+	return true;
 }
 
-//@pre: a 32-Bit Address
-//@post: no change to main cache
-//@return: Extracted Line From Address
-int ParseLineFromAddress(uint32_t MyAddress){
-	return (MyAddress >> BlockSize_Exp) & Lines_Mask;
+//
+//	Function to cut a batch down to the accesses of the trace from index skip
+//	up to, not including, index stop. read is the number of accesses of the
+//	trace read before the batch.
+//
+traceBatch ClipBatch (const traceBatch *batch, uint64_t read, uint64_t skip, uint64_t stop) {
+	uint64_t end = stop - read < batch->count ? (stop > read ? stop - read : 0) : batch->count;
+	uint64_t first = skip > read ? skip - read : 0;
+	if (first > end) {
+		first = end;
+	}
+	traceBatch clipped = {
+		batch->addresses != NULL ? batch->addresses + first : NULL,
+		batch->records != NULL ? batch->records + first : NULL,
+		(size_t)(end - first)
+	};
+	return clipped;
 }
 
-//@pre: 32-Bit Address
-//@post: no change to main cache
-//@return: Extracted Tag From address
-int ParseTagFromAddress(uint32_t MyAddress){
-	return ((MyAddress >> (BlockSize_Exp + Lines_Exp)) & Tag_Mask);
+//
+//	Function to run every trace of a manifest against the sweep
+//	configurations, or the command line configuration without any, on
+//	workers threads, writing the rows to outputName (JSON if it ends in
+//	.json) or stdout.
+//
+bool RunManifest (const char *manifestName, cacheSweep *sweep, const hierarchyConfig *config, int workers,
+	unsigned traceFlags, const char *outputName) {
+	if (sweep->count == 0 && !AddSweepConfig(sweep, "", config)) {
+		return false;
+	}
+	batchRun batch;
+	initBatch(&batch);
+	if (!LoadBatchManifest(&batch, manifestName, sweep)) {
+		destroyBatch(&batch);
+		return false;
+	}
+	FILE *output = stdout;
+	if (outputName != NULL && (output = fopen(outputName, "w")) == NULL) {
+		perror(outputName);
+		destroyBatch(&batch);
+		return false;
+	}
+	size_t length = outputName != NULL ? strlen(outputName) : 0;
+	bool json = length >= 5 && strcasecmp(outputName + length - 5, ".json") == 0;
+	bool ok = RunBatch(&batch, workers, traceFlags, output, json);
+	if (output != stdout && fclose(output) != 0) {
+		perror(outputName);
+		ok = false;
+	}
+	destroyBatch(&batch);
+	return ok;
 }
 
-//@pre:
-//@post:
-cacheBlock* BuildCacheBlockFromTagAndLine(int tag, int line){
-	cacheBlock* newBlock = malloc(sizeof(cacheBlock));
-	newBlock->line = line;
-	newBlock->tag = tag;
-	newBlock->valid = 1;
-	return newBlock;
+void PrintUsage (const char *program) {
+	printf("USAGE: %s [options] <Desired Binary Input File | ->\n", program);
+	printf("       %s [options] -g <generator spec>\n", program);
+	printf("  -c <file>   read cache parameters from a config file (key = value)\n");
+	printf("  -s <bytes>  cache size, e.g. 32K (cache_size)\n");
+	printf("  -b <bytes>  block size, e.g. 64 (block_size)\n");
+	printf("  -a <ways>   associativity (associativity)\n");
+	printf("  -w <bits>   address size in bits (address_size)\n");
+	printf("  -r <name>   replacement policy (replacement): rr, lru, plru, fifo, random,\n");
+	printf("              nru, srrip, brrip, drrip\n");
+	printf("  -l <spec>   add a lower level, e.g. size=256K,ways=8,block=64,inclusion=nine\n");
+	printf("              (inclusion is one of inclusive, exclusive, nine)\n");
+	printf("  every level also takes write_policy=writeback|writethrough and\n");
+	printf("  write_allocate=yes|no, used for the stores of record traces\n");
+	printf("  -M <spec>   add a sweep configuration, levels separated by ';'\n");
+	printf("              e.g. \"size=32K,ways=8;size=256K,ways=8\"\n");
+	printf("  -m <file>   add every sweep configuration in a file, one per line\n");
+	printf("  -t <n>      split the sets of a single configuration across n threads\n");
+	printf("              (with -B, run n jobs at once; one per core by default)\n");
+	printf("  -d <sets>   profile LRU stack distances for caches with that many sets\n");
+	printf("              (1 for fully associative) and print the miss ratio curve\n");
+	printf("  -o <file>   write CSV results (sweep rows, miss ratio curve, intervals) to a file\n");
+	printf("  -g <spec>   simulate a generated stream instead of a trace file, e.g.\n");
+	printf("              zipf,count=10M,footprint=64M,alpha=0.9,seed=7 (sequential, strided,\n");
+	printf("              uniform, zipf, chase, tile; see generator.h for the options)\n");
+	printf("  -p <spec>   give the L1 a prefetcher: nextline, stride, stream or sms, with\n");
+	printf("              optional degree=n and latency=n, e.g. stream,degree=4; lower levels\n");
+	printf("              take prefetch=, prefetch_degree= and prefetch_latency=\n");
+	printf("  -v <spec>   put a victim or miss cache beside the L1: victim or miss, with\n");
+	printf("              optional entries=n, e.g. victim,entries=4; lower levels take\n");
+	printf("              buffer=victim|miss and buffer_entries=n\n");
+	printf("  -3          classify the misses of every level as compulsory, capacity\n");
+	printf("              or conflict\n");
+	printf("  -i <n>      keep hit ratio and misses per thousand accesses (and instructions,\n");
+	printf("              for record traces) of every level for each interval of n\n");
+	printf("              accesses, written as CSV to -o or stdout\n");
+	printf("  -L <n>      live mode for a trace piped from a running program: simulate\n");
+	printf("              whatever has arrived and write each interval of n accesses\n");
+	printf("              as a CSV row to -o or stdout as soon as it ends\n");
+	printf("  -x <file>   write the accesses and misses of every set of every level as CSV\n");
+	printf("  -X <file>   the same, as a binary file (see stats.h)\n");
+	printf("  -T <spec>   translate every access through a dTLB and STLB first, walking\n");
+	printf("              the page table through the caches on a miss; spec is a page\n");
+	printf("              size (4k, 2m, 1g) and options, e.g. 2m,huge=0.5 (see tlb.h)\n");
+	printf("  -P <spec>   time every access: an MSHR count and options, e.g.\n");
+	printf("              12,width=4,window=224,latency=4:14:40,memory_latency=200 (gap=n\n");
+	printf("              sets the instructions before each raw address; see timing.h)\n");
+	printf("  -e <f>      simulate a random fraction f of the sets (e.g. 1/32, optionally\n");
+	printf("              followed by ,seed=n) and estimate every level with a 95%% interval\n");
+	printf("  -k <file>[@n] write a checkpoint of the warm state after n accesses of the\n");
+	printf("              trace and stop there (at the end of the trace without @n)\n");
+	printf("  -R <file>[@n] restore a checkpoint of the same configuration and skip the\n");
+	printf("              accesses it was taken after (n of them with @n, e.g. @0)\n");
+	printf("  -C <n>[,p]  give each of n cores a private L1, kept coherent with protocol p\n");
+	printf("              (mesi, the default, or moesi); the core of an access is the core\n");
+	printf("              of its trace record, modulo n, and the lower levels are shared\n");
+	printf("  -B <file>   run every trace of a manifest, one per line and each optionally\n");
+	printf("              followed by a configuration, against that configuration or\n");
+	printf("              every -M/-m one; one CSV row per pair to -o or stdout, or JSON\n");
+	printf("              when -o names a .json file (see batch.h)\n");
+	printf("  -H          ask for huge pages for the trace memory\n");
+	printf("  -S          stream the trace with read() instead of mapping it\n");
+	printf("The trace may hold raw 32-bit addresses, records, or either packed by traceconv.\n");
+	printf("-s/-b/-a/-w/-r set the L1; config files select lower levels with [L2], [L3], ...\n");
+	printf("With -M or -m every sweep configuration is simulated in one pass of the trace\n");
+	printf("and reported as one CSV row; the single-configuration options are ignored.\n");
+	printf("Options are applied in order, so later ones override earlier ones.\n");
 }
 
 //=============================================================================
 //
 //	Main function
 //
-int main (int argc, const char * argv[]) {
-	if (argc < 2) {
-		printf("Too Few Arguments\nUSAGE: ./cacheSim <Desired Binary Input File>\n");
+int main (int argc, char * const argv[]) {
+	hierarchyConfig config;
+	DefaultHierarchyConfig(&config);
+	cacheConfig *l1 = &config.levels[0].cache;
+
+	cacheSweep sweep;
+	initSweep(&sweep);
+
+	unsigned traceFlags = 0;
+	int threads = 0;
+	long profileSets = 0;
+	const char *outputName = NULL;
+	const char *generatorSpec = NULL;
+	bool classify = false;
+	uint64_t intervalLength = 0;
+	bool live = false;
+	const char *setStatsName = NULL;
+	bool setStatsBinary = false;
+	tlbConfig tlbSpec;
+	DefaultTlbConfig(&tlbSpec);
+	bool translate = false;
+	timingConfig timingSpec;
+	DefaultTimingConfig(&timingSpec);
+	bool timed = false;
+	double sampleFraction = 0.0;
+	uint64_t sampleSeed = 0;
+	const char *checkpointName = NULL;
+	uint64_t checkpointAt = UINT64_MAX;
+	const char *restoreName = NULL;
+	uint64_t restoreSkip = UINT64_MAX;
+	int coherentCores = 0;
+	coherenceProtocol protocol = MESI;
+	const char *manifestName = NULL;
+	int option;
+	int level;
+	bool ok = true;
+	while (ok && (option = getopt(argc, argv, "c:s:b:a:w:r:l:M:m:t:d:o:g:C:p:v:i:L:x:X:T:P:e:k:R:B:3HSh")) != -1) {
+		switch (option) {
+			case 'c': ok = LoadHierarchyConfigFile(&config, optarg); break;
+			case 's': ok = SetCacheOption(l1, "cache_size", optarg); break;
+			case 'b': ok = SetCacheOption(l1, "block_size", optarg); break;
+			case 'a': ok = SetCacheOption(l1, "associativity", optarg); break;
+			case 'w': ok = SetCacheOption(l1, "address_size", optarg); break;
+			case 'r': ok = SetCacheOption(l1, "replacement", optarg); break;
+			case 'l':
+				level = AddHierarchyLevel(&config);
+				ok = level >= 0 && ParseLevelSpec(&config.levels[level], optarg);
+				break;
+			case 'M': ok = AddSweepSpec(&sweep, optarg); break;
+			case 'm': ok = LoadSweepFile(&sweep, optarg); break;
+			case 't':
+				threads = atoi(optarg);
+				if (threads < 1) {
+					fprintf(stderr, "Thread count must be at least 1\n");
+					ok = false;
+				}
+				break;
+			case 'd': {
+				char *end = NULL;
+				profileSets = strtol(optarg, &end, 10);
+				if (end == optarg || *end != '\0' || profileSets < 1 || (profileSets & (profileSets - 1)) != 0) {
+					fprintf(stderr, "The profiled set count must be a power of two\n");
+					ok = false;
+				}
+				break;
+			}
+			case 'o': outputName = optarg; break;
+			case 'g': generatorSpec = optarg; break;
+			case '3': classify = true; break;
+			case 'i':
+			case 'L':
+				if (!ParseSize(optarg, &intervalLength) || intervalLength == 0) {
+					fprintf(stderr, "The interval must be at least 1 access: %s\n", optarg);
+					ok = false;
+				}
+				live = option == 'L';
+				break;
+			case 'T':
+				translate = true;
+				ok = ParseTlbSpec(&tlbSpec, optarg);
+				break;
+			case 'P':
+				timed = true;
+				ok = ParseTimingSpec(&timingSpec, optarg);
+				break;
+			case 'e': ok = ParseSampleSpec(optarg, &sampleFraction, &sampleSeed); break;
+			case 'k': ok = ParseCheckpointSpec(optarg, &checkpointName, &checkpointAt); break;
+			case 'R': ok = ParseCheckpointSpec(optarg, &restoreName, &restoreSkip); break;
+			case 'x':
+			case 'X':
+				setStatsName = optarg;
+				setStatsBinary = option == 'X';
+				break;
+			case 'p': ok = ParsePrefetchSpec(&config.levels[0].prefetch, optarg); break;
+			case 'v': ok = ParseVictimSpec(&config.levels[0].victim, optarg); break;
+			case 'C': ok = ParseCoherenceSpec(optarg, &coherentCores, &protocol); break;
+			case 'B': manifestName = optarg; break;
+			case 'H': traceFlags |= TRACE_HUGEPAGES; break;
+			case 'S': traceFlags |= TRACE_NO_MMAP; break;
+			case 'h': PrintUsage(argv[0]); return 0;
+			default: ok = false; break;
+		}
+	}
+	if (!ok || !ConfigureHierarchy(&config)) {
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (manifestName != NULL) {
+		if (profileSets > 0 || coherentCores > 0 || classify || intervalLength > 0 || setStatsName != NULL
+			|| translate || timed || sampleFraction > 0.0 || checkpointName != NULL || restoreName != NULL
+			|| generatorSpec != NULL || optind < argc) {
+			fprintf(stderr, "-B runs the traces of its manifest and cannot be used with -d, -C, -3, -i, -L, -x,"
+				" -T, -P, -e, -k, -R, -g or a trace file\n");
+			destroySweep(&sweep);
+			return 2;
+		}
+		ok = RunManifest(manifestName, &sweep, &config, threads, traceFlags, outputName);
+		destroySweep(&sweep);
+		return ok ? 1 : 2;
+	}
+	if (threads > 1 && sweep.count > 0) {
+		fprintf(stderr, "-t shards a single configuration and cannot be used with a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (profileSets > 0 && (threads > 1 || sweep.count > 0)) {
+		fprintf(stderr, "-d profiles the trace on one thread and cannot be used with -t or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (coherentCores > 0 && (threads > 1 || sweep.count > 0 || profileSets > 0)) {
+		fprintf(stderr, "-C simulates one configuration and cannot be used with -t, -d or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (classify && (threads > 1 || sweep.count > 0 || profileSets > 0 || coherentCores > 0)) {
+		fprintf(stderr, "-3 classifies one configuration and cannot be used with -t, -d, -C or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if ((intervalLength > 0 || setStatsName != NULL) && (sweep.count > 0 || profileSets > 0 || coherentCores > 0)) {
+		fprintf(stderr, "-i and -x follow one configuration and cannot be used with -d, -C or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (live && threads > 1) {
+		fprintf(stderr, "-L reports as the trace arrives and cannot be used with -t\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (live) {
+		traceFlags |= TRACE_LIVE;
+	}
+	if (translate && (threads > 1 || sweep.count > 0 || profileSets > 0 || coherentCores > 0)) {
+		fprintf(stderr, "-T translates one configuration and cannot be used with -t, -d, -C or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (timed && (threads > 1 || sweep.count > 0 || profileSets > 0 || coherentCores > 0 || translate)) {
+		fprintf(stderr, "-P times one configuration and cannot be used with -t, -d, -C, -T or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (sampleFraction > 0.0 && (sweep.count > 0 || profileSets > 0 || coherentCores > 0 || translate || timed
+		|| classify || intervalLength > 0 || checkpointName != NULL)) {
+		fprintf(stderr, "-e samples one configuration and cannot be used with -d, -C, -T, -P, -3, -i, -k or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if ((checkpointName != NULL || restoreName != NULL) && (sweep.count > 0 || profileSets > 0
+		|| coherentCores > 0 || translate || timed || classify)) {
+		fprintf(stderr, "-k and -R keep the state of one configuration and cannot be used with -d, -C, -T, -P, -3"
+			" or a sweep\n");
+		destroySweep(&sweep);
+		return 2;
+	}
+	if (threads > 1 && !CheckSharding(&config, &threads)) {
+		destroySweep(&sweep);
+		return 2;
+	}
+
+	if (optind >= argc && generatorSpec == NULL) {
+		printf("Too Few Arguments\n");
+		PrintUsage(argv[0]);
+		destroySweep(&sweep);
 		return 0;
 	}
 	else{
@@ -183,78 +779,261 @@ int main (int argc, const char * argv[]) {
 		//	Local variables
 		//
 		float hitRatio = 0.0;
-		FILE *myBinaryFile;
-		const char* file_name = argv[1];
+		const char* file_name = generatorSpec != NULL ? generatorSpec : argv[optind];
+		FILE *output = stdout;
+		if (outputName != NULL && (output = fopen(outputName, "w")) == NULL) {
+			perror(outputName);
+			destroySweep(&sweep);
+			return 2;
+		}
 
 		//
-		//	Allocate a Cache Sim
+		//	Everything built from here on is zeroed first and released at
+		//	cleanup, which every exit goes through
 		//
-		buildCache();
+		intervalLog intervals = { 0 };
+		tlbSystem tlb = { 0 };
+		timingModel timingState = { 0 };
+		setSampler sampler = { 0 };
+		coherentSystem coherent = { 0 };
+		traceReader trace;
+		bool opened = false;
 
 		//
-		//	Report cache parameters
+		//	Allocate a Cache Sim. Without a sweep the command line
+		//	configuration is a sweep of one.
 		//
-		ReportParameters(file_name);
+		bool sweeping = sweep.count > 0;
+		if (!sweeping) {
+			sweep.count = 1;
+			sweep.capacity = 1;
+			sweep.specs = calloc(1, sizeof(char *));
+			sweep.configs = malloc(sizeof(hierarchyConfig));
+			sweep.configs[0] = config;
+		}
+		if (!buildSweep(&sweep)) {
+			fprintf(stderr, "Unable to allocate the cache\n");
+			ok = false;
+			goto cleanup;
+		}
+		cacheHierarchy *hierarchy = &sweep.hierarchies[0];
+		if (classify && !ClassifyHierarchyMisses(hierarchy)) {
+			fprintf(stderr, "Unable to allocate the miss classifiers\n");
+			ok = false;
+			goto cleanup;
+		}
+		if ((setStatsName != NULL || sampleFraction > 0.0) && !CountHierarchySets(hierarchy)) {
+			fprintf(stderr, "Unable to allocate the per-set counters\n");
+			ok = false;
+			goto cleanup;
+		}
+		if (!buildIntervalLog(&intervals, intervalLength > 0 ? intervalLength : 1, hierarchy->levelCount)) {
+			fprintf(stderr, "Unable to allocate the interval statistics\n");
+			ok = false;
+			goto cleanup;
+		}
+		intervalLog *intervalLogged = intervalLength > 0 ? &intervals : NULL;
+		if (translate && !buildTlb(&tlb, &tlbSpec, l1)) {
+			ok = false;
+			goto cleanup;
+		}
+		tlbSystem *translation = translate ? &tlb : NULL;
+		if (timed && !buildTimingModel(&timingState, &timingSpec, l1)) {
+			ok = false;
+			goto cleanup;
+		}
+		timingModel *timing = timed ? &timingState : NULL;
+		if (sampleFraction > 0.0 && !buildSetSampler(&sampler, &config, sampleFraction, sampleSeed)) {
+			ok = false;
+			goto cleanup;
+		}
+		setSampler *sampling = sampleFraction > 0.0 ? &sampler : NULL;
 
 		//
-		//	Open address trace file, reset counters, and process Accesses_Max addresses
+		//	Report cache parameters
 		//
-		//Need to Set Up variables Here for Searching the Cache
-
-		int blockIndex = 0;
-		int found_Value = 0;
-		uint32_t cache_Line = 0;
-		uint32_t cache_Tag = 0;
-		int iter = 0;
-		cacheBlock* testerBlock = malloc(sizeof(cacheBlock));
-		//This is going to be your buffer Growney
-		uint32_t GrowneyAddress = 0;
+		if (!sweeping && profileSets == 0) {
+			ReportParameters(file_name, &config);
+		}
+		if (coherentCores > 0) {
+			if (!buildCoherentSystem(&coherent, &config, coherentCores, protocol)) {
+				ok = false;
+				goto cleanup;
+			}
+			printf("Coherence: %d cores, %s\n", coherentCores, CoherenceProtocolName(protocol));
+		}
 
 		//
-		// Growney's Variables
+		//	Restore a warm state and skip the accesses it was taken after;
+		//	without -k the run goes to the end of the trace
 		//
-		int limit = 0;
-
-		unsigned char buffer[4];
-		uint32_t instruction;
-		myBinaryFile = fopen(file_name,"rb");
-
-		while (!feof(myBinaryFile)) {
-			fread(&buffer,sizeof(buffer),1,myBinaryFile);
-			memcpy(&instruction,buffer,4);
-
-			for(int k=0;k <4;k++){
-				buffer[k]=0;
+		uint64_t skip = 0;
+		uint64_t stop = checkpointName != NULL ? checkpointAt : UINT64_MAX;
+		if (restoreName != NULL) {
+			uint64_t taken = 0;
+			if (!RestoreCheckpoint(hierarchy, restoreName, &taken)) {
+				ok = false;
+				goto cleanup;
 			}
-			limit++;
-
-			GrowneyAddress = instruction;
+			skip = restoreSkip != UINT64_MAX ? restoreSkip : taken;
+			printf("Restored %s, taken after %llu accesses; skipping %llu\n", restoreName,
+				(unsigned long long)taken, (unsigned long long)skip);
+		}
+		if (stop < skip) {
+			fprintf(stderr, "The checkpoint index %llu comes before the %llu accesses skipped\n",
+				(unsigned long long)stop, (unsigned long long)skip);
+			ok = false;
+			goto cleanup;
+		}
+		uint64_t simulated = 0;
 
-			cache_Line = ParseLineFromAddress(GrowneyAddress);
-			cache_Tag = ParseTagFromAddress(GrowneyAddress);
-			testerBlock = BuildCacheBlockFromTagAndLine(cache_Tag, cache_Line);
+		//
+		//	Open address trace file, reset counters, and process every address
+		//
+		opened = generatorSpec != NULL ? OpenGeneratedTrace(&trace, generatorSpec)
+			: OpenTrace(&trace, file_name, traceFlags);
+		if (!opened) {
+			ok = false;
+			goto cleanup;
+		}
+		intervals.records = TraceHasRecords(&trace);
+		if (live) {
+			if (output == stdout) {
+				printf("\n");
+			}
+			StreamIntervals(&intervals, output);
+		}
 
-			// NOTE: testerBlock = cacheBlock; line of file we just read
-			//			 cache_Line = cacheBlock; our 2D array cache
-			//			 RRstate = array; The global RRstate array;
-			if(RoundRobin(testerBlock, cache_Line, RRstate)) {
-				hits++;
+		traceBatch batch;
+		if (profileSets > 0) {
+			stackProfile profile;
+			if (!buildStackProfile(&profile, (uint32_t)profileSets, l1->blockSize_Exp)) {
+				fprintf(stderr, "Unable to allocate the stack distance profile\n");
+				ok = false;
+				goto cleanup;
 			}
-			else {
-				misses++;
+			while (ok && NextTraceBatch(&trace, &batch) > 0) {
+				ok = ProfileBatch(&profile, &batch);
+			}
+			if (!ok || trace.failed) {
+				destroyStackProfile(&profile);
+				ok = false;
+				goto cleanup;
+			}
+			printf("\nStack distance profile: %ld sets of %u byte blocks, %llu accesses, %llu cold misses\n",
+				profileSets, 1u << l1->blockSize_Exp, (unsigned long long)profile.accesses,
+				(unsigned long long)profile.coldMisses);
+			ReportMissRatioCurve(&profile, output);
+			destroyStackProfile(&profile);
+		}
+		else if (coherentCores > 0) {
+			while (NextTraceBatch(&trace, &batch) > 0) {
+				SimulateCoherent(&coherent, &batch);
 			}
 		}
+		else if (threads > 1) {
+			shardedSim shards;
+			if (!StartShards(&shards, hierarchy, threads, TraceHasRecords(&trace), intervalLogged)) {
+				fprintf(stderr, "Unable to start %d threads\n", threads);
+				ok = false;
+				goto cleanup;
+			}
+			while (ok && trace.addressesRead < stop && NextTraceBatch(&trace, &batch) > 0) {
+				traceBatch part = ClipBatch(&batch, trace.addressesRead - batch.count, skip, stop);
+				ok = SimulateBatch(&sweep, &shards, NULL, NULL, sampling, intervalLogged, &part, simulated);
+				simulated += part.count;
+			}
+			if (intervalLogged != NULL && intervals.pending > 0) {
+				ShardInterval(&shards);
+			}
+			ok = FinishShards(&shards) && ok;
+		}
+		else {
+			while (ok && trace.addressesRead < stop && NextTraceBatch(&trace, &batch) > 0) {
+				traceBatch part = ClipBatch(&batch, trace.addressesRead - batch.count, skip, stop);
+				ok = SimulateBatch(&sweep, NULL, translation, timing, sampling, intervalLogged, &part, simulated);
+				simulated += part.count;
+			}
+			if (ok && intervalLogged != NULL && intervals.pending > 0) {
+				ok = RecordInterval(&intervals, hierarchy, simulated);
+			}
+		}
+		if (trace.failed) {
+			ok = false;
+			goto cleanup;
+		}
+		uint64_t limit = profileSets > 0 || coherentCores > 0 ? trace.addressesRead : simulated;
 
 		//
 		//	Report cache performance
 		//
-		hitRatio = ((float)(hits)/((float)(hits+misses))*100.00);
-		printf("\nTotal Addresses processed: %d", limit);
-		printf("\nHits: %d", hits);
-		printf("\nMisses: %d", misses);
-		printf("\nHit Ratio: %f\n", hitRatio);
+		if (sweeping) {
+			ReportSweep(&sweep, output);
+		}
+		else if (coherentCores > 0) {
+			ReportCoherence(&coherent, limit);
+		}
+		else if (profileSets == 0) {
+			uint64_t hits = hierarchy->levels[0].hits;
+			uint64_t misses = hierarchy->levels[0].misses;
+			hitRatio = ((float)(hits)/((float)(hits+misses))*100.00);
+			printf("\nTotal Addresses processed: %llu", (unsigned long long)limit);
+			printf("\nHits: %llu", (unsigned long long)hits);
+			printf("\nMisses: %llu", (unsigned long long)misses);
+			printf("\nHit Ratio: %f\n", hitRatio);
+			if (hierarchy->levelCount > 1 || TraceHasRecords(&trace) || HierarchyPrefetches(&config) || translate
+				|| HierarchyBuffers(&config) || timed) {
+				ReportHierarchy(hierarchy, 1, TraceHasRecords(&trace));
+				ReportPrefetchers(hierarchy, 1);
+				ReportVictimBuffers(hierarchy, 1);
+			}
+			if (translate) {
+				ReportTlb(&tlb, hierarchy);
+			}
+			if (timed) {
+				ReportTiming(&timingState, hierarchy);
+			}
+			if (sampling != NULL) {
+				ok = ReportSampling(&sampler, hierarchy, limit) && ok;
+			}
+			if (classify) {
+				ReportMissClasses(hierarchy);
+			}
+			if (intervalLogged != NULL && !live) {
+				if (output == stdout) {
+					printf("\n");
+				}
+				WriteIntervals(&intervals, output);
+			}
+			if (setStatsName != NULL) {
+				ok = WriteSetStats(hierarchy, setStatsName, setStatsBinary) && ok;
+			}
+		}
 
-		fclose(myBinaryFile);
+		if (ok && checkpointName != NULL) {
+			uint64_t index = skip + simulated;
+			ok = WriteCheckpoint(hierarchy, index, checkpointName);
+			if (ok) {
+				printf("\nCheckpoint written to %s after %llu accesses\n", checkpointName, (unsigned long long)index);
+			}
+		}
+
+	cleanup:
+		if (opened) {
+			CloseTrace(&trace);
+		}
+		destroyCoherentSystem(&coherent);
+		destroyIntervalLog(&intervals);
+		destroyTlb(&tlb);
+		destroyTimingModel(&timingState);
+		destroySetSampler(&sampler);
+		destroySweep(&sweep);
+		if (output != stdout) {
+			fclose(output);
+		}
+		if (!ok) {
+			return 2;
+		}
 		//
 		//	Return 1 for success
 		//
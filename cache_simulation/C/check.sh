@@ -0,0 +1,225 @@
+#!/bin/sh
+#@author: Patrick Canny, Andrew Growney, Liam Ormiston
+#@brief: Reproducible checks of the simulator, run by make check
+#
+#	Description:
+#			Every check runs cachesim on generated traces, so it needs
+#			nothing but the binaries. There are two kinds of check:
+#
+#			same     -- two runs must print the same output, e.g. a sharded
+#			            run and the serial run of one configuration
+#			expected -- a run must print check/<name>.out exactly; the file
+#			            was committed when its result was verified
+#
+#			CHECK_UPDATE=1 ./check.sh rewrites the expected files instead of
+#			comparing against them.
+#
+
+SIM=./cachesim
+CONV=./traceconv
+TMP=$(mktemp -d) || exit 2
+trap 'rm -rf "$TMP"' EXIT
+checks=0
+failures=0
+
+# fail <label>: count a failed check and show how the outputs differ
+fail() {
+	failures=$((failures + 1))
+	echo "FAIL: $1"
+	diff "$TMP/a" "$TMP/b" | head -n 10
+}
+
+# run <arguments> <file>: cachesim prints to file; exits 2 on a bad run
+run() {
+	$SIM $1 > "$2" 2>&1
+	[ $? -ne 2 ]
+}
+
+# same <label> <arguments> <arguments>: both runs print the same output
+same() {
+	checks=$((checks + 1))
+	if ! run "$2" "$TMP/a" || ! run "$3" "$TMP/b"; then
+		fail "$1 (the run failed)"
+		return
+	fi
+	cmp -s "$TMP/a" "$TMP/b" || fail "$1"
+}
+
+# expected <name> <arguments>: the run prints check/<name>.out
+expected() {
+	checks=$((checks + 1))
+	if ! run "$2" "$TMP/b"; then
+		: > "$TMP/a"
+		fail "$1 (the run failed)"
+		return
+	fi
+	if [ -n "$CHECK_UPDATE" ]; then
+		cp "$TMP/b" "check/$1.out"
+		return
+	fi
+	cp "check/$1.out" "$TMP/a" 2>/dev/null || : > "$TMP/a"
+	cmp -s "$TMP/a" "$TMP/b" || fail "$1"
+}
+
+# matching <label> <pattern> <arguments> <arguments>: the lines of the two
+# runs that match pattern are the same
+matching() {
+	checks=$((checks + 1))
+	if ! run "$3" "$TMP/run" || ! grep "$2" "$TMP/run" > "$TMP/a" \
+		|| ! run "$4" "$TMP/run" || ! grep "$2" "$TMP/run" > "$TMP/b"; then
+		fail "$1 (the run failed)"
+		return
+	fi
+	cmp -s "$TMP/a" "$TMP/b" || fail "$1"
+}
+
+# roundtrip <label> <traceconv options> <trace>: packing the trace and
+# unpacking it again gives back the same bytes
+roundtrip() {
+	checks=$((checks + 1))
+	if ! $CONV $2 "$3" "$TMP/packed" 2> /dev/null || ! $CONV -u "$TMP/packed" "$TMP/b" 2> /dev/null; then
+		: > "$TMP/a"; : > "$TMP/b"
+		fail "$1 (the conversion failed)"
+		return
+	fi
+	cp "$3" "$TMP/a"
+	cmp -s "$TMP/a" "$TMP/b" || fail "$1"
+}
+
+# resumed <label> <arguments> <n>: a run restored from a checkpoint taken
+# after n accesses prints the same intervals of n accesses as the full run
+# does after its first
+resumed() {
+	checks=$((checks + 1))
+	if ! run "$2 -i $3" "$TMP/run" || ! run "$2 -k $TMP/warm@$3" "$TMP/warmup" \
+		|| ! run "$2 -R $TMP/warm -i $3" "$TMP/restored"; then
+		: > "$TMP/a"; : > "$TMP/b"
+		fail "$1 (the run failed)"
+		return
+	fi
+	grep '^[1-9][0-9]*,' "$TMP/run" | cut -d, -f2- > "$TMP/a"
+	grep '^[0-9][0-9]*,' "$TMP/restored" | cut -d, -f2- > "$TMP/b"
+	[ -s "$TMP/a" ] && cmp -s "$TMP/a" "$TMP/b" || fail "$1"
+}
+
+# curve <label> <profile arguments> <ways> <arguments>: the misses the miss
+# ratio curve gives for ways equal the misses of the simulated run
+curve() {
+	checks=$((checks + 1))
+	if ! run "$2" "$TMP/curve" || ! run "$4" "$TMP/run"; then
+		: > "$TMP/a"; : > "$TMP/b"
+		fail "$1 (the run failed)"
+		return
+	fi
+	awk -F, -v ways="$3" '$1 == ways { print "misses " $3 }' "$TMP/curve" > "$TMP/a"
+	awk '/^Misses:/ { print "misses " $2 }' "$TMP/run" > "$TMP/b"
+	[ -s "$TMP/a" ] && cmp -s "$TMP/a" "$TMP/b" || fail "$1"
+}
+
+#=============================================================================
+# SHARDING: -t n prints what the serial run prints
+#
+RAW="-g zipf,count=300K,footprint=4M,seed=11"
+RECORDS="-g uniform,count=200K,footprint=2M,stores=0.3,seed=12"
+for policy in rr lru plru fifo random nru srrip; do
+	for inclusion in inclusive exclusive nine; do
+		config="-s 16K -a 4 -r $policy -l size=128K,ways=8,replacement=$policy,inclusion=$inclusion"
+		for threads in 2 4; do
+			same "-t $threads $policy $inclusion" "$config $RAW" "-t $threads $config $RAW"
+		done
+	done
+done
+for write in writeback writethrough; do
+	for allocate in yes no; do
+		config="-s 16K -a 4 -r lru -l size=128K,ways=8,write_policy=$write,write_allocate=$allocate,inclusion=inclusive"
+		same "-t 4 records $write $allocate" "$config $RECORDS" "-t 4 $config $RECORDS"
+	done
+done
+same "-t 4 three levels" "-s 8K -a 2 -l size=64K,ways=4,inclusion=exclusive -l size=512K,ways=8 $RECORDS" \
+	"-t 4 -s 8K -a 2 -l size=64K,ways=4,inclusion=exclusive -l size=512K,ways=8 $RECORDS"
+same "-t 3 intervals" "-s 16K -a 4 -l size=128K,ways=8 -i 50K $RAW" "-t 3 -s 16K -a 4 -l size=128K,ways=8 -i 50K $RAW"
+
+#=============================================================================
+# STACK DISTANCES: the miss ratio curve equals LRU runs of every capacity,
+# and check/stackdist.out was checked against a separate LRU stack model
+#
+PROFILED="-g zipf,count=100K,footprint=256K,seed=21"
+for ways in 1 2 4 8 16; do
+	curve "-d 64 at $ways ways" "-d 64 $PROFILED" $ways "-s $((4 * ways))K -a $ways -r lru $PROFILED"
+done
+for ways in 64 128 256 512; do
+	curve "-d 1 at $ways ways" "-d 1 $PROFILED" $ways "-s $((ways / 16))K -a $ways -r lru $PROFILED"
+done
+expected stackdist "-d 32 $PROFILED"
+
+#=============================================================================
+# INDEXED SETS: sets of 64 or more ways find tags through a hash index, and
+# check/indexed-*.out were written by the build before the index, which
+# compared every tag
+#
+INDEXED="-g zipf,count=200K,footprint=4M,seed=41"
+for policy in rr lru plru fifo random nru srrip drrip; do
+	expected indexed-$policy "-s 128K -a 128 -r $policy $INDEXED"
+done
+for inclusion in inclusive exclusive nine; do
+	expected indexed-$inclusion "-s 16K -a 4 -l size=512K,ways=256,replacement=lru,inclusion=$inclusion $RECORDS"
+done
+
+#=============================================================================
+# COHERENCE: check/sharing.trc has core 1 store to blocks core 0 reads. Core
+# 0 misses on them once as false sharing, and three times as true sharing:
+# after an upgrade, after a store that hit in M, and after its way was reused
+#
+expected sharing "-s 4K -a 2 -C 2 check/sharing.trc"
+
+#=============================================================================
+# WRITE POLICIES: the bytes written back and written through, checked in
+# check/writepolicy-*.out against a separate single level LRU model
+#
+STORES="-g uniform,count=50K,footprint=32K,stores=0.3,seed=31"
+for write in writeback writethrough; do
+	for allocate in yes no; do
+		printf 'cache_size = 8K\nassociativity = 4\nreplacement = lru\nwrite_policy = %s\nwrite_allocate = %s\n' \
+			$write $allocate > "$TMP/$write-$allocate.cfg"
+		expected writepolicy-$write-$allocate "-c $TMP/$write-$allocate.cfg $STORES"
+	done
+done
+# Written-through data is a write: an exclusive L2 below a write-through L1
+# sees the same demand accesses as below a write-back one
+expected writepolicy-exclusive "-c $TMP/writethrough-yes.cfg -l size=64K,ways=8,inclusion=exclusive -g zipf,count=100K,footprint=1M,stores=0.3,seed=7"
+
+#=============================================================================
+# TIMING: a store is served where its fetch hit, so a stream of stores that
+# all miss is timed the same whether the L1 writes back or through
+#
+TIMED="-l size=64K,ways=8 -P 8 -g uniform,count=20000,footprint=16M,stores=1.0,seed=3"
+matching "-P stores write-through" "^AMAT" "-c $TMP/writeback-yes.cfg $TIMED" "-c $TMP/writethrough-yes.cfg $TIMED"
+
+#=============================================================================
+# CHECKPOINTS: a run restored from a checkpoint continues the full run. The
+# L2 has indexed sets, and the strides keep the stream prefetcher and the
+# victim buffer busy right up to the checkpoint (five blocks of one set), so
+# their tables must be restored along with the tags
+#
+CHECKPOINTED="-s 16K -a 4 -r lru -p stream,degree=2 -v victim,entries=8 -l size=512K,ways=64,replacement=lru"
+resumed "-k/-R stream" "$CHECKPOINTED -g strided,stride=128,count=300K,footprint=16M" 100K
+resumed "-k/-R victim" "$CHECKPOINTED -g strided,stride=4K,count=300K,footprint=20K,stores=0.3" 100K
+resumed "-k/-R records" "$CHECKPOINTED $RECORDS" 50K
+
+#=============================================================================
+# PACKED TRACES: traceconv -u undoes traceconv, and cachesim prints the same
+# for a packed trace as for the trace it was packed from, but for the name
+#
+$CONV -u -g zipf,count=300K,footprint=4M,seed=11 "$TMP/raw.trc" || exit 2
+$CONV -u -g uniform,count=200K,footprint=2M,stores=0.3,cores=2,seed=12 "$TMP/records.trc" || exit 2
+for trace in raw records; do
+	roundtrip "packed $trace" "" "$TMP/$trace.trc"
+	roundtrip "packed $trace -z" "-z" "$TMP/$trace.trc"
+	roundtrip "packed $trace -z -c 1000" "-z -c 1000" "$TMP/$trace.trc"
+	$CONV -z "$TMP/$trace.trc" "$TMP/$trace.pkz" 2> /dev/null
+	matching "packed $trace run" "^[^F]" "-s 16K -a 4 -l size=128K,ways=8 $TMP/$trace.trc" \
+		"-s 16K -a 4 -l size=128K,ways=8 $TMP/$trace.pkz"
+done
+
+echo "$checks checks, $failures failed"
+[ "$failures" -eq 0 ]
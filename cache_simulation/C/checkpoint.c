@@ -0,0 +1,245 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Warm-state checkpoints of a cache hierarchy
+//
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+
+//
+//	State arrays of a hierarchy: per level up to 8 of the cache, up to 8 of
+//	the prefetcher and 8 of the buffer
+//
+#define  StateRegions_Max  ( MaxLevels_Nbr * 24 )
+
+//One array of state, written and restored as raw bytes
+typedef struct stateRegion
+{
+	void *data;
+	size_t bytes;
+} stateRegion;
+
+//@return: bytes rounded up to a multiple of 8
+static inline size_t Padded(size_t bytes){
+	return (bytes + 7) & ~(size_t)7;
+}
+
+//@pre: a built cache and room for 8 regions
+//@post: the arrays of its contents and replacement state are listed
+//@return: the number of regions
+static int CacheRegions(cacheLevel *cache, stateRegion *regions){
+	size_t sets = cache->config.lines_Nbr;
+	regions[0] = (stateRegion){ cache->tags, sets * cache->tagStride * sizeof(uint32_t) };
+	regions[1] = (stateRegion){ cache->valid, sets * cache->validWords * sizeof(uint64_t) };
+	regions[2] = (stateRegion){ cache->dirty, sets * cache->validWords * sizeof(uint64_t) };
+	regions[3] = (stateRegion){ cache->replacement.sets, sets * cache->replacement.stride };
+	regions[4] = (stateRegion){ &cache->replacement.psel, sizeof(uint32_t) };
+	regions[5] = (stateRegion){ &cache->replacement.brripCount, sizeof(uint32_t) };
+	if (cache->tagIndex == NULL) {
+		return 6;
+	}
+	regions[6] = (stateRegion){ cache->tagIndex, (sets << cache->indexBits) * sizeof(tagSlot) };
+	regions[7] = (stateRegion){ cache->occupancy, sets * sizeof(setOccupancy) };
+	return 8;
+}
+
+//@pre: a built prefetcher of cache and room for 8 regions
+//@post: the arrays of its tables are listed; none without a prefetcher
+//@return: the number of regions
+static int PrefetcherRegions(prefetcher *prefetch, const cacheLevel *cache, stateRegion *regions){
+	if (prefetch->config.kind == PREFETCH_NONE) {
+		return 0;
+	}
+	size_t sets = cache->config.lines_Nbr;
+	int count = 0;
+	regions[count++] = (stateRegion){ &prefetch->clock, sizeof(uint64_t) };
+	regions[count++] = (stateRegion){ prefetch->prefetched, sets * prefetch->validWords * sizeof(uint64_t) };
+	regions[count++] = (stateRegion){ prefetch->ready, sets * prefetch->ways * sizeof(uint64_t) };
+	regions[count++] = (stateRegion){ prefetch->pollution, PollutionFilter_Nbr * sizeof(uint64_t) };
+	if (prefetch->strides != NULL) {
+		regions[count++] = (stateRegion){ prefetch->strides, StrideTable_Nbr * sizeof(strideEntry) };
+	}
+	if (prefetch->streams != NULL) {
+		regions[count++] = (stateRegion){ prefetch->streams, Streams_Nbr * sizeof(streamEntry) };
+	}
+	if (prefetch->generations != NULL) {
+		regions[count++] = (stateRegion){ prefetch->generations, SmsGenerations_Nbr * sizeof(smsGeneration) };
+		regions[count++] = (stateRegion){ prefetch->patterns,
+			(1ull << (prefetch->regionExp - prefetch->blockSize_Exp)) * sizeof(uint64_t) };
+	}
+	return count;
+}
+
+//@pre: a built hierarchy
+//@post: every state array of every level is listed, in file order
+//@return: the number of regions
+static int HierarchyRegions(cacheHierarchy *hierarchy, stateRegion *regions){
+	int count = 0;
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		count += CacheRegions(&hierarchy->levels[i], regions + count);
+		count += PrefetcherRegions(&hierarchy->prefetchers[i], &hierarchy->levels[i], regions + count);
+		if (hierarchy->victims[i].config.kind != VICTIM_NONE) {
+			count += CacheRegions(&hierarchy->victims[i].blocks, regions + count);
+		}
+	}
+	return count;
+}
+
+//@pre: a built hierarchy
+//@post: words holds the configuration of level that the state depends on
+//@return: none
+static void ConfigWords(const cacheHierarchy *hierarchy, int level, uint32_t *words){
+	const cacheConfig *cache = &hierarchy->levels[level].config;
+	const prefetchConfig *prefetch = &hierarchy->prefetchers[level].config;
+	const victimConfig *victim = &hierarchy->victims[level].config;
+	uint32_t values[CheckpointConfig_Words] = {
+		cache->cacheSize_Exp, cache->addressSize_Exp, cache->associativity, cache->blockSize_Exp,
+		cache->replacement, cache->writeBack, cache->writeAllocate, hierarchy->inclusion[level],
+		prefetch->kind, prefetch->degree, prefetch->latency, victim->kind,
+		victim->kind != VICTIM_NONE ? victim->entries : 0
+	};
+	memcpy(words, values, sizeof(values));
+}
+
+//@pre: spec is a path, optionally followed by @ and an access index such as
+//      "warm.ckpt@10M"
+//@post: spec is cut at the @, *path points to it and *index holds the index
+//       if one was given
+//@return: false (with a message) if the index is malformed
+bool ParseCheckpointSpec(char *spec, const char **path, uint64_t *index){
+	char *at = strrchr(spec, '@');
+	if (at != NULL && !ParseSize(at + 1, index)) {
+		fprintf(stderr, "Bad access index in %s\n", spec);
+		return false;
+	}
+	if (at != NULL) {
+		*at = '\0';
+	}
+	if (*spec == '\0') {
+		fprintf(stderr, "Missing checkpoint file before the @\n");
+		return false;
+	}
+	*path = spec;
+	return true;
+}
+
+//@pre: a built hierarchy that has simulated the first index accesses of a trace
+//@post: path holds a checkpoint of its state
+//@return: false (with a message) if the file cannot be written
+bool WriteCheckpoint(cacheHierarchy *hierarchy, uint64_t index, const char *path){
+	stateRegion regions[StateRegions_Max];
+	int count = HierarchyRegions(hierarchy, regions);
+	uint64_t stateBytes = 0;
+	for (int i = 0; i < count; i++) {
+		stateBytes += Padded(regions[i].bytes);
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		perror(path);
+		return false;
+	}
+	uint8_t header[CheckpointHeader_Bytes] = { 0 };
+	uint32_t levels = (uint32_t)hierarchy->levelCount;
+	uint32_t words = CheckpointConfig_Words;
+	memcpy(header, CheckpointMagic, 8);
+	memcpy(header + 8, &levels, sizeof(levels));
+	memcpy(header + 12, &words, sizeof(words));
+	memcpy(header + 16, &index, sizeof(index));
+	memcpy(header + 24, &stateBytes, sizeof(stateBytes));
+	bool written = fwrite(header, sizeof(header), 1, file) == 1;
+	for (int i = 0; written && i < hierarchy->levelCount; i++) {
+		uint32_t config[CheckpointConfig_Words];
+		ConfigWords(hierarchy, i, config);
+		written = fwrite(config, sizeof(config), 1, file) == 1;
+	}
+	static const uint8_t padding[8] = { 0 };
+	for (int i = 0; written && i < count; i++) {
+		size_t pad = Padded(regions[i].bytes) - regions[i].bytes;
+		written = fwrite(regions[i].data, 1, regions[i].bytes, file) == regions[i].bytes
+			&& fwrite(padding, 1, pad, file) == pad;
+	}
+	if (fclose(file) != 0 || !written) {
+		perror(path);
+		return false;
+	}
+	return true;
+}
+
+//@pre: a freshly built hierarchy
+//@post: the hierarchy holds the state saved in path; its counters are unchanged
+//@return: false (with a message) if the file is not a checkpoint of a
+//         hierarchy configured as this one; *index is the access index the
+//         state was taken at
+bool RestoreCheckpoint(cacheHierarchy *hierarchy, const char *path, uint64_t *index){
+	int fd = open(path, O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0) {
+		perror(path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return false;
+	}
+	size_t length = (size_t)info.st_size;
+	const uint8_t *map = length >= CheckpointHeader_Bytes
+		? mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (map == MAP_FAILED || memcmp(map, CheckpointMagic, 8) != 0) {
+		fprintf(stderr, "%s is not a checkpoint\n", path);
+		if (map != MAP_FAILED) {
+			munmap((void *)map, length);
+		}
+		return false;
+	}
+
+	uint32_t levels = 0;
+	uint32_t words = 0;
+	uint64_t stateBytes = 0;
+	memcpy(&levels, map + 8, sizeof(levels));
+	memcpy(&words, map + 12, sizeof(words));
+	memcpy(index, map + 16, sizeof(*index));
+	memcpy(&stateBytes, map + 24, sizeof(stateBytes));
+	bool ok = levels == (uint32_t)hierarchy->levelCount && words == CheckpointConfig_Words;
+	if (!ok) {
+		fprintf(stderr, "%s holds %u levels; the configuration has %d\n", path, levels, hierarchy->levelCount);
+	}
+	else if (length < CheckpointHeader_Bytes + levels * CheckpointConfig_Words * sizeof(uint32_t)) {
+		fprintf(stderr, "%s is truncated\n", path);
+		ok = false;
+	}
+	const uint8_t *cursor = map + CheckpointHeader_Bytes;
+	for (int i = 0; ok && i < hierarchy->levelCount; i++) {
+		uint32_t config[CheckpointConfig_Words];
+		ConfigWords(hierarchy, i, config);
+		ok = memcmp(cursor, config, sizeof(config)) == 0;
+		if (!ok) {
+			fprintf(stderr, "L%d of %s is configured differently\n", i + 1, path);
+		}
+		cursor += sizeof(config);
+	}
+
+	stateRegion regions[StateRegions_Max];
+	int count = HierarchyRegions(hierarchy, regions);
+	uint64_t expected = 0;
+	for (int i = 0; i < count; i++) {
+		expected += Padded(regions[i].bytes);
+	}
+	if (ok && (stateBytes != expected || (size_t)(cursor - map) + stateBytes != length)) {
+		fprintf(stderr, "%s is truncated or does not match the configuration\n", path);
+		ok = false;
+	}
+	for (int i = 0; ok && i < count; i++) {
+		memcpy(regions[i].data, cursor, regions[i].bytes);
+		cursor += Padded(regions[i].bytes);
+	}
+	munmap((void *)map, length);
+	return ok;
+}
@@ -0,0 +1,40 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Warm-state checkpoints of a cache hierarchy
+//
+//	Description:
+//			A checkpoint holds everything a hierarchy remembers between
+//			accesses: the tags, valid and dirty bits and replacement state of
+//			every level, the tables of its prefetcher and the blocks of its
+//			victim or miss cache. Counters are not kept, so a restored run
+//			counts only its own accesses.
+//
+//			The file is the header, then per level the configuration words
+//			below, then the state arrays in the order of the structures,
+//			each padded to 8 bytes. It is only valid for a hierarchy of the
+//			same configuration; restoring maps the file and copies the
+//			arrays into place.
+//
+//			    bytes 0-7    CheckpointMagic
+//			    8-11         level count
+//			    12-15        configuration words per level
+//			    16-23        access index of the trace the state was taken at
+//			    24-31        bytes of state after the configuration words
+//
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hierarchy.h"
+
+#define  CheckpointMagic        "CSCKPT01"
+#define  CheckpointHeader_Bytes 32
+#define  CheckpointConfig_Words 13
+
+bool ParseCheckpointSpec(char *spec, const char **path, uint64_t *index);
+bool WriteCheckpoint(cacheHierarchy *hierarchy, uint64_t index, const char *path);
+bool RestoreCheckpoint(cacheHierarchy *hierarchy, const char *path, uint64_t *index);
+
+#endif /* CHECKPOINT_H_ */
@@ -0,0 +1,465 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Snooping MESI/MOESI coherence between private L1 caches
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "coherence.h"
+
+typedef enum {STATE_I = 0, STATE_S, STATE_E, STATE_O, STATE_M} lineState;
+
+static const char *const ProtocolNames[] = {"MESI", "MOESI"};
+
+//@pre: none
+//@post: *cores and *protocol hold the values of a spec such as "4" or "4,moesi"
+//@return: false (with a message) if the spec is malformed
+bool ParseCoherenceSpec(const char *spec, int *cores, coherenceProtocol *protocol){
+	char *end = NULL;
+	long count = strtol(spec, &end, 10);
+	if (end == spec || count < 1 || count > MaxCores_Nbr) {
+		fprintf(stderr, "Core count must be 1-%d: %s\n", MaxCores_Nbr, spec);
+		return false;
+	}
+	*cores = (int)count;
+	*protocol = MESI;
+	if (*end == '\0') {
+		return true;
+	}
+	if (*end == ',') {
+		for (int i = 0; i < 2; i++) {
+			if (strcasecmp(end + 1, ProtocolNames[i]) == 0) {
+				*protocol = (coherenceProtocol)i;
+				return true;
+			}
+		}
+	}
+	fprintf(stderr, "Unknown coherence protocol (mesi or moesi): %s\n", spec);
+	return false;
+}
+
+const char *CoherenceProtocolName(coherenceProtocol protocol){
+	return ProtocolNames[protocol];
+}
+
+//=============================================================================
+// STALE SETS
+//
+
+//@return: the home slot of a key in a table of 2^bits slots
+static inline size_t HashBlock(uint64_t key, uint32_t bits){
+	return (size_t)((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+//@pre: a zeroed set
+//@post: the set is empty with 2^bits slots
+//@return: false if memory is short
+static bool buildStaleSet(staleSet *set, uint32_t bits){
+	set->slots = calloc((size_t)1 << bits, sizeof(staleBlock));
+	set->bits = bits;
+	set->count = 0;
+	return set->slots != NULL;
+}
+
+//@return: the slot holding block, or the empty slot ending its probe
+static size_t FindStaleSlot(const staleSet *set, uint64_t block){
+	size_t mask = ((size_t)1 << set->bits) - 1;
+	size_t slot = HashBlock(block + 1, set->bits);
+	while (set->slots[slot].block != 0 && set->slots[slot].block != block + 1) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+//@pre: a built set without block
+//@post: block is in the set with written; the table doubles when half its
+//       slots are used
+//@return: none
+static void AddStaleBlock(staleSet *set, uint64_t block, uint64_t written){
+	size_t mask = ((size_t)1 << set->bits) - 1;
+	// Out of memory earlier: keep one slot empty so every probe still ends
+	if (set->count == mask) {
+		return;
+	}
+	set->slots[FindStaleSlot(set, block)] = (staleBlock){.block = block + 1, .written = written};
+	if (++set->count * 2 <= mask + 1) {
+		return;
+	}
+
+	staleSet grown;
+	if (!buildStaleSet(&grown, set->bits + 1)) {
+		return;
+	}
+	for (size_t i = 0; i <= mask; i++) {
+		if (set->slots[i].block != 0) {
+			grown.slots[FindStaleSlot(&grown, set->slots[i].block - 1)] = set->slots[i];
+		}
+	}
+	grown.count = set->count;
+	free(set->slots);
+	*set = grown;
+}
+
+//@pre: a built set
+//@post: block is no longer in the set; later blocks of its probe run are
+//       shifted back so every probe still reaches its block
+//@return: true, with the bytes stored to the block in *written, if block
+//         was in the set
+static bool TakeStale(staleSet *set, uint64_t block, uint64_t *written){
+	size_t mask = ((size_t)1 << set->bits) - 1;
+	size_t hole = FindStaleSlot(set, block);
+	if (set->slots[hole].block == 0) {
+		return false;
+	}
+	*written = set->slots[hole].written;
+	for (size_t next = (hole + 1) & mask; set->slots[next].block != 0; next = (next + 1) & mask) {
+		size_t home = HashBlock(set->slots[next].block, set->bits);
+		// Move the entry into the hole unless its home lies after the hole
+		if (((next - home) & mask) >= ((next - hole) & mask)) {
+			set->slots[hole] = set->slots[next];
+			hole = next;
+		}
+	}
+	set->slots[hole].block = 0;
+	set->count--;
+	return true;
+}
+
+//@pre: a built set
+//@post: written is added to the bytes stored to block, if it is in the set
+//@return: true if block is in the set
+static bool AddStaleWrite(staleSet *set, uint64_t block, uint64_t written){
+	staleBlock *entry = &set->slots[FindStaleSlot(set, block)];
+	entry->written |= written;
+	return entry->block != 0;
+}
+
+//@pre: an access of size bytes (1 if 0) at address
+//@return: the bits of a stale block's written mask that the access touches,
+//         clipped to the end of its block
+static uint64_t TouchedBytes(const cacheLevel *l1, uint64_t address, uint32_t size){
+	uint32_t exp = l1->config.blockSize_Exp;
+	uint32_t granule = exp > 6 ? exp - 6 : 0;
+	uint64_t offset = address & ((1ull << exp) - 1);
+	uint64_t end = offset + (size > 0 ? size : 1);
+	if (end > 1ull << exp) {
+		end = 1ull << exp;
+	}
+	uint32_t first = (uint32_t)(offset >> granule);
+	uint32_t last = (uint32_t)((end - 1) >> granule);
+	return ((2ull << last) - 1) & ~((1ull << first) - 1);
+}
+
+//=============================================================================
+// COHERENT SYSTEM
+//
+
+//@pre: a configuration whose L1 is write-back and write-allocate
+//@post: one L1 per core and the shared levels are allocated and empty
+//@return: false (with a message) if the L1 cannot keep coherence state or
+//         memory is short
+bool buildCoherentSystem(coherentSystem *system, const hierarchyConfig *config,
+	int cores, coherenceProtocol protocol){
+	memset(system, 0, sizeof(*system));
+	const cacheConfig *l1 = &config->levels[0].cache;
+	if (!l1->writeBack || !l1->writeAllocate) {
+		fprintf(stderr, "Coherent L1s must be write-back and write-allocate\n");
+		return false;
+	}
+	if (config->levels[0].prefetch.kind != PREFETCH_NONE) {
+		fprintf(stderr, "Coherent L1s cannot have a prefetcher; the shared levels can\n");
+		return false;
+	}
+	if (config->levels[0].victim.kind != VICTIM_NONE) {
+		fprintf(stderr, "Coherent L1s cannot have a victim or miss cache; the shared levels can\n");
+		return false;
+	}
+	// Coherence sets the valid bits itself, which an indexed set cannot follow
+	if (l1->associativity >= IndexedSet_MinWays) {
+		fprintf(stderr, "Coherent L1s must have fewer than %d ways\n", IndexedSet_MinWays);
+		return false;
+	}
+	system->protocol = protocol;
+
+	hierarchyConfig shared;
+	shared.levelCount = config->levelCount - 1;
+	for (int i = 0; i < shared.levelCount; i++) {
+		shared.levels[i] = config->levels[i + 1];
+	}
+	if (!buildHierarchy(&system->shared, &shared)) {
+		fprintf(stderr, "Unable to allocate the shared levels\n");
+		return false;
+	}
+
+	system->cores = calloc((size_t)cores, sizeof(coreCache));
+	if (system->cores == NULL) {
+		destroyCoherentSystem(system);
+		return false;
+	}
+	for (int i = 0; i < cores; i++) {
+		coreCache *core = &system->cores[i];
+		system->coreCount = i + 1;
+		bool built = buildCache(&core->l1, l1);
+		size_t words = (size_t)l1->lines_Nbr * core->l1.validWords;
+		core->shared = calloc(words, sizeof(uint64_t));
+		core->watched = calloc(words, sizeof(uint64_t));
+		built = buildStaleSet(&core->stale, StaleSet_InitialBits) && built;
+		if (!built || core->shared == NULL || core->watched == NULL) {
+			fprintf(stderr, "Unable to allocate the L1 of core %d\n", i);
+			destroyCoherentSystem(system);
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: a built or zeroed system
+//@post: all memory is freed
+//@return: none
+void destroyCoherentSystem(coherentSystem *system){
+	for (int i = 0; i < system->coreCount; i++) {
+		destroyCache(&system->cores[i].l1);
+		free(system->cores[i].shared);
+		free(system->cores[i].watched);
+		free(system->cores[i].stale.slots);
+	}
+	free(system->cores);
+	destroyHierarchy(&system->shared);
+	memset(system, 0, sizeof(*system));
+}
+
+//@return: the word of a per-way bitmask of core holding way of set line
+static inline uint64_t *WayWord(const coreCache *core, uint64_t *bits, uint32_t line, uint32_t way){
+	return bits + (size_t)line * core->l1.validWords + way / 64;
+}
+
+//@pre: way of set line of the core's L1
+//@post: no change
+//@return: the coherence state of the block held there
+static lineState StateOf(const coreCache *core, uint32_t line, uint32_t way){
+	if (!IsWayValid(&core->l1, line, way)) {
+		return STATE_I;
+	}
+	bool shared = (*WayWord(core, core->shared, line, way) >> (way % 64)) & 1;
+	if (IsWayDirty(&core->l1, line, way)) {
+		return shared ? STATE_O : STATE_M;
+	}
+	return shared ? STATE_S : STATE_E;
+}
+
+//@pre: way of set line of the core's L1
+//@post: the valid, dirty and shared bits of the way encode state
+//@return: none
+static void SetState(coreCache *core, uint32_t line, uint32_t way, lineState state){
+	uint64_t bit = 1ull << (way % 64);
+	uint64_t *valid = &SetValid(&core->l1, line)[way / 64];
+	uint64_t *dirty = &SetDirty(&core->l1, line)[way / 64];
+	uint64_t *shared = WayWord(core, core->shared, line, way);
+	*valid = state != STATE_I ? *valid | bit : *valid & ~bit;
+	*dirty = state == STATE_M || state == STATE_O ? *dirty | bit : *dirty & ~bit;
+	*shared = state == STATE_S || state == STATE_O ? *shared | bit : *shared & ~bit;
+}
+
+//@pre: a store of written bytes to block by requester, or 0 for none
+//@post: written is added to every other core's stale copy of the block
+//@return: true if another core holds the block stale
+static bool NoteStaleCopies(coherentSystem *system, int requester, uint64_t block, uint64_t written){
+	bool stale = false;
+	for (int i = 0; i < system->coreCount; i++) {
+		if (i != requester && AddStaleWrite(&system->cores[i].stale, block, written)) {
+			stale = true;
+		}
+	}
+	return stale;
+}
+
+//@pre: a dirty block leaving the L1 of core
+//@post: the block is written to the shared levels, or memory without any
+//@return: none
+static void WriteBackBlock(coherentSystem *system, coreCache *core, uint64_t address){
+	uint64_t bytes = 1ull << core->l1.config.blockSize_Exp;
+	core->l1.writebacks++;
+	core->l1.writebackBytes += bytes;
+	if (system->shared.levelCount > 0) {
+		WritebackHierarchy(&system->shared, address, bytes);
+	}
+	else {
+		system->memoryWriteBytes += bytes;
+	}
+}
+
+//@pre: a bus read by requester for a block it does not hold
+//@post: M copies drop to S (MESI, after a write back) or O (MOESI); E copies
+//       drop to S; *sharers is set if any other core holds the block
+//@return: the core supplying the block, preferring the owner of a dirty
+//         copy, or -1 if no other core holds it
+static int SnoopRead(coherentSystem *system, int requester, uint64_t address, bool *sharers){
+	int owner = -1;
+	int first = -1;
+	*sharers = false;
+	for (int i = 0; i < system->coreCount; i++) {
+		coreCache *other = &system->cores[i];
+		uint32_t way = ProbeWay(&other->l1, address);
+		if (i == requester || way == other->l1.config.associativity) {
+			continue;
+		}
+		uint32_t line = ParseLineFromAddress(&other->l1, address);
+		switch (StateOf(other, line, way)) {
+			case STATE_M:
+				if (system->protocol == MOESI) {
+					SetState(other, line, way, STATE_O);
+				}
+				else {
+					WriteBackBlock(system, other, address);
+					SetState(other, line, way, STATE_S);
+				}
+				owner = i;
+				break;
+			case STATE_O: owner = i; break;
+			case STATE_E: SetState(other, line, way, STATE_S); break;
+			default: break;
+		}
+		if (first < 0) {
+			first = i;
+		}
+		*sharers = true;
+	}
+	return owner >= 0 ? owner : first;
+}
+
+//@pre: a store of written bytes by requester
+//@post: every other copy of the block is invalid and added to its core's
+//       stale set, and written to every stale copy; a dirty copy travels
+//       with the transfer instead of being written back. *stale is set if
+//       another core now holds the block stale.
+//@return: the core that held the block, preferring the owner of a dirty
+//         copy, or -1 if no other core held it
+static int InvalidateOthers(coherentSystem *system, int requester, uint64_t address,
+	uint64_t written, bool *stale){
+	int owner = -1;
+	int first = -1;
+	uint64_t block = address >> system->cores[requester].l1.config.blockSize_Exp;
+	*stale = false;
+	for (int i = 0; i < system->coreCount; i++) {
+		coreCache *other = &system->cores[i];
+		if (i == requester) {
+			continue;
+		}
+		uint32_t way = ProbeWay(&other->l1, address);
+		if (way == other->l1.config.associativity) {
+			*stale = AddStaleWrite(&other->stale, block, written) || *stale;
+			continue;
+		}
+		uint32_t line = ParseLineFromAddress(&other->l1, address);
+		lineState state = StateOf(other, line, way);
+		if (state == STATE_M || state == STATE_O) {
+			owner = i;
+		}
+		if (first < 0) {
+			first = i;
+		}
+		SetState(other, line, way, STATE_I);
+		AddStaleBlock(&other->stale, block, written);
+		other->invalidations++;
+		*stale = true;
+	}
+	return owner >= 0 ? owner : first;
+}
+
+//@pre: a built system and a core below its core count
+//@post: the access is run through the core's L1 and the bus, and every
+//       counter it touches is updated
+//@return: none
+void AccessCoherent(coherentSystem *system, int core, uint64_t address, uint32_t size, bool store){
+	coreCache *cache = &system->cores[core];
+	cacheLevel *l1 = &cache->l1;
+	uint32_t ways = l1->config.associativity;
+	uint32_t line = ParseLineFromAddress(l1, address);
+	uint64_t block = address >> l1->config.blockSize_Exp;
+	uint64_t touched = TouchedBytes(l1, address, size);
+	bool stale = false;
+	if (store) {
+		cache->stores++;
+	}
+	else {
+		cache->loads++;
+	}
+
+	uint32_t way = LookupWay(l1, address);
+	if (way != ways) {
+		l1->hits++;
+		if (store) {
+			lineState state = StateOf(cache, line, way);
+			uint64_t *watched = WayWord(cache, cache->watched, line, way);
+			uint64_t bit = 1ull << (way % 64);
+			if (state == STATE_S || state == STATE_O) {
+				cache->upgrades++;
+				InvalidateOthers(system, core, address, touched, &stale);
+			}
+			else if (*watched & bit) {
+				stale = NoteStaleCopies(system, core, block, touched);
+			}
+			*watched = stale ? *watched | bit : *watched & ~bit;
+			SetState(cache, line, way, STATE_M);
+		}
+		return;
+	}
+
+	l1->misses++;
+	uint64_t written = 0;
+	if (TakeStale(&cache->stale, block, &written)) {
+		if (written & touched) {
+			cache->trueSharingMisses++;
+		}
+		else {
+			cache->falseSharingMisses++;
+		}
+	}
+	bool sharers = false;
+	int supplier = store ? InvalidateOthers(system, core, address, touched, &stale)
+		: SnoopRead(system, core, address, &sharers);
+	if (supplier >= 0) {
+		system->cores[supplier].transfersOut++;
+		cache->transfersIn++;
+	}
+	else if (system->shared.levelCount > 0) {
+		AccessHierarchy(&system->shared, address);
+	}
+	else {
+		system->memoryReads++;
+	}
+
+	uint64_t victim = 0;
+	bool victimDirty = false;
+	if (FillCache(l1, address, store, &victim, &victimDirty) && victimDirty) {
+		WriteBackBlock(system, cache, victim);
+	}
+	way = ProbeWay(l1, address);
+	// Only an E copy can later be stored to without going on the bus
+	if (!store && !sharers) {
+		stale = NoteStaleCopies(system, core, block, 0);
+	}
+	uint64_t *watched = WayWord(cache, cache->watched, line, way);
+	*watched = stale ? *watched | 1ull << (way % 64) : *watched & ~(1ull << (way % 64));
+	SetState(cache, line, way, store ? STATE_M : sharers ? STATE_S : STATE_E);
+}
+
+//@pre: a built system and a batch from NextTraceBatch
+//@post: every access of the batch is simulated in order. Raw addresses are
+//       loads by core 0; a record's core is taken modulo the core count.
+//@return: none
+void SimulateCoherent(coherentSystem *system, const traceBatch *batch){
+	if (batch->records == NULL) {
+		for (size_t i = 0; i < batch->count; i++) {
+			AccessCoherent(system, 0, batch->addresses[i], 1, false);
+		}
+		return;
+	}
+	for (size_t i = 0; i < batch->count; i++) {
+		const traceRecord *record = &batch->records[i];
+		AccessCoherent(system, record->core % system->coreCount, record->address,
+			record->size, record->type == ACCESS_STORE);
+	}
+}
@@ -0,0 +1,112 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Private per-core L1 caches kept coherent by a snooping protocol
+//
+//	Description:
+//			Every core gets its own copy of the configured L1; the lower
+//			levels form one hierarchy shared by all cores. The core of each
+//			access is the core field of a trace record (raw traces are all
+//			core 0). A miss or a store to a shared block is broadcast on an
+//			atomic bus and snooped by every other L1.
+//
+//			A line is in one of the MESI states, held in the L1's own valid
+//			and dirty bits plus a shared bit per way:
+//
+//			M  valid, dirty          E  valid, clean
+//			S  valid, clean, shared  I  not valid
+//
+//			MOESI adds O (valid, dirty, shared): a core holding M that sees
+//			another core's load keeps the dirty block and supplies it from
+//			then on, where MESI writes it back and drops to S.
+//
+//			A miss is supplied by another L1 (a cache-to-cache transfer)
+//			whenever one holds the block, otherwise by the shared levels. A
+//			store invalidates every other copy. Each core keeps the blocks
+//			invalidated that way in a stale set, an open-addressing table
+//			keyed by block, until it misses on the block again; that miss is
+//			a coherence miss, however long ago the way was reused.
+//
+//			A stale block also collects the bytes other cores store to it,
+//			as a bit per 64th of the block. The coherence miss is true
+//			sharing if the access that misses touches any of them, and false
+//			sharing if the cores only touched different bytes of one block.
+//			A store that hits in M or E does not go on the bus, so the way
+//			keeps a watched bit while other cores hold the block stale, and
+//			such stores are added to their stale sets directly.
+//
+//			The shared levels are non-inclusive of the private L1s: their
+//			evictions do not reach the L1s.
+//
+
+#ifndef COHERENCE_H_
+#define COHERENCE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hierarchy.h"
+
+#define  MaxCores_Nbr  64
+#define  StaleSet_InitialBits  10
+
+typedef enum {MESI = 0, MOESI} coherenceProtocol;
+
+//One slot of a stale set: block number + 1 (0 for an empty slot) and a bit
+//per 64th of the block other cores have stored to since it was invalidated
+typedef struct staleBlock
+{
+	uint64_t block;
+	uint64_t written;
+} staleBlock;
+
+typedef struct staleSet
+{
+	staleBlock *slots;
+	uint32_t bits;
+	size_t count;
+} staleSet;
+
+typedef struct coreCache
+{
+	cacheLevel l1;
+	//per way, with the layout of the L1's valid bits
+	uint64_t *shared;
+	uint64_t *watched;
+	staleSet stale;
+
+	uint64_t loads;
+	uint64_t stores;
+	//misses on a block another core's store had invalidated, split by
+	//whether the miss touches bytes the other cores stored to
+	uint64_t trueSharingMisses;
+	uint64_t falseSharingMisses;
+	//stores to S or O blocks, which need the other copies invalidated
+	uint64_t upgrades;
+	//blocks of this core invalidated by the stores of other cores
+	uint64_t invalidations;
+	//blocks received from and supplied to other cores
+	uint64_t transfersIn;
+	uint64_t transfersOut;
+} coreCache;
+
+typedef struct coherentSystem
+{
+	coherenceProtocol protocol;
+	int coreCount;
+	coreCache *cores;
+	//levels below the L1s; with none, misses and writebacks go to memory
+	cacheHierarchy shared;
+	uint64_t memoryReads;
+	uint64_t memoryWriteBytes;
+} coherentSystem;
+
+bool ParseCoherenceSpec(const char *spec, int *cores, coherenceProtocol *protocol);
+const char *CoherenceProtocolName(coherenceProtocol protocol);
+
+bool buildCoherentSystem(coherentSystem *system, const hierarchyConfig *config,
+	int cores, coherenceProtocol protocol);
+void destroyCoherentSystem(coherentSystem *system);
+
+void AccessCoherent(coherentSystem *system, int core, uint64_t address, uint32_t size, bool store);
+void SimulateCoherent(coherentSystem *system, const traceBatch *batch);
+
+#endif /* COHERENCE_H_ */
@@ -0,0 +1,380 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Synthetic address stream generators
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "cache.h"
+#include "generator.h"
+
+static const char *GeneratorNames[] = {
+	"sequential", "strided", "uniform", "zipf", "chase", "tile"
+};
+
+#define  Generators_Nbr  ( sizeof(GeneratorNames) / sizeof(GeneratorNames[0]) )
+
+//
+//	Odd prime used to scatter Zipf ranks over the footprint
+//
+#define  ScatterPrime  2654435761ull
+
+//=============================================================================
+// RANDOM NUMBERS
+//
+
+//@brief: splitmix64, a full period 64-bit generator with a well mixed output
+static inline uint64_t NextRandom64(uint64_t *state){
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+//@return: a number in [0, limit)
+static inline uint64_t RandomBelow(uint64_t *state, uint64_t limit){
+	return (uint64_t)(((unsigned __int128)NextRandom64(state) * limit) >> 64);
+}
+
+//@return: a number in [0, 1)
+static inline double RandomUnit(uint64_t *state){
+	return (double)(NextRandom64(state) >> 11) * 0x1.0p-53;
+}
+
+//=============================================================================
+// ZIPF
+//
+//	Rejection-inversion sampling (Hormann and Derflinger): O(1) per sample
+//	for any number of elements, with no table.
+//
+
+//@return: log1p(x) / x, accurate near 0
+static double Helper1(double x){
+	return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+//@return: expm1(x) / x, accurate near 0
+static double Helper2(double x){
+	return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+}
+
+static double ZipfH(double alpha, double x){
+	return exp(-alpha * log(x));
+}
+
+static double ZipfHIntegral(double alpha, double x){
+	double logX = log(x);
+	return Helper2((1.0 - alpha) * logX) * logX;
+}
+
+static double ZipfHIntegralInverse(double alpha, double x){
+	double t = x * (1.0 - alpha);
+	if (t < -1.0) {
+		t = -1.0;
+	}
+	return exp(Helper1(t) * x);
+}
+
+//@pre: alpha > 0 and items >= 1
+//@post: the sampling constants are set
+static void SetupZipf(traceGenerator *generator){
+	double alpha = generator->alpha;
+	generator->hIntegralX1 = ZipfHIntegral(alpha, 1.5) - 1.0;
+	generator->hIntegralN = ZipfHIntegral(alpha, (double)generator->items + 0.5);
+	generator->acceptS = 2.0 - ZipfHIntegralInverse(alpha, ZipfHIntegral(alpha, 2.5) - ZipfH(alpha, 2.0));
+}
+
+//@return: a rank in [1, items], rank k drawn with weight 1 / k^alpha
+static uint64_t NextZipf(traceGenerator *generator){
+	double alpha = generator->alpha;
+	for (;;) {
+		double u = generator->hIntegralN
+			+ RandomUnit(&generator->random) * (generator->hIntegralX1 - generator->hIntegralN);
+		double x = ZipfHIntegralInverse(alpha, u);
+		double rank = floor(x + 0.5);
+		if (rank < 1.0) {
+			rank = 1.0;
+		}
+		else if (rank > (double)generator->items) {
+			rank = (double)generator->items;
+		}
+		if (rank - x <= generator->acceptS
+			|| u >= ZipfHIntegral(alpha, rank + 0.5) - ZipfH(alpha, rank)) {
+			return (uint64_t)rank;
+		}
+	}
+}
+
+//=============================================================================
+// CONFIGURATION
+//
+
+//@pre: none
+//@post: generator holds the defaults and the kind and options of spec
+//@return: false (with a message) if the spec is malformed
+bool ParseGeneratorSpec(traceGenerator *generator, const char *spec){
+	memset(generator, 0, sizeof(*generator));
+	generator->count = 1000000;
+	generator->footprint = 64ull << 20;
+	generator->stride = 64;
+	generator->size = 4;
+	generator->alpha = 0.99;
+	generator->seed = 1;
+	generator->n = 256;
+	generator->tile = 32;
+	generator->cores = 1;
+
+	char *copy = strdup(spec);
+	char *saveptr = NULL;
+	char *item = strtok_r(copy, ", \t", &saveptr);
+	bool ok = false;
+	for (size_t i = 0; item != NULL && i < Generators_Nbr; i++) {
+		if (strcasecmp(item, GeneratorNames[i]) == 0) {
+			generator->kind = (generatorKind)i;
+			ok = true;
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "Unknown generator: %s\n", item != NULL ? item : "");
+	}
+
+	while (ok && (item = strtok_r(NULL, ", \t", &saveptr)) != NULL) {
+		char *value = strchr(item, '=');
+		if (value == NULL) {
+			fprintf(stderr, "Expected key=value in generator spec: %s\n", item);
+			ok = false;
+			break;
+		}
+		*value++ = '\0';
+
+		uint64_t number = 0;
+		bool isNumber = ParseSize(value, &number);
+		if (strcasecmp(item, "alpha") == 0) {
+			generator->alpha = strtod(value, NULL);
+			ok = generator->alpha > 0.0;
+		}
+		else if (strcasecmp(item, "stores") == 0) {
+			generator->stores = strtod(value, NULL);
+			generator->records = true;
+			ok = generator->stores >= 0.0 && generator->stores <= 1.0;
+		}
+		else if (strcasecmp(item, "records") == 0) {
+			generator->records = strcasecmp(value, "yes") == 0 || strcmp(value, "1") == 0;
+		}
+		else if (!isNumber) {
+			ok = false;
+		}
+		else if (strcasecmp(item, "count") == 0)     generator->count = number;
+		else if (strcasecmp(item, "base") == 0)      generator->base = number;
+		else if (strcasecmp(item, "footprint") == 0) generator->footprint = number;
+		else if (strcasecmp(item, "stride") == 0)    generator->stride = number;
+		else if (strcasecmp(item, "size") == 0)      generator->size = (uint32_t)number;
+		else if (strcasecmp(item, "seed") == 0)      generator->seed = number;
+		else if (strcasecmp(item, "n") == 0)         generator->n = (uint32_t)number;
+		else if (strcasecmp(item, "tile") == 0)      generator->tile = (uint32_t)number;
+		else if (strcasecmp(item, "cores") == 0) {
+			generator->cores = (uint32_t)number;
+			generator->records = true;
+			ok = number >= 1 && number <= UINT16_MAX;
+		}
+		else {
+			fprintf(stderr, "Unknown generator option: %s\n", item);
+			ok = false;
+			break;
+		}
+		if (!ok) {
+			fprintf(stderr, "Bad value for %s: %s\n", item, value);
+		}
+	}
+	free(copy);
+	return ok;
+}
+
+//@pre: generator was set up by ParseGeneratorSpec
+//@post: the stream is ready to produce its first access
+//@return: false (with a message) if the options cannot make a stream
+bool buildGenerator(traceGenerator *generator){
+	if (generator->size == 0 || generator->size > 255 || generator->stride == 0
+		|| generator->n == 0 || generator->tile == 0) {
+		fprintf(stderr, "Generator size must be 1-255 and stride, n and tile at least 1\n");
+		return false;
+	}
+	uint64_t unit = generator->kind == GEN_STRIDED || generator->kind == GEN_CHASE
+		? generator->stride : generator->size;
+	if (generator->kind == GEN_TILE) {
+		generator->footprint = 3ull * generator->n * generator->n * generator->size;
+		unit = generator->size;
+	}
+	generator->items = generator->footprint / unit;
+	if (generator->items == 0) {
+		fprintf(stderr, "Generator footprint holds no elements\n");
+		return false;
+	}
+	if (!generator->records && generator->base + generator->footprint > (1ull << 32)) {
+		fprintf(stderr, "Raw 32-bit traces must stay below 4G; use records=yes\n");
+		return false;
+	}
+	generator->random = generator->seed;
+
+	if (generator->kind == GEN_ZIPF) {
+		SetupZipf(generator);
+	}
+	if (generator->kind == GEN_CHASE) {
+		if (generator->items > UINT32_MAX) {
+			fprintf(stderr, "Pointer chase supports at most 2^32 nodes\n");
+			return false;
+		}
+		generator->next = malloc(generator->items * sizeof(uint32_t));
+		if (generator->next == NULL) {
+			fprintf(stderr, "Unable to allocate the pointer chase\n");
+			return false;
+		}
+		// Sattolo's shuffle: a random permutation that is a single cycle
+		for (uint64_t i = 0; i < generator->items; i++) {
+			generator->next[i] = (uint32_t)i;
+		}
+		for (uint64_t i = generator->items - 1; i > 0; i--) {
+			uint64_t j = RandomBelow(&generator->random, i);
+			uint32_t swap = generator->next[i];
+			generator->next[i] = generator->next[j];
+			generator->next[j] = swap;
+		}
+	}
+
+	generator->addresses = malloc(TraceBatch_Nbr * sizeof(uint32_t));
+	generator->recordBuffer = malloc(TraceBatch_Nbr * sizeof(traceRecord));
+	if (generator->addresses == NULL || generator->recordBuffer == NULL) {
+		destroyGenerator(generator);
+		fprintf(stderr, "Unable to allocate the generator buffers\n");
+		return false;
+	}
+	return true;
+}
+
+//@pre: generator was built by buildGenerator
+//@post: all memory held by the generator is released
+//@return: none
+void destroyGenerator(traceGenerator *generator){
+	free(generator->next);
+	free(generator->addresses);
+	free(generator->recordBuffer);
+	generator->next = NULL;
+	generator->addresses = NULL;
+	generator->recordBuffer = NULL;
+}
+
+//=============================================================================
+// STREAMS
+//
+
+//@pre: a tile generator
+//@post: the loops have moved on to the next multiply-add
+//@return: none
+//@brief: Loop nest ii, jj, kk over tiles, then i, j, k within them
+static void AdvanceTile(traceGenerator *generator){
+	uint32_t *loop = generator->loops;
+	uint32_t n = generator->n;
+	uint32_t tile = generator->tile;
+	for (int depth = 5; depth >= 0; depth--) {
+		if (depth >= 3) {
+			// Inner loops run to the end of their tile, or of the matrix
+			uint32_t start = loop[depth - 3];
+			uint32_t end = start + tile < n ? start + tile : n;
+			if (++loop[depth] < end) {
+				return;
+			}
+			loop[depth] = start;
+		}
+		else {
+			loop[depth] += tile;
+			if (loop[depth] < n) {
+				// A new tile: the inner loops start at its corner
+				for (int inner = depth + 3; inner < 6; inner++) {
+					loop[inner] = loop[inner - 3];
+				}
+				return;
+			}
+			loop[depth] = 0;
+		}
+	}
+	memset(loop, 0, sizeof(generator->loops));
+}
+
+//@pre: a built generator
+//@post: the stream has advanced by one access
+//@return: the address, with *store set for the C stores of a tile stream
+static inline uint64_t NextAddress(traceGenerator *generator, bool *store){
+	uint64_t element;
+	switch (generator->kind) {
+		case GEN_SEQUENTIAL:
+		case GEN_STRIDED:
+			element = generator->position;
+			if (++generator->position == generator->items) {
+				generator->position = 0;
+			}
+			return generator->base + element * (generator->kind == GEN_STRIDED ? generator->stride : generator->size);
+		case GEN_UNIFORM:
+			return generator->base + RandomBelow(&generator->random, generator->items) * generator->size;
+		case GEN_ZIPF:
+			element = (NextZipf(generator) - 1) * ScatterPrime % generator->items;
+			return generator->base + element * generator->size;
+		case GEN_CHASE:
+			element = generator->position;
+			generator->position = generator->next[element];
+			return generator->base + element * generator->stride;
+		case GEN_TILE: {
+			// A[i][k], B[k][j], then a store to C[i][j]
+			const uint32_t *loop = generator->loops;
+			uint64_t n = generator->n;
+			uint32_t operand = generator->operand;
+			uint64_t row = operand == 1 ? loop[5] : loop[3];
+			uint64_t column = operand == 0 ? loop[5] : loop[4];
+			*store = operand == 2;
+			if (++generator->operand == 3) {
+				generator->operand = 0;
+				AdvanceTile(generator);
+			}
+			return generator->base + ((operand * n + row) * n + column) * generator->size;
+		}
+	}
+	return generator->base;
+}
+
+//@pre: a built generator
+//@post: the stream is advanced past the returned accesses
+//@return: the number of accesses in *batch, 0 once count have been produced
+size_t NextGeneratedBatch(traceGenerator *generator, traceBatch *batch){
+	uint64_t remaining = generator->count - generator->produced;
+	size_t count = remaining < TraceBatch_Nbr ? (size_t)remaining : TraceBatch_Nbr;
+	batch->addresses = NULL;
+	batch->records = NULL;
+	batch->count = count;
+	generator->produced += count;
+
+	if (!generator->records) {
+		for (size_t i = 0; i < count; i++) {
+			bool store = false;
+			generator->addresses[i] = (uint32_t)NextAddress(generator, &store);
+		}
+		batch->addresses = generator->addresses;
+		return count;
+	}
+	uint64_t first = generator->produced - count;
+	for (size_t i = 0; i < count; i++) {
+		bool store = false;
+		traceRecord *record = &generator->recordBuffer[i];
+		record->address = NextAddress(generator, &store);
+		if (!store && generator->stores > 0.0) {
+			store = RandomUnit(&generator->random) < generator->stores;
+		}
+		record->gap = 0;
+		record->core = (uint16_t)((first + i) % generator->cores);
+		record->type = store ? ACCESS_STORE : ACCESS_LOAD;
+		record->size = (uint8_t)generator->size;
+	}
+	batch->records = generator->recordBuffer;
+	return count;
+}
@@ -0,0 +1,82 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Synthetic address streams generated on the fly from a seed
+//
+//	Description:
+//			A generator is described by a spec such as
+//
+//			    zipf,count=100M,footprint=64M,alpha=0.9,seed=7
+//
+//			where the first item is the kind of stream:
+//
+//			sequential -- consecutive elements of size bytes
+//			strided    -- every stride bytes
+//			uniform    -- elements chosen uniformly at random
+//			zipf       -- elements chosen with Zipf(alpha) popularity,
+//			              the popular ones scattered over the footprint
+//			chase      -- a pointer chase through one random cycle of
+//			              stride byte nodes
+//			tile       -- the loads of A and B and the stores of C of a tiled
+//			              n x n matrix multiply, tile x tile blocks at a time
+//
+//			Every stream wraps around within footprint bytes from base and
+//			stops after count accesses. With records=yes, a stores fraction
+//			or a number of cores, the stream is made of traceRecords;
+//			otherwise of raw 32-bit addresses. With cores=n consecutive
+//			accesses are issued by cores 0, 1, ..., n-1 in turn. All
+//			randomness comes from a splitmix64 stream seeded by seed, so a
+//			spec always produces the same trace.
+//
+
+#ifndef GENERATOR_H_
+#define GENERATOR_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+typedef enum {GEN_SEQUENTIAL = 0, GEN_STRIDED, GEN_UNIFORM, GEN_ZIPF, GEN_CHASE, GEN_TILE} generatorKind;
+
+typedef struct traceGenerator
+{
+	//inputs
+	generatorKind kind;
+	uint64_t count;
+	uint64_t base;
+	uint64_t footprint;
+	uint64_t stride;
+	uint32_t size;
+	double alpha;
+	double stores;
+	bool records;
+	uint64_t seed;
+	uint32_t n;
+	uint32_t tile;
+	uint32_t cores;
+
+	//stream state
+	uint64_t random;
+	uint64_t produced;
+	uint64_t position;
+	uint64_t items;
+	//zipf rejection-inversion constants
+	double hIntegralX1;
+	double hIntegralN;
+	double acceptS;
+	//pointer chase cycle
+	uint32_t *next;
+	//tile loop counters ii, jj, kk, i, j, k and the array within an iteration
+	uint32_t loops[6];
+	uint32_t operand;
+
+	uint32_t *addresses;
+	traceRecord *recordBuffer;
+} traceGenerator;
+
+bool ParseGeneratorSpec(traceGenerator *generator, const char *spec);
+bool buildGenerator(traceGenerator *generator);
+void destroyGenerator(traceGenerator *generator);
+size_t NextGeneratedBatch(traceGenerator *generator, traceBatch *batch);
+
+#endif /* GENERATOR_H_ */
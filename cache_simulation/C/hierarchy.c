@@ -0,0 +1,698 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Multi-level cache hierarchy for the cache simulation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "hierarchy.h"
+
+//
+//	Geometry given to a level when it is added, as (cache size exp, ways)
+//
+static const uint32_t LevelDefaults[MaxLevels_Nbr][2] = {
+	{ Default_CacheSize_Exp, Default_Associativity },
+	{ 18, 8 },
+	{ 21, 16 },
+	{ 23, 16 },
+};
+
+static const char *InclusionNames[] = { "inclusive", "exclusive", "nine" };
+
+//=============================================================================
+// CONFIGURATION
+//
+
+//@pre: none
+//@post: config describes a single L1 with the default geometry
+//@return: none
+void DefaultHierarchyConfig(hierarchyConfig *config){
+	memset(config, 0, sizeof(*config));
+	config->levelCount = 0;
+	AddHierarchyLevel(config);
+}
+
+//@pre: config was set up by DefaultHierarchyConfig
+//@post: a level with default geometry is appended below the existing ones
+//@return: index of the new level, or -1 if the hierarchy is full
+int AddHierarchyLevel(hierarchyConfig *config){
+	if (config->levelCount == MaxLevels_Nbr) {
+		fprintf(stderr, "At most %d cache levels are supported\n", MaxLevels_Nbr);
+		return -1;
+	}
+	int index = config->levelCount++;
+	levelConfig *level = &config->levels[index];
+	DefaultCacheConfig(&level->cache);
+	level->cache.cacheSize_Exp = LevelDefaults[index][0];
+	level->cache.associativity = LevelDefaults[index][1];
+	level->inclusion = INCLUSIVE;
+	DefaultPrefetchConfig(&level->prefetch);
+	DefaultVictimConfig(&level->victim);
+	return index;
+}
+
+//@pre: inclusion is a valid policy
+//@return: the name used for it in config files
+const char *InclusionName(inclusionPolicy inclusion){
+	return InclusionNames[inclusion];
+}
+
+//@pre: key is "inclusion", a prefetch or victim buffer option or any key
+//      understood by SetCacheOption
+//@post: the option is applied to level
+//@return: false (with a message) if the key or value is not understood
+bool SetLevelOption(levelConfig *level, const char *key, const char *value){
+	if (strcasecmp(key, "inclusion") == 0) {
+		for (int i = 0; i < (int)(sizeof(InclusionNames) / sizeof(InclusionNames[0])); i++) {
+			if (strcasecmp(value, InclusionNames[i]) == 0) {
+				level->inclusion = (inclusionPolicy)i;
+				return true;
+			}
+		}
+		fprintf(stderr, "Unknown inclusion policy: %s\n", value);
+		return false;
+	}
+	if (strcasecmp(key, "prefetch") == 0) {
+		if (!ParsePrefetchKind(value, &level->prefetch.kind)) {
+			fprintf(stderr, "Unknown prefetcher: %s\n", value);
+			return false;
+		}
+		return true;
+	}
+	if (strcasecmp(key, "prefetch_degree") == 0 || strcasecmp(key, "prefetch_latency") == 0) {
+		bool degree = strcasecmp(key, "prefetch_degree") == 0;
+		if (degree ? !ParseCount(value, 1, PrefetchCandidates_Max, &level->prefetch.degree)
+			: !ParseCount(value, 0, UINT32_MAX, &level->prefetch.latency)) {
+			fprintf(stderr, "Bad value for %s: %s\n", key, value);
+			return false;
+		}
+		return true;
+	}
+	if (strcasecmp(key, "buffer") == 0) {
+		if (!ParseVictimKind(value, &level->victim.kind)) {
+			fprintf(stderr, "Unknown victim buffer: %s\n", value);
+			return false;
+		}
+		return true;
+	}
+	if (strcasecmp(key, "buffer_entries") == 0) {
+		if (!ParseCount(value, 1, VictimEntries_Max, &level->victim.entries)) {
+			fprintf(stderr, "Bad value for %s: %s\n", key, value);
+			return false;
+		}
+		return true;
+	}
+	return SetCacheOption(&level->cache, key, value);
+}
+
+//@pre: spec is a comma separated list such as "size=256K,ways=8,inclusion=nine"
+//@post: every option in spec is applied to level
+//@return: false if any option is malformed
+bool ParseLevelSpec(levelConfig *level, const char *spec){
+	char *copy = strdup(spec);
+	char *saveptr = NULL;
+	bool ok = true;
+	for (char *item = strtok_r(copy, ", \t", &saveptr); ok && item != NULL;
+		item = strtok_r(NULL, ", \t", &saveptr)) {
+		char *equals = strchr(item, '=');
+		if (equals == NULL) {
+			fprintf(stderr, "Expected key=value in level spec: %s\n", item);
+			ok = false;
+			break;
+		}
+		*equals = '\0';
+		ok = SetLevelOption(level, item, equals + 1);
+	}
+	free(copy);
+	return ok;
+}
+
+//@pre: spec lists the levels from the L1 down, separated by ';', each in the
+//      form taken by ParseLevelSpec
+//@post: config describes exactly the levels in spec
+//@return: false if any level is malformed or there are too many
+bool ParseHierarchySpec(hierarchyConfig *config, const char *spec){
+	DefaultHierarchyConfig(config);
+	char *copy = strdup(spec);
+	char *saveptr = NULL;
+	bool ok = true;
+	bool first = true;
+	for (char *item = strtok_r(copy, ";", &saveptr); ok && item != NULL;
+		item = strtok_r(NULL, ";", &saveptr)) {
+		int level = first ? 0 : AddHierarchyLevel(config);
+		first = false;
+		if (level < 0) {
+			ok = false;
+			break;
+		}
+		ok = ParseLevelSpec(&config->levels[level], item);
+	}
+	free(copy);
+	return ok;
+}
+
+//@pre: path names a file of "key = value" lines; '#' starts a comment
+//@post: options before any section header apply to the L1; a "[Ln]" header
+//       selects level n, adding it if it is the next level down
+//@return: false if the file cannot be read or holds a bad option
+bool LoadHierarchyConfigFile(hierarchyConfig *config, const char *path){
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		perror(path);
+		return false;
+	}
+
+	char text[256];
+	int lineNumber = 0;
+	int current = 0;
+	bool ok = true;
+	while (ok && fgets(text, sizeof(text), file) != NULL) {
+		lineNumber++;
+		char *comment = strchr(text, '#');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+
+		char key[64], value[64];
+		char extra;
+		int levelNumber;
+		if (sscanf(text, " [L%d] %c", &levelNumber, &extra) == 1) {
+			if (levelNumber == config->levelCount + 1) {
+				ok = AddHierarchyLevel(config) >= 0;
+			}
+			else if (levelNumber < 1 || levelNumber > config->levelCount) {
+				fprintf(stderr, "%s:%d: levels must be added in order\n", path, lineNumber);
+				ok = false;
+			}
+			current = levelNumber - 1;
+		}
+		else if (sscanf(text, " %63[^= \t] = %63s %c", key, value, &extra) == 2) {
+			ok = SetLevelOption(&config->levels[current], key, value);
+		}
+		else if (sscanf(text, " %c", &extra) == 1) {
+			fprintf(stderr, "%s:%d: expected key = value or [Ln]\n", path, lineNumber);
+			ok = false;
+		}
+	}
+	fclose(file);
+	return ok;
+}
+
+//@pre: every level's input fields are set
+//@post: every level is configured; the address size of the L1 is used by all
+//@return: false (with a message) if any level is invalid or the levels
+//         cannot be stacked
+bool ConfigureHierarchy(hierarchyConfig *config){
+	for (int i = 0; i < config->levelCount; i++) {
+		levelConfig *level = &config->levels[i];
+		level->cache.addressSize_Exp = config->levels[0].cache.addressSize_Exp;
+		if (!ConfigureCache(&level->cache)) {
+			fprintf(stderr, "(in L%d)\n", i + 1);
+			return false;
+		}
+		if (!ConfigureVictimBuffer(&level->victim, &level->cache)) {
+			fprintf(stderr, "(in the buffer of L%d)\n", i + 1);
+			return false;
+		}
+		if (i == 0) {
+			continue;
+		}
+
+		uint32_t upperBlock = config->levels[i - 1].cache.blockSize_Exp;
+		if (level->cache.blockSize_Exp < upperBlock) {
+			fprintf(stderr, "L%d blocks must be at least as large as L%d blocks\n", i + 1, i);
+			return false;
+		}
+		if (level->inclusion == EXCLUSIVE && level->cache.blockSize_Exp != upperBlock) {
+			fprintf(stderr, "Exclusive L%d must use the block size of L%d\n", i + 1, i);
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: a hierarchy configuration
+//@return: true if any level has a prefetcher
+bool HierarchyPrefetches(const hierarchyConfig *config){
+	for (int i = 0; i < config->levelCount; i++) {
+		if (config->levels[i].prefetch.kind != PREFETCH_NONE) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//@pre: a hierarchy configuration
+//@return: true if any level has a victim or miss cache
+bool HierarchyBuffers(const hierarchyConfig *config){
+	for (int i = 0; i < config->levelCount; i++) {
+		if (config->levels[i].victim.kind != VICTIM_NONE) {
+			return true;
+		}
+	}
+	return false;
+}
+
+//=============================================================================
+// HIERARCHY STATE
+//
+
+//@pre: config has been through ConfigureHierarchy
+//@post: every level is built and empty
+//@return: false if any level could not be allocated
+bool buildHierarchy(cacheHierarchy *hierarchy, const hierarchyConfig *config){
+	memset(hierarchy, 0, sizeof(*hierarchy));
+	for (int i = 0; i < config->levelCount; i++) {
+		if (!buildCache(&hierarchy->levels[i], &config->levels[i].cache)) {
+			destroyHierarchy(hierarchy);
+			return false;
+		}
+		hierarchy->inclusion[i] = config->levels[i].inclusion;
+		hierarchy->levelCount = i + 1;
+		if (!buildPrefetcher(&hierarchy->prefetchers[i], &config->levels[i].prefetch, &hierarchy->levels[i])
+			|| !buildVictimBuffer(&hierarchy->victims[i], &config->levels[i].victim)) {
+			destroyHierarchy(hierarchy);
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: hierarchy was built by buildHierarchy
+//@post: all memory held by the levels is released
+//@return: none
+void destroyHierarchy(cacheHierarchy *hierarchy){
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		destroyCache(&hierarchy->levels[i]);
+		destroyPrefetcher(&hierarchy->prefetchers[i]);
+		destroyVictimBuffer(&hierarchy->victims[i]);
+		if (hierarchy->classifiers[i] != NULL) {
+			destroyMissClassifier(hierarchy->classifiers[i]);
+			free(hierarchy->classifiers[i]);
+			hierarchy->classifiers[i] = NULL;
+		}
+	}
+	hierarchy->levelCount = 0;
+}
+
+//@pre: a built hierarchy
+//@post: every level classifies its misses from now on
+//@return: false if memory is short
+bool ClassifyHierarchyMisses(cacheHierarchy *hierarchy){
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		missClassifier *classifier = malloc(sizeof(missClassifier));
+		if (classifier == NULL || !buildMissClassifier(classifier, &hierarchy->levels[i].config)) {
+			free(classifier);
+			return false;
+		}
+		hierarchy->classifiers[i] = classifier;
+	}
+	return true;
+}
+
+//@pre: a built hierarchy
+//@post: every level counts its demand accesses and misses per set from now on
+//@return: false if memory is short
+bool CountHierarchySets(cacheHierarchy *hierarchy){
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		if (!CountSetAccesses(&hierarchy->levels[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: a built hierarchy
+//@post: the counters of every level, prefetcher and buffer are zero; the
+//       contents of the levels are kept
+//@return: none
+void ResetHierarchyCounters(cacheHierarchy *hierarchy){
+	for (int i = 0; i < hierarchy->levelCount; i++) {
+		cacheLevel *cache = &hierarchy->levels[i];
+		cache->hits = cache->misses = cache->fills = cache->evictions = 0;
+		cache->writebacks = cache->writebackBytes = cache->writeThroughBytes = 0;
+		if (cache->setStats != NULL) {
+			memset(cache->setStats, 0, cache->config.lines_Nbr * sizeof(setStat));
+		}
+		hierarchy->backInvalidations[i] = 0;
+		if (hierarchy->classifiers[i] != NULL) {
+			missClassifier *classifier = hierarchy->classifiers[i];
+			classifier->compulsory = classifier->capacity = classifier->conflict = 0;
+		}
+
+		prefetcher *prefetch = &hierarchy->prefetchers[i];
+		prefetch->issued = prefetch->useful = prefetch->late = prefetch->unused = prefetch->polluting = 0;
+		victimBuffer *buffer = &hierarchy->victims[i];
+		buffer->probes = buffer->hits = 0;
+		buffer->blocks.fills = buffer->blocks.evictions = 0;
+	}
+}
+
+//=============================================================================
+// ACCESS
+//
+
+static void InsertBlock(cacheHierarchy *hierarchy, int level, uint64_t address, bool dirty);
+
+//@pre: victim is a block address evicted from level
+//@post: every piece of the victim is gone from the levels above level and
+//       their buffers
+//@return: true if any of the removed pieces was dirty
+static bool BackInvalidate(cacheHierarchy *hierarchy, int level, uint64_t victim){
+	uint64_t end = victim + (1ull << hierarchy->levels[level].config.blockSize_Exp);
+	bool dirty = false;
+	for (int i = 0; i < level; i++) {
+		cacheLevel *upper = &hierarchy->levels[i];
+		uint64_t step = 1ull << upper->config.blockSize_Exp;
+		for (uint64_t address = victim; address < end; address += step) {
+			bool wasDirty = false;
+			bool bufferDirty = false;
+			bool held = InvalidateCache(upper, address, &wasDirty);
+			// A miss cache may hold a copy of a block the level also holds
+			if (InvalidateVictim(&hierarchy->victims[i], address, &bufferDirty) || held) {
+				hierarchy->backInvalidations[i]++;
+				dirty |= wasDirty || bufferDirty;
+			}
+		}
+	}
+	return dirty;
+}
+
+//@pre: level has just evicted or given up a dirty block
+//@post: the write back is counted
+//@return: the bytes written back
+static uint64_t CountWriteback(cacheLevel *cache){
+	uint64_t bytes = 1ull << cache->config.blockSize_Exp;
+	cache->writebacks++;
+	cache->writebackBytes += bytes;
+	return bytes;
+}
+
+//@pre: bytes of block data written back from the level above reach level
+//@post: a write-back level holds the block dirty; a write-through level holds
+//       it and passes the data on. Memory (level == levelCount) absorbs it.
+//@return: none
+//@brief: Write backs are not demand accesses: they allocate regardless of
+//        write_allocate and are not counted as hits or misses.
+static void WritebackTo(cacheHierarchy *hierarchy, int level, uint64_t address, uint64_t bytes){
+	for (; level < hierarchy->levelCount; level++) {
+		cacheLevel *cache = &hierarchy->levels[level];
+		victimBuffer *buffer = &hierarchy->victims[level];
+		if (cache->config.writeBack) {
+			if (!MarkDirty(cache, address) && !MarkVictimDirty(buffer, address)) {
+				InsertBlock(hierarchy, level, address, true);
+			}
+			return;
+		}
+		if (!ProbeCache(cache, address) && !HoldsVictim(buffer, address)) {
+			InsertBlock(hierarchy, level, address, false);
+		}
+		cache->writebackBytes += bytes;
+	}
+}
+
+//@pre: victim is a block address evicted from level, dirty if it was modified
+//@post: the victim is moved into the level's victim cache, and whatever
+//       leaves the level is moved into an exclusive level below, or removed
+//       from the levels above an inclusive level; dirty data is written back
+//@return: none
+static void HandleVictim(cacheHierarchy *hierarchy, int level, uint64_t victim, bool dirty){
+	victimBuffer *buffer = &hierarchy->victims[level];
+	if (buffer->config.kind == VICTIM_CACHE && !PutInBuffer(buffer, victim, dirty, &victim, &dirty)) {
+		return;
+	}
+	// Dirty pieces above an inclusive level are written back with the victim
+	if (level > 0 && hierarchy->inclusion[level] == INCLUSIVE) {
+		dirty |= BackInvalidate(hierarchy, level, victim);
+	}
+	int lower = level + 1;
+	if (lower < hierarchy->levelCount && hierarchy->inclusion[lower] == EXCLUSIVE
+		&& !ProbeCache(&hierarchy->levels[lower], victim)) {
+		if (dirty) {
+			CountWriteback(&hierarchy->levels[level]);
+		}
+		InsertBlock(hierarchy, lower, victim, dirty);
+		return;
+	}
+	if (dirty) {
+		WritebackTo(hierarchy, lower, victim, CountWriteback(&hierarchy->levels[level]));
+	}
+}
+
+//@pre: the block holding address is not in level
+//@post: the block is in level, marked as a prefetch if prefetched, and any
+//       victim has been handled. A miss cache beside the level holds a copy.
+//@return: none
+static void FillBlock(cacheHierarchy *hierarchy, int level, uint64_t address, bool dirty, bool prefetched){
+	cacheLevel *cache = &hierarchy->levels[level];
+	uint64_t victim = 0;
+	bool victimDirty = false;
+	if (hierarchy->victims[level].config.kind == MISS_CACHE) {
+		PutInBuffer(&hierarchy->victims[level], address, false, &victim, &victimDirty);
+	}
+	bool evicted = FillCache(cache, address, dirty, &victim, &victimDirty);
+	if (hierarchy->prefetchers[level].config.kind != PREFETCH_NONE) {
+		NoteFill(&hierarchy->prefetchers[level], cache, address, prefetched, evicted, victim);
+	}
+	if (evicted) {
+		HandleVictim(hierarchy, level, victim, victimDirty);
+	}
+}
+
+//@pre: the block holding address is not in level
+//@post: the block is in level and any victim has been handled
+//@return: none
+static void InsertBlock(cacheHierarchy *hierarchy, int level, uint64_t address, bool dirty){
+	FillBlock(hierarchy, level, address, dirty, false);
+}
+
+//@pre: level has a buffer and has just missed on address
+//@post: on a hit in the buffer the block is back in level
+//@return: true if the buffer held the block
+static bool ReloadFromBuffer(cacheHierarchy *hierarchy, int level, uint64_t address){
+	bool dirty = false;
+	if (!TakeFromBuffer(&hierarchy->victims[level], address, &dirty)) {
+		return false;
+	}
+	FillBlock(hierarchy, level, address, dirty, false);
+	return true;
+}
+
+//@pre: a demand access to address reaches level
+//@post: the lookup is counted, and seen by the level's prefetcher and miss
+//       classifier. A hit in the level's buffer counts as a hit.
+//@return: true on a hit; *trigger is set on a miss or the first hit on a
+//         prefetched block
+static bool DemandLookup(cacheHierarchy *hierarchy, int level, uint64_t address, bool *trigger){
+	cacheLevel *cache = &hierarchy->levels[level];
+	prefetcher *prefetch = &hierarchy->prefetchers[level];
+	if (hierarchy->classifiers[level] != NULL) {
+		PrefetchClassification(hierarchy->classifiers[level], address);
+	}
+	uint32_t way = LookupWay(cache, address);
+	bool hit = way != cache->config.associativity;
+	if (!hit && hierarchy->victims[level].config.kind != VICTIM_NONE
+		&& ReloadFromBuffer(hierarchy, level, address)) {
+		way = ProbeWay(cache, address);
+		hit = true;
+	}
+	*(hit ? &cache->hits : &cache->misses) += 1;
+	if (cache->setStats != NULL) {
+		CountSetAccess(cache, address, hit);
+	}
+	*trigger = !hit;
+	if (prefetch->config.kind != PREFETCH_NONE) {
+		if (hit) {
+			*trigger = NoteDemandHit(prefetch, ParseLineFromAddress(cache, address), way);
+		}
+		else {
+			NoteDemandMiss(prefetch, address);
+		}
+	}
+	if (hierarchy->classifiers[level] != NULL) {
+		ClassifyAccess(hierarchy->classifiers[level], address, hit);
+	}
+	return hit;
+}
+
+static int FetchFrom(cacheHierarchy *hierarchy, int top, uint64_t address, bool demand);
+
+//@pre: a level with a prefetcher
+//@post: the candidates not already in level are fetched into it
+//@return: none
+static void IssuePrefetches(cacheHierarchy *hierarchy, int level, const uint64_t *candidates, size_t count){
+	for (size_t i = 0; i < count; i++) {
+		if (!ProbeCache(&hierarchy->levels[level], candidates[i])
+			&& !HoldsVictim(&hierarchy->victims[level], candidates[i])) {
+			hierarchy->prefetchers[level].issued++;
+			FetchFrom(hierarchy, level, candidates[i], false);
+		}
+	}
+}
+
+//@pre: a built hierarchy; top is the first level the access reaches
+//@post: a demand access is counted at every level from top down to the one
+//       that hit and trains their prefetchers; a prefetch is not counted.
+//       Either way the block is placed according to each level's inclusion
+//       policy.
+//@return: the level that hit, or levelCount if the access went to memory
+static int FetchFrom(cacheHierarchy *hierarchy, int top, uint64_t address, bool demand){
+	int hitLevel = hierarchy->levelCount;
+	bool triggers[MaxLevels_Nbr] = {false};
+	for (int i = top; i < hierarchy->levelCount; i++) {
+		if (demand ? DemandLookup(hierarchy, i, address, &triggers[i])
+			: ProbeCache(&hierarchy->levels[i], address) || HoldsVictim(&hierarchy->victims[i], address)) {
+			hitLevel = i;
+			break;
+		}
+	}
+
+	// An exclusive level gives the block, and its dirty data, up to the top.
+	// A write-through top cannot hold dirty data, so it is written back first.
+	bool dirty = false;
+	if (hitLevel > top && hitLevel < hierarchy->levelCount && hierarchy->inclusion[hitLevel] == EXCLUSIVE) {
+		cacheLevel *cache = &hierarchy->levels[hitLevel];
+		bool bufferDirty = false;
+		InvalidateCache(cache, address, &dirty);
+		InvalidateVictim(&hierarchy->victims[hitLevel], address, &bufferDirty);
+		dirty |= bufferDirty;
+		if (dirty && !hierarchy->levels[top].config.writeBack) {
+			WritebackTo(hierarchy, hitLevel + 1, address, CountWriteback(cache));
+			dirty = false;
+		}
+	}
+
+	// Fill from the bottom up so back-invalidations land before the upper fills
+	for (int i = hitLevel - 1; i >= top; i--) {
+		if (i > top && hierarchy->inclusion[i] == EXCLUSIVE) {
+			continue;
+		}
+		FillBlock(hierarchy, i, address, dirty && i == top, !demand && i == top);
+	}
+
+	for (int i = top; demand && i <= hitLevel && i < hierarchy->levelCount; i++) {
+		prefetcher *prefetch = &hierarchy->prefetchers[i];
+		if (prefetch->config.kind != PREFETCH_NONE) {
+			uint64_t candidates[PrefetchCandidates_Max];
+			IssuePrefetches(hierarchy, i, candidates, TrainPrefetcher(prefetch, address, triggers[i], candidates));
+		}
+	}
+	return hitLevel;
+}
+
+//@pre: a built hierarchy; top is the first level the access reaches
+//@post: the access is counted at every level from top down to the one that
+//       hit, and the block is placed according to each level's inclusion policy
+//@return: the level that hit, or levelCount if the access went to memory
+static int AccessFrom(cacheHierarchy *hierarchy, int top, uint64_t address){
+	return FetchFrom(hierarchy, top, address, true);
+}
+
+//@pre: a built hierarchy
+//@post: a load of address is counted at every level it reached and the block
+//       is placed according to each level's inclusion policy
+//@return: the level that hit, or levelCount if the access went to memory
+int AccessHierarchy(cacheHierarchy *hierarchy, uint64_t address){
+	return AccessFrom(hierarchy, 0, address);
+}
+
+//@pre: a built hierarchy
+//@post: a dirty block evicted from a cache above the hierarchy is written
+//       into it, as a write back from the level above its first level
+//@return: none
+void WritebackHierarchy(cacheHierarchy *hierarchy, uint64_t address, uint64_t bytes){
+	WritebackTo(hierarchy, 0, address, bytes);
+}
+
+//@pre: size bytes of a store are passed on to level by a write-through level
+//       above it that holds the block
+//@post: a level without the block allocates it if it is write-allocate and
+//       not exclusive; a write-back level holding the block then absorbs the
+//       data, and any other level passes it on. Memory (level == levelCount)
+//       absorbs it.
+//@return: none
+//@brief: Store data passed on is a write, not a demand access: it is not
+//        counted as a hit or miss and fetches nothing. An exclusive level
+//        never takes a block the level above still holds.
+static void WriteThroughTo(cacheHierarchy *hierarchy, int level, uint64_t address, uint32_t size){
+	for (; level < hierarchy->levelCount; level++) {
+		cacheLevel *cache = &hierarchy->levels[level];
+		victimBuffer *buffer = &hierarchy->victims[level];
+		bool held = ProbeCache(cache, address) || HoldsVictim(buffer, address);
+		if (!held && cache->config.writeAllocate && hierarchy->inclusion[level] != EXCLUSIVE) {
+			InsertBlock(hierarchy, level, address, false);
+			held = true;
+		}
+		if (held && cache->config.writeBack) {
+			if (!MarkDirty(cache, address)) {
+				MarkVictimDirty(buffer, address);
+			}
+			return;
+		}
+		cache->writeThroughBytes += size;
+	}
+}
+
+//@pre: a built hierarchy
+//@post: a store of size bytes is applied from the L1 down: a write-back level
+//       holding the block absorbs it, a write-through level writes it on to
+//       the levels below, and a no-write-allocate level that misses passes
+//       the store on without filling
+//@return: the level the store's fetch or lookup hit, or levelCount if it
+//         went to memory
+//@brief: A write-allocate miss fetches the block like a load before writing it
+int StoreHierarchy(cacheHierarchy *hierarchy, uint64_t address, uint32_t size){
+	bool trigger = false;
+	for (int level = 0; level < hierarchy->levelCount; level++) {
+		cacheLevel *cache = &hierarchy->levels[level];
+		int served = level;
+		if (cache->config.writeAllocate) {
+			served = AccessFrom(hierarchy, level, address);
+		}
+		else if (!DemandLookup(hierarchy, level, address, &trigger)) {
+			cache->writeThroughBytes += size;
+			continue;
+		}
+
+		if (cache->config.writeBack) {
+			MarkDirty(cache, address);
+		}
+		else {
+			cache->writeThroughBytes += size;
+			WriteThroughTo(hierarchy, level + 1, address, size);
+		}
+		return served;
+	}
+	return hierarchy->levelCount;
+}
+
+//@pre: a built hierarchy
+//@post: every address or record of the batch is run through the hierarchy in order
+//@return: none
+//@brief: A single level without a prefetcher, buffer or classifier keeps the
+//        specialized batch loop of the cache for raw traces, which hold
+//        only loads
+void SimulateHierarchy(cacheHierarchy *hierarchy, const traceBatch *batch){
+	if (batch->records != NULL) {
+		for (size_t i = 0; i < batch->count; i++) {
+			const traceRecord *record = &batch->records[i];
+			if (record->type == ACCESS_STORE) {
+				StoreHierarchy(hierarchy, record->address, record->size);
+			}
+			else {
+				AccessHierarchy(hierarchy, record->address);
+			}
+		}
+		return;
+	}
+	if (hierarchy->levelCount == 1 && hierarchy->prefetchers[0].config.kind == PREFETCH_NONE
+		&& hierarchy->victims[0].config.kind == VICTIM_NONE && hierarchy->classifiers[0] == NULL) {
+		SimulateAddresses(&hierarchy->levels[0], batch->addresses, batch->count);
+		return;
+	}
+	for (size_t i = 0; i < batch->count; i++) {
+		AccessHierarchy(hierarchy, batch->addresses[i]);
+	}
+}
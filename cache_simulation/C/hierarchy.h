@@ -0,0 +1,98 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: A stack of independently configured cache levels (L1, L2, L3, ...)
+//
+//	Description:
+//			Level 0 is the L1. Every lower level has an inclusion policy that
+//			describes its contents relative to the levels above it:
+//
+//			inclusive  -- holds every block held above it. Evicting a block
+//			              back-invalidates it from all levels above.
+//			exclusive  -- holds no block held above it. It is filled only by
+//			              victims of the level directly above, and a hit moves
+//			              the block up.
+//			nine       -- non-inclusive non-exclusive. Filled on every miss,
+//			              evicts without touching the levels above.
+//
+//			Stores from record traces follow each level's write policy. A
+//			write-back level keeps the store in a dirty block and writes the
+//			whole block to the level below when it is evicted; a write-through
+//			level passes the store on. A no-write-allocate level passes a
+//			store that misses on without filling the block.
+//
+//			Any level may have a prefetcher (prefetch.h), trained by the
+//			demand accesses that reach the level. Prefetched blocks are
+//			fetched from below as a miss would be, but are not counted as
+//			hits or misses of the levels they pass through.
+//
+//			Any level may also have a victim cache or a miss cache beside it
+//			(victim.h), looked up when the level misses.
+//
+//			With ClassifyHierarchyMisses every level's misses are also
+//			classified as compulsory, capacity or conflict (missclass.h).
+//
+
+#ifndef HIERARCHY_H_
+#define HIERARCHY_H_
+
+#include "cache.h"
+#include "missclass.h"
+#include "prefetch.h"
+#include "trace.h"
+#include "victim.h"
+
+#define  MaxLevels_Nbr  4
+
+typedef enum {INCLUSIVE = 0, EXCLUSIVE, NINE} inclusionPolicy;
+
+//Configuration of one level
+typedef struct levelConfig
+{
+	cacheConfig cache;
+	inclusionPolicy inclusion;
+	prefetchConfig prefetch;
+	victimConfig victim;
+} levelConfig;
+
+typedef struct hierarchyConfig
+{
+	int levelCount;
+	levelConfig levels[MaxLevels_Nbr];
+} hierarchyConfig;
+
+typedef struct cacheHierarchy
+{
+	int levelCount;
+	cacheLevel levels[MaxLevels_Nbr];
+	inclusionPolicy inclusion[MaxLevels_Nbr];
+	//blocks removed from upper levels because a lower inclusive level evicted them
+	uint64_t backInvalidations[MaxLevels_Nbr];
+	prefetcher prefetchers[MaxLevels_Nbr];
+	victimBuffer victims[MaxLevels_Nbr];
+	//3C classifiers of the demand accesses of each level, NULL when off
+	missClassifier *classifiers[MaxLevels_Nbr];
+} cacheHierarchy;
+
+void DefaultHierarchyConfig(hierarchyConfig *config);
+int  AddHierarchyLevel(hierarchyConfig *config);
+bool SetLevelOption(levelConfig *level, const char *key, const char *value);
+bool ParseLevelSpec(levelConfig *level, const char *spec);
+bool ParseHierarchySpec(hierarchyConfig *config, const char *spec);
+bool LoadHierarchyConfigFile(hierarchyConfig *config, const char *path);
+bool ConfigureHierarchy(hierarchyConfig *config);
+bool HierarchyPrefetches(const hierarchyConfig *config);
+bool HierarchyBuffers(const hierarchyConfig *config);
+
+const char *InclusionName(inclusionPolicy inclusion);
+
+bool buildHierarchy(cacheHierarchy *hierarchy, const hierarchyConfig *config);
+void destroyHierarchy(cacheHierarchy *hierarchy);
+bool ClassifyHierarchyMisses(cacheHierarchy *hierarchy);
+bool CountHierarchySets(cacheHierarchy *hierarchy);
+void ResetHierarchyCounters(cacheHierarchy *hierarchy);
+
+int  AccessHierarchy(cacheHierarchy *hierarchy, uint64_t address);
+int  StoreHierarchy(cacheHierarchy *hierarchy, uint64_t address, uint32_t size);
+void WritebackHierarchy(cacheHierarchy *hierarchy, uint64_t address, uint64_t bytes);
+void SimulateHierarchy(cacheHierarchy *hierarchy, const traceBatch *batch);
+
+#endif /* HIERARCHY_H_ */
@@ -0,0 +1,130 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Embeddable cache simulator (libcachesim.a)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hierarchy.h"
+#include "libcachesim.h"
+
+//
+//	Bytes written by a store given to cachesim_access
+//
+#define  StoreSize_Bytes  4
+
+struct cachesim
+{
+	hierarchyConfig config;
+	cacheHierarchy hierarchy;
+};
+
+//@pre: config holds the levels of a new simulator
+//@post: the levels are configured and built into a new handle
+//@return: the handle, or NULL (with a message) if the levels are invalid or
+//         memory is short
+static cachesim *BuildSimulator(hierarchyConfig *config){
+	if (!ConfigureHierarchy(config)) {
+		return NULL;
+	}
+	cachesim *sim = malloc(sizeof(cachesim));
+	if (sim == NULL || !buildHierarchy(&sim->hierarchy, config)) {
+		fprintf(stderr, "Unable to allocate the cache\n");
+		free(sim);
+		return NULL;
+	}
+	sim->config = *config;
+	return sim;
+}
+
+//@pre: spec lists the levels from the L1 down as cachesim -M takes them, or
+//      is NULL or empty for cachesim's default L1
+//@post: a simulator of those levels is built, empty
+//@return: the handle, or NULL (with a message) if the spec is invalid
+cachesim *cachesim_create(const char *spec){
+	hierarchyConfig config;
+	DefaultHierarchyConfig(&config);
+	if (spec != NULL && *spec != '\0' && !ParseHierarchySpec(&config, spec)) {
+		return NULL;
+	}
+	return BuildSimulator(&config);
+}
+
+//@pre: path names a cachesim config file (key = value lines, [Ln] sections)
+//@post: a simulator of the levels in the file is built, empty
+//@return: the handle, or NULL (with a message) if the file is invalid
+cachesim *cachesim_create_from_file(const char *path){
+	hierarchyConfig config;
+	DefaultHierarchyConfig(&config);
+	if (!LoadHierarchyConfigFile(&config, path)) {
+		return NULL;
+	}
+	return BuildSimulator(&config);
+}
+
+//@pre: a handle from cachesim_create, or NULL
+//@post: all of its memory is freed
+//@return: none
+void cachesim_destroy(cachesim *sim){
+	if (sim != NULL) {
+		destroyHierarchy(&sim->hierarchy);
+		free(sim);
+	}
+}
+
+//@pre: a handle
+//@return: the number of cache levels
+int cachesim_levels(const cachesim *sim){
+	return sim->hierarchy.levelCount;
+}
+
+//@pre: a handle
+//@post: the access is simulated; a store writes StoreSize_Bytes following
+//       each level's write policy
+//@return: the level that held the block (0 for the L1), or the number of
+//         levels if it came from memory
+int cachesim_access(cachesim *sim, uint64_t address, cachesim_access_type type){
+	if (type == CACHESIM_STORE) {
+		return StoreHierarchy(&sim->hierarchy, address, StoreSize_Bytes);
+	}
+	return AccessHierarchy(&sim->hierarchy, address);
+}
+
+//@pre: a handle and count 32-bit addresses, as in a raw trace
+//@post: every address is simulated as a load, in order
+//@return: none
+//@brief: A single level without a prefetcher or buffer takes the batch loop
+//        cachesim uses for raw traces
+void cachesim_access_n(cachesim *sim, const uint32_t *addresses, size_t count){
+	for (size_t done = 0; done < count; done += TraceBatch_Nbr) {
+		traceBatch batch = { addresses + done, NULL, count - done < TraceBatch_Nbr ? count - done : TraceBatch_Nbr };
+		SimulateHierarchy(&sim->hierarchy, &batch);
+	}
+}
+
+//@pre: a handle
+//@post: *stats holds the counters of level (0 for the L1)
+//@return: 0, or -1 if there is no such level
+int cachesim_get_stats(const cachesim *sim, int level, cachesim_stats *stats){
+	if (level < 0 || level >= sim->hierarchy.levelCount) {
+		return -1;
+	}
+	const cacheLevel *cache = &sim->hierarchy.levels[level];
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	stats->fills = cache->fills;
+	stats->evictions = cache->evictions;
+	stats->writebacks = cache->writebacks;
+	stats->writeback_bytes = cache->writebackBytes;
+	stats->write_through_bytes = cache->writeThroughBytes;
+	stats->back_invalidations = sim->hierarchy.backInvalidations[level];
+	return 0;
+}
+
+//@pre: a handle
+//@post: every counter is zero; the cache contents are kept
+//@return: none
+void cachesim_reset_stats(cachesim *sim){
+	ResetHierarchyCounters(&sim->hierarchy);
+}
@@ -0,0 +1,67 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Embeddable cache simulator (libcachesim.a)
+//
+//	Description:
+//			The public interface to the simulator core for other programs.
+//			A simulator is an opaque handle holding one cache hierarchy,
+//			described by the level specs cachesim takes with -M, e.g.
+//
+//			    cachesim *sim = cachesim_create("size=32K,ways=8;size=256K,ways=8");
+//			    cachesim_access(sim, 0x1000, CACHESIM_LOAD);
+//			    cachesim_access_n(sim, addresses, count);
+//			    cachesim_stats l1;
+//			    cachesim_get_stats(sim, 0, &l1);
+//			    cachesim_destroy(sim);
+//
+//			The library keeps no global state: every handle owns all of its
+//			memory, so any number of simulators may be used in one process,
+//			each from one thread at a time. Errors are reported on stderr.
+//
+//			Build the library with "make libcachesim.a" and link with
+//			-lcachesim -lm.
+//
+
+#ifndef LIBCACHESIM_H_
+#define LIBCACHESIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cachesim cachesim;
+
+//The kinds of access of a record trace; fetches are simulated as loads
+typedef enum {CACHESIM_LOAD = 0, CACHESIM_STORE, CACHESIM_IFETCH} cachesim_access_type;
+
+//Counters of one level since it was built or last reset
+typedef struct cachesim_stats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t fills;
+	uint64_t evictions;
+	uint64_t writebacks;
+	uint64_t writeback_bytes;
+	uint64_t write_through_bytes;
+	uint64_t back_invalidations;
+} cachesim_stats;
+
+cachesim *cachesim_create(const char *spec);
+cachesim *cachesim_create_from_file(const char *path);
+void cachesim_destroy(cachesim *sim);
+
+int  cachesim_levels(const cachesim *sim);
+int  cachesim_access(cachesim *sim, uint64_t address, cachesim_access_type type);
+void cachesim_access_n(cachesim *sim, const uint32_t *addresses, size_t count);
+
+int  cachesim_get_stats(const cachesim *sim, int level, cachesim_stats *stats);
+void cachesim_reset_stats(cachesim *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBCACHESIM_H_ */
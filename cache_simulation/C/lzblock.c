@@ -0,0 +1,162 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: A small LZ77 block codec for packed trace chunks
+//
+
+#include <string.h>
+
+#include "lzblock.h"
+
+static inline uint32_t Read32(const uint8_t *bytes){
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static inline uint32_t HashOf(uint32_t value){
+	return (value * 2654435761u) >> (32 - LzHash_Bits);
+}
+
+//@pre: out has room for length / 255 + 1 bytes
+//@post: the part of a length past its nibble is written
+//@return: the byte after the length
+static uint8_t *PutLength(uint8_t *out, size_t length){
+	while (length >= 255) {
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (uint8_t)length;
+	return out;
+}
+
+//@pre: *out points into a buffer ending at end; a match length of 0 marks the
+//      last sequence
+//@post: the sequence is written and *out advanced past it
+//@return: false if it does not fit
+static bool EmitSequence(uint8_t **out, const uint8_t *end, const uint8_t *literals,
+	size_t literalCount, size_t offset, size_t matchLength){
+	size_t needed = 1 + literalCount + literalCount / 255 + 1 + 2 + matchLength / 255 + 1;
+	if ((size_t)(end - *out) < needed) {
+		return false;
+	}
+	uint8_t *token = (*out)++;
+	*token = (uint8_t)((literalCount >= 15 ? 15 : literalCount) << 4);
+	if (literalCount >= 15) {
+		*out = PutLength(*out, literalCount - 15);
+	}
+	memcpy(*out, literals, literalCount);
+	*out += literalCount;
+	if (matchLength == 0) {
+		return true;
+	}
+
+	(*out)[0] = (uint8_t)offset;
+	(*out)[1] = (uint8_t)(offset >> 8);
+	*out += 2;
+	size_t extra = matchLength - LzMinMatch;
+	*token |= (uint8_t)(extra >= 15 ? 15 : extra);
+	if (extra >= 15) {
+		*out = PutLength(*out, extra - 15);
+	}
+	return true;
+}
+
+//@pre: destination has capacity bytes
+//@post: destination holds the compressed block
+//@return: the compressed size, or 0 if it would not fit in capacity
+size_t LzCompress(const uint8_t *source, size_t length, uint8_t *destination, size_t capacity){
+	uint32_t table[1 << LzHash_Bits];
+	memset(table, 0, sizeof(table));
+
+	uint8_t *out = destination;
+	const uint8_t *end = destination + capacity;
+	size_t anchor = 0;
+	size_t position = 0;
+	while (position + LzMinMatch <= length) {
+		uint32_t value = Read32(source + position);
+		uint32_t hash = HashOf(value);
+		size_t candidate = table[hash];
+		table[hash] = (uint32_t)position;
+		if (candidate >= position || position - candidate > LzMaxOffset
+			|| Read32(source + candidate) != value) {
+			position++;
+			continue;
+		}
+
+		size_t match = LzMinMatch;
+		while (position + match < length && source[candidate + match] == source[position + match]) {
+			match++;
+		}
+		if (!EmitSequence(&out, end, source + anchor, position - anchor, position - candidate, match)) {
+			return 0;
+		}
+		position += match;
+		anchor = position;
+	}
+	if (!EmitSequence(&out, end, source + anchor, length - anchor, 0, 0)) {
+		return 0;
+	}
+	return (size_t)(out - destination);
+}
+
+//@pre: *in points into a block ending at end, just past a nibble of 15
+//@post: the extension bytes are added to *length and *in advanced past them
+//@return: false if the block ends inside the length
+static bool GetLength(const uint8_t **in, const uint8_t *end, size_t *length){
+	uint8_t byte;
+	do {
+		if (*in == end) {
+			return false;
+		}
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+//@pre: destination has expected bytes
+//@post: destination holds the decompressed block
+//@return: false if the block is corrupt or does not decompress to exactly
+//         expected bytes
+bool LzDecompress(const uint8_t *source, size_t length, uint8_t *destination, size_t expected){
+	const uint8_t *in = source;
+	const uint8_t *inEnd = source + length;
+	uint8_t *out = destination;
+	uint8_t *outEnd = destination + expected;
+	while (in < inEnd) {
+		uint8_t token = *in++;
+		size_t literals = token >> 4;
+		if (literals == 15 && !GetLength(&in, inEnd, &literals)) {
+			return false;
+		}
+		if (literals > (size_t)(inEnd - in) || literals > (size_t)(outEnd - out)) {
+			return false;
+		}
+		memcpy(out, in, literals);
+		in += literals;
+		out += literals;
+		if (in == inEnd) {
+			break;
+		}
+
+		if (inEnd - in < 2) {
+			return false;
+		}
+		size_t offset = in[0] | (size_t)in[1] << 8;
+		in += 2;
+		size_t match = token & 15;
+		if (match == 15 && !GetLength(&in, inEnd, &match)) {
+			return false;
+		}
+		match += LzMinMatch;
+		if (offset == 0 || offset > (size_t)(out - destination) || match > (size_t)(outEnd - out)) {
+			return false;
+		}
+		// Matches may overlap their own output, so copy forwards a byte at a time
+		const uint8_t *from = out - offset;
+		for (size_t i = 0; i < match; i++) {
+			out[i] = from[i];
+		}
+		out += match;
+	}
+	return out == outEnd;
+}
@@ -0,0 +1,29 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: A small LZ77 block codec for packed trace chunks
+//
+//	Description:
+//			The block layout follows LZ4: a block is a list of sequences,
+//			each a token byte whose high nibble is the literal count and low
+//			nibble the match length minus LzMinMatch, the literals, a 16-bit
+//			little-endian match offset and the match. A nibble of 15 is
+//			extended by bytes of 255 up to a final smaller byte. The last
+//			sequence has literals only. Compression is a greedy single-probe
+//			hash search, which is enough for the repetitive varint streams of
+//			packed traces.
+//
+
+#ifndef LZBLOCK_H_
+#define LZBLOCK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define  LzMinMatch    4
+#define  LzMaxOffset   65535
+#define  LzHash_Bits   14
+
+size_t LzCompress(const uint8_t *source, size_t length, uint8_t *destination, size_t capacity);
+bool   LzDecompress(const uint8_t *source, size_t length, uint8_t *destination, size_t expected);
+
+#endif /* LZBLOCK_H_ */
@@ -0,0 +1,234 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: 3C miss classification with a seen-block set and an LRU shadow
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "missclass.h"
+
+#define  NoNode  UINT32_MAX
+
+//@return: the home slot of a block in a table of 2^bits slots
+static inline size_t HashBlock(uint64_t block, uint32_t bits){
+	return (size_t)((block * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+}
+
+//=============================================================================
+// SEEN SET
+//
+
+//@pre: a zeroed set
+//@post: the set is empty with 2^bits slots
+//@return: false if memory is short
+static bool buildBlockSet(blockSet *set, uint32_t bits){
+	set->slots = calloc((size_t)1 << bits, sizeof(seenRegion));
+	set->bits = bits;
+	set->count = 0;
+	return set->slots != NULL;
+}
+
+//@pre: a built set
+//@post: block is in the set; the table doubles when half its slots are used
+//@return: true if block was not in the set before
+static bool AddSeenBlock(blockSet *set, uint64_t block){
+	uint64_t region = (block >> 6) + 1;
+	uint64_t bit = 1ull << (block & 63);
+	size_t mask = ((size_t)1 << set->bits) - 1;
+	size_t slot = HashBlock(region, set->bits);
+	while (set->slots[slot].region != region && set->slots[slot].region != 0) {
+		slot = (slot + 1) & mask;
+	}
+	seenRegion *entry = &set->slots[slot];
+	bool added = (entry->blocks & bit) == 0;
+	entry->blocks |= bit;
+	if (entry->region != 0) {
+		return added;
+	}
+	entry->region = region;
+	if (++set->count * 2 <= mask + 1) {
+		return true;
+	}
+
+	blockSet grown;
+	if (!buildBlockSet(&grown, set->bits + 1)) {
+		// Out of memory: keep the full table, which still works until it fills
+		return true;
+	}
+	size_t grownMask = ((size_t)1 << grown.bits) - 1;
+	for (size_t i = 0; i <= mask; i++) {
+		if (set->slots[i].region != 0) {
+			size_t slot = HashBlock(set->slots[i].region, grown.bits);
+			while (grown.slots[slot].region != 0) {
+				slot = (slot + 1) & grownMask;
+			}
+			grown.slots[slot] = set->slots[i];
+		}
+	}
+	grown.count = set->count;
+	free(set->slots);
+	*set = grown;
+	return true;
+}
+
+//=============================================================================
+// LRU SHADOW
+//
+
+//@pre: a zeroed shadow
+//@post: the shadow is empty and holds up to capacity blocks
+//@return: false if memory is short
+static bool buildLruShadow(lruShadow *shadow, uint32_t capacity){
+	shadow->capacity = capacity;
+	shadow->head = shadow->tail = NoNode;
+	shadow->indexBits = 1;
+	while (((size_t)1 << shadow->indexBits) < (size_t)capacity * 4) {
+		shadow->indexBits++;
+	}
+	shadow->slotOf = malloc((size_t)capacity * sizeof(uint32_t));
+	shadow->prev = malloc((size_t)capacity * sizeof(uint32_t));
+	shadow->next = malloc((size_t)capacity * sizeof(uint32_t));
+	shadow->index = calloc((size_t)1 << shadow->indexBits, sizeof(shadowSlot));
+	return shadow->slotOf != NULL && shadow->prev != NULL && shadow->next != NULL && shadow->index != NULL;
+}
+
+//@return: the index slot holding block, or the empty slot ending its probe
+static size_t FindIndexSlot(const lruShadow *shadow, uint64_t block){
+	size_t mask = ((size_t)1 << shadow->indexBits) - 1;
+	size_t slot = HashBlock(block, shadow->indexBits);
+	while (shadow->index[slot].node != 0 && shadow->index[slot].block != block) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+//@pre: slot of the index holds a block
+//@post: the block is gone from the index; later blocks of its probe run are
+//       shifted back so every probe still reaches its block
+//@return: none
+static void RemoveIndexSlot(lruShadow *shadow, size_t slot){
+	size_t mask = ((size_t)1 << shadow->indexBits) - 1;
+	size_t hole = slot;
+	for (size_t next = (hole + 1) & mask; shadow->index[next].node != 0; next = (next + 1) & mask) {
+		size_t home = HashBlock(shadow->index[next].block, shadow->indexBits);
+		// Move the entry into the hole unless its home lies after the hole
+		if (((next - home) & mask) >= ((next - hole) & mask)) {
+			shadow->index[hole] = shadow->index[next];
+			shadow->slotOf[shadow->index[hole].node - 1] = (uint32_t)hole;
+			hole = next;
+		}
+	}
+	shadow->index[hole].node = 0;
+}
+
+//@post: node is unlinked from the recency list
+static void UnlinkNode(lruShadow *shadow, uint32_t node){
+	uint32_t prev = shadow->prev[node];
+	uint32_t next = shadow->next[node];
+	*(prev != NoNode ? &shadow->next[prev] : &shadow->head) = next;
+	*(next != NoNode ? &shadow->prev[next] : &shadow->tail) = prev;
+}
+
+//@post: node is the most recently used
+static void PushFront(lruShadow *shadow, uint32_t node){
+	shadow->prev[node] = NoNode;
+	shadow->next[node] = shadow->head;
+	*(shadow->head != NoNode ? &shadow->prev[shadow->head] : &shadow->tail) = node;
+	shadow->head = node;
+}
+
+//@pre: a built shadow
+//@post: block is the most recently used; on a miss the least recently used
+//       block is evicted if the shadow is full
+//@return: true if block was in the shadow
+static bool ShadowAccess(lruShadow *shadow, uint64_t block){
+	size_t slot = FindIndexSlot(shadow, block);
+	if (shadow->index[slot].node != 0) {
+		uint32_t node = shadow->index[slot].node - 1;
+		if (node != shadow->head) {
+			UnlinkNode(shadow, node);
+			PushFront(shadow, node);
+		}
+		return true;
+	}
+
+	uint32_t node;
+	if (shadow->count < shadow->capacity) {
+		node = shadow->count++;
+	}
+	else {
+		node = shadow->tail;
+		UnlinkNode(shadow, node);
+		RemoveIndexSlot(shadow, shadow->slotOf[node]);
+		// The removal may have shifted the empty slot of the new block
+		slot = FindIndexSlot(shadow, block);
+	}
+	shadow->index[slot] = (shadowSlot){.block = block, .node = node + 1};
+	shadow->slotOf[node] = (uint32_t)slot;
+	PushFront(shadow, node);
+	return false;
+}
+
+//=============================================================================
+// CLASSIFIER
+//
+
+//@pre: a configured cache
+//@post: the classifier has a shadow of the cache's capacity and an empty
+//       seen set
+//@return: false if memory is short
+bool buildMissClassifier(missClassifier *classifier, const cacheConfig *config){
+	memset(classifier, 0, sizeof(*classifier));
+	classifier->blockSize_Exp = config->blockSize_Exp;
+	bool built = buildBlockSet(&classifier->seen, SeenSet_InitialBits);
+	built = buildLruShadow(&classifier->shadow, config->lines_Nbr * config->associativity) && built;
+	if (!built) {
+		destroyMissClassifier(classifier);
+	}
+	return built;
+}
+
+//@pre: a built or zeroed classifier
+//@post: all memory is freed
+//@return: none
+void destroyMissClassifier(missClassifier *classifier){
+	free(classifier->seen.slots);
+	free(classifier->shadow.slotOf);
+	free(classifier->shadow.prev);
+	free(classifier->shadow.next);
+	free(classifier->shadow.index);
+	memset(classifier, 0, sizeof(*classifier));
+}
+
+//@pre: a built classifier
+//@post: the shadow index and seen set slots of address are on their way into
+//       the processor's cache, so their misses overlap the cache lookup
+//@return: none
+void PrefetchClassification(const missClassifier *classifier, uint64_t address){
+	uint64_t block = address >> classifier->blockSize_Exp;
+	__builtin_prefetch(&classifier->shadow.index[HashBlock(block, classifier->shadow.indexBits)]);
+	__builtin_prefetch(&classifier->seen.slots[HashBlock((block >> 6) + 1, classifier->seen.bits)]);
+}
+
+//@pre: a demand access to address hit or missed in the classified cache
+//@post: the shadow and seen set have seen the access; a miss is counted
+//       under its class
+//@return: none
+void ClassifyAccess(missClassifier *classifier, uint64_t address, bool hit){
+	uint64_t block = address >> classifier->blockSize_Exp;
+	bool shadowHit = ShadowAccess(&classifier->shadow, block);
+	// A shadow hit is a block seen before, so only shadow misses are looked up
+	bool first = !shadowHit && AddSeenBlock(&classifier->seen, block);
+	if (hit) {
+		return;
+	}
+	if (first) {
+		classifier->compulsory++;
+	}
+	else if (!shadowHit) {
+		classifier->capacity++;
+	}
+	else {
+		classifier->conflict++;
+	}
+}
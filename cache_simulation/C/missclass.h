@@ -0,0 +1,88 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Compulsory / capacity / conflict classification of cache misses
+//
+//	Description:
+//			Every demand access to a level is also run through a fully
+//			associative LRU cache of the same capacity and block size (the
+//			shadow) and a set of every block seen so far. A miss in the
+//			level is then
+//
+//			compulsory -- the first access to its block
+//			capacity   -- also a miss in the shadow: no placement of a cache
+//			              this size would have kept the block
+//			conflict   -- a hit in the shadow: more associativity would have
+//			              kept the block
+//
+//			The shadow is a doubly linked recency list over a fixed node
+//			array with an open-addressing index from block to node, kept at
+//			most a quarter full, so an access is O(1). The seen set is an
+//			open-addressing table with one slot per 64-block region, holding
+//			a bitmask of the blocks of the region seen so far, so a dense
+//			footprint costs a bit per block. It doubles when half full.
+//
+
+#ifndef MISSCLASS_H_
+#define MISSCLASS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+#define  SeenSet_InitialBits  16
+
+//One slot of the seen set: region number + 1 (0 for an empty slot) and a
+//bit per block of the region
+typedef struct seenRegion
+{
+	uint64_t region;
+	uint64_t blocks;
+} seenRegion;
+
+typedef struct blockSet
+{
+	seenRegion *slots;
+	uint32_t bits;
+	size_t count;
+} blockSet;
+
+//One slot of the shadow's index: a block and its node + 1, 0 for an empty slot
+typedef struct shadowSlot
+{
+	uint64_t block;
+	uint32_t node;
+} shadowSlot;
+
+//Fully associative LRU cache of capacity blocks
+typedef struct lruShadow
+{
+	uint32_t capacity;
+	uint32_t count;
+	//index slot of each node, and the recency list from head (most recent)
+	uint32_t *slotOf;
+	uint32_t *prev;
+	uint32_t *next;
+	uint32_t head;
+	uint32_t tail;
+	shadowSlot *index;
+	uint32_t indexBits;
+} lruShadow;
+
+typedef struct missClassifier
+{
+	uint32_t blockSize_Exp;
+	blockSet seen;
+	lruShadow shadow;
+
+	uint64_t compulsory;
+	uint64_t capacity;
+	uint64_t conflict;
+} missClassifier;
+
+bool buildMissClassifier(missClassifier *classifier, const cacheConfig *config);
+void destroyMissClassifier(missClassifier *classifier);
+void PrefetchClassification(const missClassifier *classifier, uint64_t address);
+void ClassifyAccess(missClassifier *classifier, uint64_t address, bool hit);
+
+#endif /* MISSCLASS_H_ */
@@ -0,0 +1,136 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Replacement policy selection and state allocation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "policy.h"
+
+static const char *PolicyNames[] = {
+	"rr", "lru", "plru", "fifo", "random", "nru", "srrip", "brrip", "drrip"
+};
+
+#define  Policies_Nbr  ( sizeof(PolicyNames) / sizeof(PolicyNames[0]) )
+
+//@pre: name is a policy name such as "lru"
+//@post: *policy holds the matching policy
+//@return: false if the name is not known
+bool ParseReplacementPolicy(const char *name, replacementPolicy *policy){
+	for (size_t i = 0; i < Policies_Nbr; i++) {
+		if (strcasecmp(name, PolicyNames[i]) == 0) {
+			*policy = (replacementPolicy)i;
+			return true;
+		}
+	}
+	if (strcasecmp(name, "roundrobin") == 0) {
+		*policy = ROUND_ROBIN;
+		return true;
+	}
+	return false;
+}
+
+//@pre: a valid policy
+//@return: its name
+const char *ReplacementPolicyName(replacementPolicy policy){
+	return PolicyNames[policy];
+}
+
+//@pre: a valid policy
+//@return: false (with a message) if the policy cannot manage that many sets of
+//         that many ways
+bool CheckReplacementPolicy(replacementPolicy policy, uint32_t lines, uint32_t ways){
+	switch (policy) {
+		case DRRIP:
+			if (lines < LeaderStride_Min) {
+				fprintf(stderr, "drrip needs at least %d sets to duel\n", LeaderStride_Min);
+				return false;
+			}
+			break;
+		case PLRU:
+			if ((ways & (ways - 1)) != 0) {
+				fprintf(stderr, "plru needs a power of two associativity\n");
+				return false;
+			}
+			break;
+		default:
+			break;
+	}
+	return true;
+}
+
+//@return: the bytes of state kept for one set
+static uint32_t StateStride(replacementPolicy policy, uint32_t ways){
+	switch (policy) {
+		case ROUND_ROBIN:
+		case RANDOM: return sizeof(uint32_t);
+		case PLRU:
+		case NRU:   return (ways + 7) / 8;
+		case LRU:
+		case FIFO:  return ways >= IndexedSet_MinWays ? (2 * ways + 2) * sizeof(uint32_t) : ways;
+		default:    return ways;
+	}
+}
+
+//@pre: CheckReplacementPolicy accepted policy for lines and ways
+//@post: state holds the initial state of every set
+//@return: false if the state could not be allocated
+bool buildReplacementState(replacementState *state, replacementPolicy policy, uint32_t lines, uint32_t ways){
+	memset(state, 0, sizeof(*state));
+	state->policy = policy;
+	state->ways = ways;
+	state->stride = StateStride(policy, ways);
+	state->sets = calloc(lines, state->stride);
+	if (state->sets == NULL) {
+		return false;
+	}
+
+	state->psel = PSEL_Max / 2;
+	// Two sets of every stride lead, so a stride of 2 would leave no followers
+	state->leaderStride = lines / LeaderSets_Nbr;
+	if (state->leaderStride < LeaderStride_Min) {
+		state->leaderStride = LeaderStride_Min;
+	}
+
+	for (uint32_t line = 0; line < lines; line++) {
+		uint8_t *set = state->sets + (size_t)line * state->stride;
+		switch (policy) {
+			case LRU:
+			case FIFO:
+				if (ways >= IndexedSet_MinWays) {
+					uint32_t *links = (uint32_t *)set;
+					for (uint32_t i = 0; i < ways; i++) {
+						links[2 * i] = UnlistedWay;
+					}
+					links[2 * ways] = links[2 * ways + 1] = NoWay;
+					break;
+				}
+				for (uint32_t i = 0; i < ways; i++) {
+					set[i] = (uint8_t)i;
+				}
+				break;
+			case RANDOM:
+				// any non-zero seed will do, spread them out by set
+				*(uint32_t *)set = (line + 1) * 2654435761u | 1;
+				break;
+			case SRRIP:
+			case BRRIP:
+			case DRRIP:
+				memset(set, RRPV_Max, ways);
+				break;
+			default:
+				break;
+		}
+	}
+	return true;
+}
+
+//@pre: state was built by buildReplacementState
+//@post: the state memory is released
+//@return: none
+void destroyReplacementState(replacementState *state){
+	free(state->sets);
+	state->sets = NULL;
+}
@@ -0,0 +1,323 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Replacement policies for the cache simulation
+//
+//	Description:
+//			Every policy keeps its state per set in one flat byte array,
+//			replStride bytes for each set, so a set's state sits next to
+//			itself in memory and there are no per-set allocations:
+//
+//			rr     -- round robin pointer                 4 bytes per set
+//			lru    -- recency rank of every way           1 byte per way
+//			plru   -- tree pseudo-LRU, ways-1 node bits   1 bit per way
+//			fifo   -- insertion rank of every way         1 byte per way
+//			random -- xorshift generator per set          4 bytes per set
+//			nru    -- not-recently-used bit               1 bit per way
+//			srrip  -- 2-bit re-reference prediction value 1 byte per way
+//			brrip  -- as srrip, inserting at distant RRPV 1 byte per way
+//			drrip  -- srrip/brrip chosen by set dueling   1 byte per way
+//
+//			Ranks cost a pass over the set on every access, so sets of
+//			IndexedSet_MinWays or more ways keep lru and fifo as an intrusive
+//			recency list instead: the previous and next way of every way,
+//			then the head (most recent) and tail, 8 bytes per way. A way
+//			joins the list when it is first filled.
+//
+//			The hooks below are inline and switch on the policy so that the
+//			specialized lookup loops in cache.c keep a constant way count.
+//			Invalid ways are always filled before a policy is asked for a
+//			victim.
+//
+
+#ifndef POLICY_H_
+#define POLICY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {ROUND_ROBIN = 0, LRU, PLRU, FIFO, RANDOM, NRU, SRRIP, BRRIP, DRRIP} replacementPolicy;
+
+//
+//	RRIP parameters: 2-bit RRPVs, BRRIP inserts "long" once every 32 fills,
+//	DRRIP has a 10-bit policy selector and up to 32 leader sets of each kind,
+//	fewer in caches with too few sets to leave at least half of them following
+//
+#define  RRPV_Max            3
+#define  BRRIP_Long_Period   32
+#define  PSEL_Bits           10
+#define  PSEL_Max            ( (1 << PSEL_Bits) - 1 )
+#define  LeaderSets_Nbr      32
+#define  LeaderStride_Min    4
+
+//
+//	Sets of this many ways or more are indexed (cache.h) and keep lru and
+//	fifo as a recency list
+//
+#define  IndexedSet_MinWays  64
+#define  NoWay               UINT32_MAX
+#define  UnlistedWay         ( UINT32_MAX - 1 )
+
+//Replacement state of one cache
+typedef struct replacementState
+{
+	replacementPolicy policy;
+	uint32_t ways;
+	uint32_t stride;
+	uint8_t *sets;
+	//DRRIP policy selector and distance between leader sets
+	uint32_t psel;
+	uint32_t leaderStride;
+	//counter used by BRRIP (and DRRIP followers) to pick long insertions
+	uint32_t brripCount;
+} replacementState;
+
+bool ParseReplacementPolicy(const char *name, replacementPolicy *policy);
+const char *ReplacementPolicyName(replacementPolicy policy);
+bool CheckReplacementPolicy(replacementPolicy policy, uint32_t lines, uint32_t ways);
+
+bool buildReplacementState(replacementState *state, replacementPolicy policy, uint32_t lines, uint32_t ways);
+void destroyReplacementState(replacementState *state);
+
+//=============================================================================
+// BIT AND RANK HELPERS
+//
+
+static inline bool GetStateBit(const uint8_t *bits, uint32_t index){
+	return (bits[index >> 3] >> (index & 7)) & 1;
+}
+
+static inline void SetStateBit(uint8_t *bits, uint32_t index, bool value){
+	if (value) {
+		bits[index >> 3] |= (uint8_t)(1u << (index & 7));
+	}
+	else {
+		bits[index >> 3] &= (uint8_t)~(1u << (index & 7));
+	}
+}
+
+//@brief: Moves way to rank 0, aging every way that was more recent than it
+static inline __attribute__((always_inline))
+void PromoteRank(uint8_t *ranks, uint32_t ways, uint32_t way){
+	uint8_t rank = ranks[way];
+	for (uint32_t i = 0; i < ways; i++) {
+		ranks[i] += ranks[i] < rank;
+	}
+	ranks[way] = 0;
+}
+
+//@return: the way holding the oldest rank
+static inline __attribute__((always_inline))
+uint32_t OldestRank(const uint8_t *ranks, uint32_t ways){
+	for (uint32_t i = 0; i < ways; i++) {
+		if (ranks[i] == ways - 1) {
+			return i;
+		}
+	}
+	return 0;
+}
+
+//@pre: way is on the recency list links of a set
+//@post: its neighbours are linked to each other instead
+static inline void UnlinkWay(uint32_t *links, uint32_t ways, uint32_t way){
+	uint32_t prev = links[2 * way];
+	uint32_t next = links[2 * way + 1];
+	*(prev != NoWay ? &links[2 * prev + 1] : &links[2 * ways]) = next;
+	*(next != NoWay ? &links[2 * next] : &links[2 * ways + 1]) = prev;
+}
+
+//@brief: Moves way to the head of the recency list, adding it if it was never
+//        filled
+static inline __attribute__((always_inline))
+void PromoteListed(uint8_t *set, uint32_t ways, uint32_t way){
+	uint32_t *links = (uint32_t *)set;
+	uint32_t head = links[2 * ways];
+	if (head == way) {
+		return;
+	}
+	if (links[2 * way] != UnlistedWay) {
+		UnlinkWay(links, ways, way);
+		head = links[2 * ways];
+	}
+	links[2 * way] = NoWay;
+	links[2 * way + 1] = head;
+	*(head != NoWay ? &links[2 * head] : &links[2 * ways + 1]) = way;
+	links[2 * ways] = way;
+}
+
+//@return: the way at the tail of the recency list
+static inline uint32_t OldestListed(const uint8_t *set, uint32_t ways){
+	return ((const uint32_t *)set)[2 * ways + 1];
+}
+
+//@brief: Points every tree node on the path to way away from it
+static inline __attribute__((always_inline))
+void TouchPLRU(uint8_t *bits, uint32_t ways, uint32_t way){
+	uint32_t node = 1;
+	for (uint32_t span = ways >> 1; span > 0; span >>= 1) {
+		bool right = (way & span) != 0;
+		SetStateBit(bits, node - 1, !right);
+		node = 2 * node + right;
+	}
+}
+
+static inline __attribute__((always_inline))
+uint32_t VictimPLRU(const uint8_t *bits, uint32_t ways){
+	uint32_t node = 1;
+	uint32_t way = 0;
+	for (uint32_t span = ways >> 1; span > 0; span >>= 1) {
+		bool right = GetStateBit(bits, node - 1);
+		way = (way << 1) | right;
+		node = 2 * node + right;
+	}
+	return way;
+}
+
+static inline __attribute__((always_inline))
+void TouchNRU(uint8_t *bits, uint32_t ways, uint32_t way){
+	SetStateBit(bits, way, true);
+	for (uint32_t i = 0; i < ways; i++) {
+		if (!GetStateBit(bits, i)) {
+			return;
+		}
+	}
+	// Every way is recently used, start a new epoch with only this one
+	for (uint32_t i = 0; i < (ways + 7) / 8; i++) {
+		bits[i] = 0;
+	}
+	SetStateBit(bits, way, true);
+}
+
+static inline __attribute__((always_inline))
+uint32_t VictimNRU(const uint8_t *bits, uint32_t ways){
+	for (uint32_t i = 0; i < ways; i++) {
+		if (!GetStateBit(bits, i)) {
+			return i;
+		}
+	}
+	return 0;
+}
+
+static inline __attribute__((always_inline))
+uint32_t VictimRRIP(uint8_t *rrpv, uint32_t ways){
+	for (;;) {
+		for (uint32_t i = 0; i < ways; i++) {
+			if (rrpv[i] == RRPV_Max) {
+				return i;
+			}
+		}
+		for (uint32_t i = 0; i < ways; i++) {
+			rrpv[i]++;
+		}
+	}
+}
+
+//@brief: The generator is kept per set so that a set's choices depend only on
+//        the accesses to that set
+static inline uint32_t NextRandom(uint32_t *seed){
+	uint32_t x = *seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*seed = x;
+	return x;
+}
+
+//@return: 0 for an SRRIP leader set, 1 for a BRRIP leader set, 2 for a follower
+static inline uint32_t DuelingRole(const replacementState *state, uint32_t line){
+	uint32_t offset = line % state->leaderStride;
+	return offset < 2 ? offset : 2;
+}
+
+//@return: the RRPV a DRRIP or BRRIP fill of set line is inserted with
+static inline uint8_t InsertionRRPV(replacementState *state, uint32_t line){
+	bool bimodal = state->policy == BRRIP;
+	if (state->policy == DRRIP) {
+		uint32_t role = DuelingRole(state, line);
+		// A miss in a leader set is a vote against that leader's policy
+		if (role == 0 && state->psel < PSEL_Max) {
+			state->psel++;
+		}
+		else if (role == 1 && state->psel > 0) {
+			state->psel--;
+		}
+		bimodal = role == 1 || (role == 2 && state->psel > PSEL_Max / 2);
+	}
+	if (!bimodal) {
+		return RRPV_Max - 1;
+	}
+	return (state->brripCount++ % BRRIP_Long_Period) == 0 ? RRPV_Max - 1 : RRPV_Max;
+}
+
+//=============================================================================
+// POLICY HOOKS
+//
+
+//@pre: way of set line holds a valid block that was just hit
+//@post: the policy state of the set records the hit
+static inline __attribute__((always_inline))
+void ReplacementHit(replacementState *state, uint32_t line, uint32_t way, uint32_t ways){
+	uint8_t *set = state->sets + (size_t)line * state->stride;
+	switch (state->policy) {
+		case LRU:
+			if (ways >= IndexedSet_MinWays) {
+				PromoteListed(set, ways, way);
+			}
+			else {
+				PromoteRank(set, ways, way);
+			}
+			break;
+		case PLRU:  TouchPLRU(set, ways, way); break;
+		case NRU:   TouchNRU(set, ways, way); break;
+		case SRRIP:
+		case BRRIP:
+		case DRRIP: set[way] = 0; break;
+		default: break;
+	}
+}
+
+//@pre: way of set line was just filled with a new block
+//@post: the policy state of the set records the fill
+static inline __attribute__((always_inline))
+void ReplacementInsert(replacementState *state, uint32_t line, uint32_t way, uint32_t ways){
+	uint8_t *set = state->sets + (size_t)line * state->stride;
+	switch (state->policy) {
+		case LRU:
+		case FIFO:
+			if (ways >= IndexedSet_MinWays) {
+				PromoteListed(set, ways, way);
+			}
+			else {
+				PromoteRank(set, ways, way);
+			}
+			break;
+		case PLRU:  TouchPLRU(set, ways, way); break;
+		case NRU:   TouchNRU(set, ways, way); break;
+		case SRRIP:
+		case BRRIP:
+		case DRRIP: set[way] = InsertionRRPV(state, line); break;
+		default: break;
+	}
+}
+
+//@pre: every way of set line holds a valid block
+//@post: policies that advance on a replacement have advanced
+//@return: the way to replace
+static inline __attribute__((always_inline))
+uint32_t ReplacementVictim(replacementState *state, uint32_t line, uint32_t ways){
+	uint8_t *set = state->sets + (size_t)line * state->stride;
+	uint32_t *word = (uint32_t *)set;
+	switch (state->policy) {
+		case ROUND_ROBIN: return (*word)++ % ways;
+		case LRU:
+		case FIFO:  return ways >= IndexedSet_MinWays ? OldestListed(set, ways) : OldestRank(set, ways);
+		case PLRU:  return VictimPLRU(set, ways);
+		case RANDOM: return NextRandom(word) % ways;
+		case NRU:   return VictimNRU(set, ways);
+		case SRRIP:
+		case BRRIP:
+		case DRRIP: return VictimRRIP(set, ways);
+	}
+	return 0;
+}
+
+#endif /* POLICY_H_ */
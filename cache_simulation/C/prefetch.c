@@ -0,0 +1,382 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Prefetcher selection, training and accuracy bookkeeping
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "prefetch.h"
+
+static const char *PrefetchNames[] = {"none", "nextline", "stride", "stream", "sms"};
+
+#define  Prefetchers_Nbr  ( sizeof(PrefetchNames) / sizeof(PrefetchNames[0]) )
+
+//@pre: none
+//@post: config holds no prefetcher with the default degree and latency
+//@return: none
+void DefaultPrefetchConfig(prefetchConfig *config){
+	config->kind = PREFETCH_NONE;
+	config->degree = Default_PrefetchDegree;
+	config->latency = Default_PrefetchLatency;
+}
+
+//@pre: name is a prefetcher name such as "stride"
+//@post: *kind holds the matching prefetcher
+//@return: false if the name is not known
+bool ParsePrefetchKind(const char *name, prefetchKind *kind){
+	for (size_t i = 0; i < Prefetchers_Nbr; i++) {
+		if (strcasecmp(name, PrefetchNames[i]) == 0) {
+			*kind = (prefetchKind)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//@pre: spec is a prefetcher name optionally followed by degree=n and
+//      latency=n, e.g. "stream,degree=4"
+//@post: config holds the options of spec
+//@return: false (with a message) if the spec is malformed
+bool ParsePrefetchSpec(prefetchConfig *config, const char *spec){
+	char *copy = strdup(spec);
+	char *saveptr = NULL;
+	char *item = strtok_r(copy, ", \t", &saveptr);
+	bool ok = item != NULL && ParsePrefetchKind(item, &config->kind);
+	if (!ok) {
+		fprintf(stderr, "Unknown prefetcher: %s\n", item != NULL ? item : "");
+	}
+	while (ok && (item = strtok_r(NULL, ", \t", &saveptr)) != NULL) {
+		if (strncasecmp(item, "degree=", 7) == 0) {
+			ok = ParseCount(item + 7, 1, PrefetchCandidates_Max, &config->degree);
+		}
+		else if (strncasecmp(item, "latency=", 8) == 0) {
+			ok = ParseCount(item + 8, 0, UINT32_MAX, &config->latency);
+		}
+		else {
+			ok = false;
+		}
+		if (!ok) {
+			fprintf(stderr, "Bad prefetcher option: %s\n", item);
+		}
+	}
+	free(copy);
+	return ok;
+}
+
+//@pre: a valid prefetcher kind
+//@return: its name
+const char *PrefetchKindName(prefetchKind kind){
+	return PrefetchNames[kind];
+}
+
+//@pre: a built cache
+//@post: prefetch tracks the cache's ways and holds empty tables for its kind;
+//       with no prefetcher nothing is allocated
+//@return: false if memory is short
+bool buildPrefetcher(prefetcher *prefetch, const prefetchConfig *config, const cacheLevel *cache){
+	memset(prefetch, 0, sizeof(*prefetch));
+	prefetch->config = *config;
+	if (config->kind == PREFETCH_NONE) {
+		return true;
+	}
+	uint32_t blockExp = cache->config.blockSize_Exp;
+	size_t ways = (size_t)cache->config.lines_Nbr * cache->config.associativity;
+	prefetch->blockSize_Exp = blockExp;
+	prefetch->validWords = cache->validWords;
+	prefetch->ways = cache->config.associativity;
+	prefetch->prefetched = calloc((size_t)cache->config.lines_Nbr * cache->validWords, sizeof(uint64_t));
+	prefetch->ready = calloc(ways, sizeof(uint64_t));
+	prefetch->pollution = calloc(PollutionFilter_Nbr, sizeof(uint64_t));
+	bool tables = true;
+	switch (config->kind) {
+		case PREFETCH_STRIDE:
+			tables = (prefetch->strides = calloc(StrideTable_Nbr, sizeof(strideEntry))) != NULL;
+			break;
+		case PREFETCH_STREAM:
+			tables = (prefetch->streams = calloc(Streams_Nbr, sizeof(streamEntry))) != NULL;
+			break;
+		case PREFETCH_SMS:
+			// A region is at least one block and at most 64, one bit each
+			prefetch->regionExp = SmsRegion_Exp < blockExp ? blockExp
+				: SmsRegion_Exp > blockExp + 6 ? blockExp + 6 : SmsRegion_Exp;
+			prefetch->generations = calloc(SmsGenerations_Nbr, sizeof(smsGeneration));
+			prefetch->patterns = calloc(1u << (prefetch->regionExp - blockExp), sizeof(uint64_t));
+			tables = prefetch->generations != NULL && prefetch->patterns != NULL;
+			break;
+		default:
+			break;
+	}
+	if (prefetch->prefetched == NULL || prefetch->ready == NULL || prefetch->pollution == NULL || !tables) {
+		destroyPrefetcher(prefetch);
+		return false;
+	}
+	return true;
+}
+
+//@pre: a built or zeroed prefetcher
+//@post: all memory is freed
+//@return: none
+void destroyPrefetcher(prefetcher *prefetch){
+	free(prefetch->prefetched);
+	free(prefetch->ready);
+	free(prefetch->pollution);
+	free(prefetch->strides);
+	free(prefetch->streams);
+	free(prefetch->generations);
+	free(prefetch->patterns);
+	memset(prefetch, 0, sizeof(*prefetch));
+}
+
+//=============================================================================
+// BOOKKEEPING
+//
+
+//@return: the pollution filter slot of a block number
+static inline uint64_t *PollutionSlot(const prefetcher *prefetch, uint64_t block){
+	return &prefetch->pollution[(block * 0x9E3779B97F4A7C15ull) >> 52 & (PollutionFilter_Nbr - 1)];
+}
+
+//@pre: a demand access hit way of set line of the prefetcher's level
+//@post: a prefetched block is counted useful (and late if it had not yet
+//       arrived) and is a demand block from now on
+//@return: true if the block had been prefetched
+bool NoteDemandHit(prefetcher *prefetch, uint32_t line, uint32_t way){
+	prefetch->clock++;
+	uint64_t *word = &prefetch->prefetched[(size_t)line * prefetch->validWords + way / 64];
+	uint64_t bit = 1ull << (way % 64);
+	if ((*word & bit) == 0) {
+		return false;
+	}
+	*word &= ~bit;
+	prefetch->useful++;
+	if (prefetch->clock < prefetch->ready[(size_t)line * prefetch->ways + way]) {
+		prefetch->late++;
+	}
+	return true;
+}
+
+//@pre: a demand access missed in the prefetcher's level
+//@post: a miss on a block a prefetch evicted is counted as pollution
+//@return: none
+void NoteDemandMiss(prefetcher *prefetch, uint64_t address){
+	prefetch->clock++;
+	uint64_t block = address >> prefetch->blockSize_Exp;
+	uint64_t *slot = PollutionSlot(prefetch, block);
+	if (*slot == block + 1) {
+		prefetch->polluting++;
+		*slot = 0;
+	}
+}
+
+//@pre: the block holding address was just filled into cache, evicting victim
+//      if evicted is set
+//@post: the way's previous block is counted unused if it was an unused
+//       prefetch; a prefetched fill is marked and its victim recorded
+//@return: none
+void NoteFill(prefetcher *prefetch, const cacheLevel *cache, uint64_t address, bool prefetched,
+	bool evicted, uint64_t victim){
+	uint32_t line = ParseLineFromAddress(cache, address);
+	uint32_t way = ProbeWay(cache, address);
+	uint64_t *word = &prefetch->prefetched[(size_t)line * prefetch->validWords + way / 64];
+	uint64_t bit = 1ull << (way % 64);
+	if (*word & bit) {
+		prefetch->unused++;
+	}
+	if (prefetched) {
+		*word |= bit;
+		prefetch->ready[(size_t)line * prefetch->ways + way] = prefetch->clock + prefetch->config.latency;
+		if (evicted) {
+			uint64_t block = victim >> prefetch->blockSize_Exp;
+			*PollutionSlot(prefetch, block) = block + 1;
+		}
+	}
+	else {
+		*word &= ~bit;
+	}
+
+	// An SMS generation ends when any block of its region leaves the cache
+	if (evicted && prefetch->config.kind == PREFETCH_SMS) {
+		uint64_t region = victim >> prefetch->regionExp;
+		for (int i = 0; i < SmsGenerations_Nbr; i++) {
+			smsGeneration *generation = &prefetch->generations[i];
+			if (generation->valid && generation->region == region) {
+				prefetch->patterns[generation->trigger] = generation->footprint;
+				generation->valid = false;
+			}
+		}
+	}
+}
+
+//=============================================================================
+// TRAINING
+//
+
+//@pre: a block number and a signed distance in blocks
+//@post: the block's address is appended to candidates unless it would fall
+//       below address zero
+//@return: the new candidate count
+static size_t AddCandidate(const prefetcher *prefetch, uint64_t *candidates, size_t count,
+	uint64_t block, int64_t distance){
+	if (distance < 0 && (uint64_t)-distance > block) {
+		return count;
+	}
+	candidates[count] = (block + (uint64_t)distance) << prefetch->blockSize_Exp;
+	return count + 1;
+}
+
+//@brief: Confirm the stride within the access's 4K region
+static size_t TrainStride(prefetcher *prefetch, uint64_t address, uint64_t *candidates){
+	uint64_t block = address >> prefetch->blockSize_Exp;
+	uint64_t region = address >> StrideRegion_Exp;
+	strideEntry *entry = &prefetch->strides[region % StrideTable_Nbr];
+	if (!entry->valid || entry->region != region) {
+		*entry = (strideEntry){.region = region, .last = block, .valid = true};
+		return 0;
+	}
+	int64_t delta = (int64_t)(block - entry->last);
+	if (delta == 0) {
+		return 0;
+	}
+	entry->last = block;
+	if (delta == entry->stride) {
+		if (entry->confidence < StrideConfidence_Max) {
+			entry->confidence++;
+		}
+	}
+	else if (entry->confidence > 0) {
+		entry->confidence--;
+		return 0;
+	}
+	else {
+		entry->stride = delta;
+		return 0;
+	}
+
+	size_t count = 0;
+	if (entry->confidence >= 2) {
+		for (uint32_t k = 1; k <= prefetch->config.degree; k++) {
+			count = AddCandidate(prefetch, candidates, count, block, entry->stride * (int64_t)k);
+		}
+	}
+	return count;
+}
+
+//@brief: Advance the stream the access belongs to, or start a new one
+static size_t TrainStream(prefetcher *prefetch, uint64_t address, uint64_t *candidates){
+	uint64_t block = address >> prefetch->blockSize_Exp;
+	int64_t degree = prefetch->config.degree;
+	streamEntry *oldest = &prefetch->streams[0];
+	for (int i = 0; i < Streams_Nbr; i++) {
+		streamEntry *stream = &prefetch->streams[i];
+		if (!stream->valid) {
+			oldest = stream;
+			continue;
+		}
+		if (oldest->valid && stream->used < oldest->used) {
+			oldest = stream;
+		}
+
+		int64_t ahead = (int64_t)(block - stream->last);
+		if (stream->direction == 0) {
+			// A second miss close by gives the stream its direction
+			if (ahead == 0 || ahead > 2 || ahead < -2) {
+				continue;
+			}
+			stream->direction = ahead > 0 ? 1 : -1;
+			stream->head = block;
+		}
+		else {
+			// Anywhere between the last demand block and one past the
+			// prefetched head keeps the stream going
+			int64_t reach = (int64_t)(stream->head - stream->last) * stream->direction + 1;
+			ahead *= stream->direction;
+			if (ahead < 1 || ahead > reach) {
+				continue;
+			}
+			if ((int64_t)(stream->head - block) * stream->direction < 0) {
+				stream->head = block;
+			}
+		}
+
+		stream->last = block;
+		stream->used = prefetch->clock;
+		size_t count = 0;
+		while ((int64_t)(stream->head - block) * stream->direction < degree) {
+			size_t added = AddCandidate(prefetch, candidates, count, stream->head, stream->direction);
+			if (added == count) {
+				break;
+			}
+			count = added;
+			stream->head += (uint64_t)stream->direction;
+		}
+		return count;
+	}
+	*oldest = (streamEntry){.last = block, .head = block, .used = prefetch->clock, .valid = true};
+	return 0;
+}
+
+//@brief: Record the access in its region's generation, or open a generation
+//        and replay the footprint last seen from the same trigger offset
+static size_t TrainSms(prefetcher *prefetch, uint64_t address, uint64_t *candidates){
+	uint64_t region = address >> prefetch->regionExp;
+	uint32_t offset = (uint32_t)(address >> prefetch->blockSize_Exp)
+		& ((1u << (prefetch->regionExp - prefetch->blockSize_Exp)) - 1);
+	smsGeneration *oldest = &prefetch->generations[0];
+	for (int i = 0; i < SmsGenerations_Nbr; i++) {
+		smsGeneration *generation = &prefetch->generations[i];
+		if (generation->valid && generation->region == region) {
+			generation->footprint |= 1ull << offset;
+			generation->used = prefetch->clock;
+			return 0;
+		}
+		if (!generation->valid || (oldest->valid && generation->used < oldest->used)) {
+			oldest = generation;
+		}
+	}
+
+	if (oldest->valid) {
+		prefetch->patterns[oldest->trigger] = oldest->footprint;
+	}
+	*oldest = (smsGeneration){.region = region, .footprint = 1ull << offset,
+		.used = prefetch->clock, .trigger = offset, .valid = true};
+	size_t count = 0;
+	uint64_t first = region << (prefetch->regionExp - prefetch->blockSize_Exp);
+	for (uint64_t bits = prefetch->patterns[offset] & ~(1ull << offset); bits != 0; bits &= bits - 1) {
+		count = AddCandidate(prefetch, candidates, count, first, __builtin_ctzll(bits));
+	}
+	return count;
+}
+
+//@pre: a demand access to address reached the prefetcher's level; trigger is
+//      set if it missed or was the first hit on a prefetched block
+//@post: the prefetcher's tables have learned from the access
+//@return: the number of block addresses proposed in candidates, which holds
+//         up to PrefetchCandidates_Max
+size_t TrainPrefetcher(prefetcher *prefetch, uint64_t address, bool trigger, uint64_t *candidates){
+	size_t count = 0;
+	switch (prefetch->config.kind) {
+		case PREFETCH_NEXTLINE:
+			if (trigger) {
+				for (uint32_t k = 1; k <= prefetch->config.degree; k++) {
+					count = AddCandidate(prefetch, candidates, count, address >> prefetch->blockSize_Exp, k);
+				}
+			}
+			break;
+		case PREFETCH_STRIDE:
+			count = TrainStride(prefetch, address, candidates);
+			break;
+		case PREFETCH_STREAM:
+			if (trigger) {
+				count = TrainStream(prefetch, address, candidates);
+			}
+			break;
+		case PREFETCH_SMS:
+			count = TrainSms(prefetch, address, candidates);
+			break;
+		default:
+			break;
+	}
+	return count;
+}
@@ -0,0 +1,136 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Hardware prefetcher models attached to a cache level
+//
+//	Description:
+//			A prefetcher watches the demand accesses that reach its level
+//			and proposes blocks, which the hierarchy fetches into the level
+//			from below (without counting hits or misses there):
+//
+//			nextline -- the degree blocks after a miss, or after the first
+//			            use of a prefetched block (tagged prefetching)
+//			stride   -- a table of 4K regions with the last block and stride
+//			            seen in each; two confirmations of a stride prefetch
+//			            degree strides ahead. There are no PCs in a trace, so
+//			            the region stands in for the instruction.
+//			stream   -- stream detectors allocated on misses; once two misses
+//			            give a direction, the stream runs degree blocks ahead
+//			            of the demand accesses. Jouppi's stream buffers, with
+//			            the prefetched blocks placed in the cache itself.
+//			sms      -- spatial memory streaming: the blocks touched in a 2K
+//			            region while it is live (until one of its blocks is
+//			            evicted) are recorded under the offset of the access
+//			            that opened it, and replayed when a new region is
+//			            opened at the same offset.
+//
+//			Every way of the level has a prefetched bit, cleared by the first
+//			demand hit. A prefetch is
+//
+//			useful    -- hit by a demand access before it left the cache
+//			late      -- useful, but hit within latency demand accesses of
+//			             being issued, so the data would still be on its way
+//			unused    -- evicted or invalidated before any demand hit
+//			polluting -- its victim was missed on by a demand access while
+//			             the victim was still recorded in a small filter
+//
+
+#ifndef PREFETCH_H_
+#define PREFETCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+typedef enum {PREFETCH_NONE = 0, PREFETCH_NEXTLINE, PREFETCH_STRIDE, PREFETCH_STREAM, PREFETCH_SMS} prefetchKind;
+
+#define  Default_PrefetchDegree    2
+#define  Default_PrefetchLatency   20
+#define  PrefetchCandidates_Max    64
+
+#define  StrideRegion_Exp          12
+#define  StrideTable_Nbr           256
+#define  StrideConfidence_Max      3
+#define  Streams_Nbr               16
+#define  SmsRegion_Exp             11
+#define  SmsGenerations_Nbr        64
+#define  PollutionFilter_Nbr       4096
+
+typedef struct prefetchConfig
+{
+	prefetchKind kind;
+	uint32_t degree;
+	//demand accesses at the level before a prefetch's data arrives
+	uint32_t latency;
+} prefetchConfig;
+
+typedef struct strideEntry
+{
+	uint64_t region;
+	uint64_t last;
+	int64_t stride;
+	uint32_t confidence;
+	bool valid;
+} strideEntry;
+
+typedef struct streamEntry
+{
+	uint64_t last;
+	uint64_t head;
+	int64_t direction;
+	uint64_t used;
+	bool valid;
+} streamEntry;
+
+typedef struct smsGeneration
+{
+	uint64_t region;
+	uint64_t footprint;
+	uint64_t used;
+	uint32_t trigger;
+	bool valid;
+} smsGeneration;
+
+typedef struct prefetcher
+{
+	prefetchConfig config;
+	uint32_t blockSize_Exp;
+	uint32_t validWords;
+	uint32_t ways;
+	//demand accesses seen at the level
+	uint64_t clock;
+	//per way, with the layout of the level's valid bits, and the clock at
+	//which each prefetched block arrives
+	uint64_t *prefetched;
+	uint64_t *ready;
+	//block numbers + 1 of blocks evicted by prefetches, 0 for none
+	uint64_t *pollution;
+
+	strideEntry *strides;
+	streamEntry *streams;
+	smsGeneration *generations;
+	uint64_t *patterns;
+	uint32_t regionExp;
+
+	uint64_t issued;
+	uint64_t useful;
+	uint64_t late;
+	uint64_t unused;
+	uint64_t polluting;
+} prefetcher;
+
+void DefaultPrefetchConfig(prefetchConfig *config);
+bool ParsePrefetchKind(const char *name, prefetchKind *kind);
+bool ParsePrefetchSpec(prefetchConfig *config, const char *spec);
+const char *PrefetchKindName(prefetchKind kind);
+
+bool buildPrefetcher(prefetcher *prefetch, const prefetchConfig *config, const cacheLevel *cache);
+void destroyPrefetcher(prefetcher *prefetch);
+
+bool NoteDemandHit(prefetcher *prefetch, uint32_t line, uint32_t way);
+void NoteDemandMiss(prefetcher *prefetch, uint64_t address);
+void NoteFill(prefetcher *prefetch, const cacheLevel *cache, uint64_t address, bool prefetched,
+	bool evicted, uint64_t victim);
+size_t TrainPrefetcher(prefetcher *prefetch, uint64_t address, bool trigger, uint64_t *candidates);
+
+#endif /* PREFETCH_H_ */
@@ -0,0 +1,42 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Timing and string quoting shared by the batch runner and the benchmark
+//
+
+#include <time.h>
+
+#include "report.h"
+
+//@return: a monotonic time in seconds
+double Now(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+//@pre: an open output
+//@post: text is written as a JSON string
+//@return: none
+void WriteJsonString(FILE *output, const char *text){
+	fputc('"', output);
+	for (; *text != '\0'; text++) {
+		if (*text == '"' || *text == '\\') {
+			fputc('\\', output);
+		}
+		fputc(*text, output);
+	}
+	fputc('"', output);
+}
+
+//@pre: an open output
+//@post: text is written as a quoted CSV field, with every quote doubled
+//@return: none
+void WriteCsvString(FILE *output, const char *text){
+	fputc('"', output);
+	for (; *text != '\0'; text++) {
+		if (*text == '"') {
+			fputc('"', output);
+		}
+		fputc(*text, output);
+	}
+	fputc('"', output);
+}
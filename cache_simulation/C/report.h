@@ -0,0 +1,19 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Timing and string quoting shared by the batch runner and the benchmark
+//
+//	Description:
+//			The batch runner (-B) and cachebench both time their runs on the
+//			monotonic clock and write their results as JSON, and the batch
+//			runner also as CSV. Strings are quoted here for either format.
+//
+
+#ifndef REPORT_H_
+#define REPORT_H_
+
+#include <stdio.h>
+
+double Now(void);
+void WriteJsonString(FILE *output, const char *text);
+void WriteCsvString(FILE *output, const char *text);
+
+#endif
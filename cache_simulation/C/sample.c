@@ -0,0 +1,240 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Set-sampled approximate simulation with confidence intervals
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "sample.h"
+#include "shard.h"
+
+//97.5% quantiles of Student's t for 1 to 30 degrees of freedom
+static const double StudentT975[30] = {
+	12.7062, 4.3027, 3.1824, 2.7764, 2.5706, 2.4469, 2.3646, 2.3060, 2.2622, 2.2281,
+	2.2010, 2.1788, 2.1604, 2.1448, 2.1314, 2.1199, 2.1098, 2.1009, 2.0930, 2.0860,
+	2.0796, 2.0739, 2.0687, 2.0639, 2.0595, 2.0555, 2.0518, 2.0484, 2.0452, 2.0423
+};
+
+//@pre: df of at least 1
+//@return: the multiplier of the standard error for a 95% interval with df
+//         degrees of freedom; past the table, the Cornish-Fisher expansion
+//         of t about the normal quantile, within 1e-4 of the exact value
+static double IntervalQuantile(uint64_t df){
+	if (df <= 30) {
+		return StudentT975[df - 1];
+	}
+	double z = Sample_Z95;
+	double v = (double)df;
+	return z + (z * z * z + z) / (4.0 * v)
+		+ (5.0 * pow(z, 5) + 16.0 * z * z * z + 3.0 * z) / (96.0 * v * v);
+}
+
+//@return: the next value of a splitmix64 stream
+static inline uint64_t NextRandom64(uint64_t *state){
+	uint64_t value = (*state += 0x9E3779B97F4A7C15ull);
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+//@pre: spec is a fraction such as "0.05" or "1/32", optionally followed by
+//      seed=n
+//@post: *fraction and *seed hold the values of spec
+//@return: false (with a message) if the spec is malformed
+bool ParseSampleSpec(const char *spec, double *fraction, uint64_t *seed){
+	char *end = NULL;
+	*fraction = strtod(spec, &end);
+	if (end != spec && *end == '/') {
+		const char *denominator = end + 1;
+		double divisor = strtod(denominator, &end);
+		*fraction = end != denominator && divisor > 0.0 ? *fraction / divisor : -1.0;
+	}
+	if (*end == ',' && strncasecmp(end + 1, "seed=", 5) == 0) {
+		*seed = strtoull(end + 6, &end, 0);
+	}
+	if (*end != '\0' || !(*fraction > 0.0 && *fraction <= 1.0)) {
+		fprintf(stderr, "The sampled fraction of sets must be in (0, 1], e.g. 1/32: %s\n", spec);
+		return false;
+	}
+	return true;
+}
+
+//@pre: a configured hierarchy whose sets are independent
+//@post: a fraction of the set groups, at least one, is chosen at random
+//@return: false (with a message) if the sets cannot be sampled or memory is short
+bool buildSetSampler(setSampler *sampler, const hierarchyConfig *config, double fraction, uint64_t seed){
+	memset(sampler, 0, sizeof(*sampler));
+	if (!FindSetKey(config, "sampled", &sampler->keyShift, &sampler->keyBits)) {
+		return false;
+	}
+	if (sampler->keyBits == 0 || sampler->keyBits > 30) {
+		fprintf(stderr, "The levels share %u set index bits; sampling needs 1 to 30\n", sampler->keyBits);
+		return false;
+	}
+	sampler->groups = 1ull << sampler->keyBits;
+	sampler->sampledGroups = (uint64_t)llround(fraction * (double)sampler->groups);
+	if (sampler->sampledGroups == 0) {
+		sampler->sampledGroups = 1;
+	}
+
+	// The first sampledGroups entries of a partial Fisher-Yates shuffle
+	uint32_t *order = malloc(sampler->groups * sizeof(uint32_t));
+	sampler->sampled = calloc(sampler->groups, 1);
+	if (order == NULL || sampler->sampled == NULL) {
+		free(order);
+		destroySetSampler(sampler);
+		fprintf(stderr, "Unable to allocate the set sampler\n");
+		return false;
+	}
+	for (uint64_t i = 0; i < sampler->groups; i++) {
+		order[i] = (uint32_t)i;
+	}
+	uint64_t state = seed;
+	for (uint64_t i = 0; i < sampler->sampledGroups; i++) {
+		uint64_t pick = i + NextRandom64(&state) % (sampler->groups - i);
+		uint32_t group = order[pick];
+		order[pick] = order[i];
+		order[i] = group;
+		sampler->sampled[group] = 1;
+	}
+	free(order);
+	return true;
+}
+
+//@pre: a built or zeroed sampler
+//@post: all memory is freed
+//@return: none
+void destroySetSampler(setSampler *sampler){
+	free(sampler->sampled);
+	free(sampler->buffer);
+	memset(sampler, 0, sizeof(*sampler));
+}
+
+//@pre: a built sampler and a batch from NextTraceBatch
+//@post: *kept holds, in order, the items of batch in sampled groups; it stays
+//       valid until the next call
+//@return: false if memory is short
+bool SampleBatch(setSampler *sampler, const traceBatch *batch, traceBatch *kept){
+	size_t itemBytes = batch->records != NULL ? sizeof(traceRecord) : sizeof(uint32_t);
+	if (batch->count * itemBytes > sampler->capacity) {
+		void *grown = realloc(sampler->buffer, batch->count * itemBytes);
+		if (grown == NULL) {
+			return false;
+		}
+		sampler->buffer = grown;
+		sampler->capacity = batch->count * itemBytes;
+	}
+
+	// Every item is copied and the count only advances for sampled ones, so
+	// the loop has no branch on the group
+	const uint8_t *sampled = sampler->sampled;
+	uint32_t shift = sampler->keyShift;
+	uint64_t mask = sampler->groups - 1;
+	size_t count = 0;
+	if (batch->records != NULL) {
+		traceRecord *out = sampler->buffer;
+		for (size_t i = 0; i < batch->count; i++) {
+			out[count] = batch->records[i];
+			count += sampled[(batch->records[i].address >> shift) & mask];
+		}
+		*kept = (traceBatch){ NULL, out, count };
+	}
+	else {
+		uint32_t *out = sampler->buffer;
+		for (size_t i = 0; i < batch->count; i++) {
+			out[count] = batch->addresses[i];
+			count += sampled[(batch->addresses[i] >> shift) & mask];
+		}
+		*kept = (traceBatch){ out, NULL, count };
+	}
+	sampler->seen += batch->count;
+	sampler->kept += count;
+	return true;
+}
+
+//@pre: per-group sums num and den over n groups, a sampling fraction f
+//@post: *ratio is sum(num) / sum(den) and *error the half width of its 95%
+//       interval, from t with n - 1 degrees of freedom; NAN with fewer than
+//       two groups
+//@return: none
+static void RatioEstimate(const double *num, const double *den, uint64_t n, double f,
+	double *ratio, double *error){
+	double numTotal = 0.0;
+	double denTotal = 0.0;
+	for (uint64_t i = 0; i < n; i++) {
+		numTotal += num[i];
+		denTotal += den[i];
+	}
+	*ratio = denTotal > 0.0 ? numTotal / denTotal : 0.0;
+	*error = NAN;
+	if (n < 2 || denTotal <= 0.0) {
+		return;
+	}
+	double spread = 0.0;
+	for (uint64_t i = 0; i < n; i++) {
+		double residual = num[i] - *ratio * den[i];
+		spread += residual * residual;
+	}
+	double meanDen = denTotal / n;
+	double variance = (1.0 - f) * spread / (n - 1) / (n * meanDen * meanDen);
+	*error = IntervalQuantile(n - 1) * sqrt(variance);
+}
+
+//@pre: a sampler and a level of the hierarchy it fed, counting set accesses
+//@post: the accesses and misses of the level's sets are added to the sums of
+//       their groups, at the positions in slot
+//@return: none
+static void SumGroups(const setSampler *sampler, const cacheLevel *cache, const uint64_t *slot,
+	double *accesses, double *misses){
+	uint32_t shift = sampler->keyShift - cache->config.blockSize_Exp;
+	for (uint32_t set = 0; set < cache->config.lines_Nbr; set++) {
+		uint64_t index = slot[(set >> shift) & (sampler->groups - 1)];
+		if (index != UINT64_MAX) {
+			accesses[index] += (double)cache->setStats[set].accesses;
+			misses[index] += (double)cache->setStats[set].misses;
+		}
+	}
+}
+
+//@pre: a sampler and the hierarchy it fed, counting set accesses
+//@post: *estimate holds the level's hit ratio and misses per thousand trace
+//       accesses, with their 95% interval half widths
+//@return: false if memory is short
+bool EstimateLevel(const setSampler *sampler, const cacheHierarchy *hierarchy, int level,
+	sampleEstimate *estimate){
+	uint64_t n = sampler->sampledGroups;
+	double *sums = calloc(5 * n, sizeof(double));
+	uint64_t *slot = malloc(sampler->groups * sizeof(uint64_t));
+	if (sums == NULL || slot == NULL) {
+		free(sums);
+		free(slot);
+		return false;
+	}
+	double *accesses = sums;
+	double *misses = sums + n;
+	double *hits = sums + 2 * n;
+	double *trace = sums + 3 * n;
+	double *traceMisses = sums + 4 * n;
+	for (uint64_t group = 0, next = 0; group < sampler->groups; group++) {
+		slot[group] = sampler->sampled[group] ? next++ : UINT64_MAX;
+	}
+
+	// Every trace access is counted once at the L1
+	SumGroups(sampler, &hierarchy->levels[level], slot, accesses, misses);
+	SumGroups(sampler, &hierarchy->levels[0], slot, trace, traceMisses);
+	for (uint64_t i = 0; i < n; i++) {
+		hits[i] = accesses[i] - misses[i];
+	}
+
+	double f = (double)n / (double)sampler->groups;
+	RatioEstimate(hits, accesses, n, f, &estimate->hitRatio, &estimate->hitRatioError);
+	RatioEstimate(misses, trace, n, f, &estimate->mpka, &estimate->mpkaError);
+	estimate->mpka *= 1000.0;
+	estimate->mpkaError *= 1000.0;
+	free(sums);
+	free(slot);
+	return true;
+}
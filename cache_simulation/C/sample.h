@@ -0,0 +1,67 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Set-sampled approximate simulation with confidence intervals
+//
+//	Description:
+//			Only a random subset of the sets is simulated. A set group is a
+//			value of the address bits that are part of the set index of every
+//			level (the shard key of shard.h), so a group owns whole sets at
+//			each level and its accesses never meet those of another group.
+//			Each batch the reader decodes is filtered with a lookup in a byte
+//			per group before anything is simulated. The whole trace is still
+//			read and decoded.
+//
+//			The hit ratio and the misses per thousand accesses of each level
+//			are ratio estimates over the sampled groups, with a 95% interval
+//			from the spread between groups (cluster sampling, with the finite
+//			population correction) and Student's t for one degree of freedom
+//			fewer than the groups. Below Sample_MinGroups groups the spread
+//			itself is too poorly known for the interval to be trusted.
+//			Per-set counters (CountHierarchySets) give the per-group counts.
+//
+
+#ifndef SAMPLE_H_
+#define SAMPLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hierarchy.h"
+#include "trace.h"
+
+#define  Sample_Z95  1.959964
+#define  Sample_MinGroups  30
+
+typedef struct setSampler
+{
+	uint32_t keyShift;
+	uint32_t keyBits;
+	uint64_t groups;
+	uint64_t sampledGroups;
+	//per group, 1 if it is simulated
+	uint8_t *sampled;
+
+	//the kept items of the last batch
+	void *buffer;
+	size_t capacity;
+	uint64_t seen;
+	uint64_t kept;
+} setSampler;
+
+//Estimate for one level over the whole trace
+typedef struct sampleEstimate
+{
+	double hitRatio;
+	double hitRatioError;
+	double mpka;
+	double mpkaError;
+} sampleEstimate;
+
+bool ParseSampleSpec(const char *spec, double *fraction, uint64_t *seed);
+bool buildSetSampler(setSampler *sampler, const hierarchyConfig *config, double fraction, uint64_t seed);
+void destroySetSampler(setSampler *sampler);
+bool SampleBatch(setSampler *sampler, const traceBatch *batch, traceBatch *kept);
+bool EstimateLevel(const setSampler *sampler, const cacheHierarchy *hierarchy, int level,
+	sampleEstimate *estimate);
+
+#endif /* SAMPLE_H_ */
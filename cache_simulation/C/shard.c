@@ -0,0 +1,317 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Set-sharded multithreaded simulation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shard.h"
+
+//@pre: a configured level
+//@post: [*low, *high) is narrowed to the address bits inside the level's set index
+//@return: none
+static void NarrowKeyRange(const cacheConfig *config, uint32_t *low, uint32_t *high){
+	if (config->blockSize_Exp > *low) {
+		*low = config->blockSize_Exp;
+	}
+	if (config->blockSize_Exp + config->lines_Exp < *high) {
+		*high = config->blockSize_Exp + config->lines_Exp;
+	}
+}
+
+//@pre: a configured hierarchy
+//@post: [*shift, *shift + *bits) are the address bits inside the set index of
+//       every level; addresses that differ there never meet in a set
+//@return: false (with a message saying it cannot be used) if a level keeps
+//         state across sets
+bool FindSetKey(const hierarchyConfig *config, const char *used, uint32_t *shift, uint32_t *bits){
+	uint32_t low = 0;
+	uint32_t high = 64;
+	for (int i = 0; i < config->levelCount; i++) {
+		const cacheConfig *cache = &config->levels[i].cache;
+		if (cache->replacement == BRRIP || cache->replacement == DRRIP) {
+			fprintf(stderr, "L%d: %s shares state between sets and cannot be %s\n",
+				i + 1, ReplacementPolicyName(cache->replacement), used);
+			return false;
+		}
+		if (config->levels[i].prefetch.kind != PREFETCH_NONE) {
+			fprintf(stderr, "L%d: prefetchers cross sets and cannot be %s\n", i + 1, used);
+			return false;
+		}
+		if (config->levels[i].victim.kind != VICTIM_NONE) {
+			fprintf(stderr, "L%d: victim and miss caches cross sets and cannot be %s\n", i + 1, used);
+			return false;
+		}
+		NarrowKeyRange(cache, &low, &high);
+	}
+	*shift = low;
+	*bits = high > low ? high - low : 0;
+	return true;
+}
+
+//@pre: a configured hierarchy and a requested thread count
+//@post: *threads is lowered to the number of set ranges available
+//@return: false (with a message) if the hierarchy cannot be sharded
+bool CheckSharding(const hierarchyConfig *config, int *threads){
+	uint32_t shift = 0;
+	uint32_t bits = 0;
+	if (!FindSetKey(config, "sharded", &shift, &bits)) {
+		return false;
+	}
+
+	uint64_t ranges = 1ull << bits;
+	if (ranges < (uint64_t)*threads) {
+		fprintf(stderr, "Only %llu independent set ranges; using %llu threads\n",
+			(unsigned long long)ranges, (unsigned long long)ranges);
+		*threads = (int)ranges;
+	}
+	return true;
+}
+
+//@pre: an address and a started sim
+//@return: the worker owning the sets the address maps to
+static inline int ShardOf(const shardedSim *sim, uint64_t address){
+	uint64_t key = (address >> sim->keyShift) & ((1ull << sim->keyBits) - 1);
+	return (int)((key * (uint64_t)sim->shardCount) >> sim->keyBits);
+}
+
+//@brief: Worker thread. Runs published buffers through the worker's copy of
+//        the hierarchy until the reader is done.
+static void *ShardWorkerMain(void *argument){
+	shardWorker *worker = argument;
+	pthread_mutex_lock(&worker->lock);
+	for (;;) {
+		while (worker->consumed == worker->published && !worker->done) {
+			pthread_cond_wait(&worker->changed, &worker->lock);
+		}
+		if (worker->consumed == worker->published) {
+			break;
+		}
+		int slot = (int)(worker->consumed % ShardBuffers_Nbr);
+		bool intervalEnd = worker->intervalEnds[slot];
+		pthread_mutex_unlock(&worker->lock);
+
+		traceBatch batch = { NULL, NULL, worker->counts[slot] };
+		if (worker->records) {
+			batch.records = worker->buffers[slot];
+		}
+		else {
+			batch.addresses = worker->buffers[slot];
+		}
+		SimulateHierarchy(&worker->hierarchy, &batch);
+		worker->processed += batch.count;
+		if (worker->intervals.snapshots != NULL) {
+			CountInstructions(&worker->intervals, &batch);
+		}
+		if (intervalEnd && !RecordInterval(&worker->intervals, &worker->hierarchy, worker->processed)) {
+			worker->intervalsLost = true;
+		}
+
+		pthread_mutex_lock(&worker->lock);
+		worker->consumed++;
+		pthread_cond_broadcast(&worker->changed);
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return NULL;
+}
+
+//@pre: workers 0 to prepared - 1 of a sim being started have their locks,
+//      and the first started of them are running with nothing published
+//@post: the running workers are stopped and joined and the memory of every
+//       worker is released
+//@return: none
+static void AbandonShards(shardedSim *sim, int prepared, int started){
+	for (int i = 0; i < started; i++) {
+		shardWorker *worker = &sim->workers[i];
+		pthread_mutex_lock(&worker->lock);
+		worker->done = true;
+		pthread_cond_broadcast(&worker->changed);
+		pthread_mutex_unlock(&worker->lock);
+	}
+	for (int i = 0; i < prepared; i++) {
+		shardWorker *worker = &sim->workers[i];
+		if (i < started) {
+			pthread_join(worker->thread, NULL);
+		}
+		destroyIntervalLog(&worker->intervals);
+		for (int slot = 0; slot < ShardBuffers_Nbr; slot++) {
+			free(worker->buffers[slot]);
+		}
+		pthread_mutex_destroy(&worker->lock);
+		pthread_cond_destroy(&worker->changed);
+	}
+	free(sim->workers);
+	sim->workers = NULL;
+	sim->shardCount = 0;
+}
+
+//@pre: hierarchy is built and passed CheckSharding for threads
+//@post: threads workers are running, each owning a range of sets and taking
+//       records instead of addresses if asked, and keeping its own copy of
+//       intervals if that is not NULL
+//@return: false if the workers could not be started; none are left running
+bool StartShards(shardedSim *sim, cacheHierarchy *hierarchy, int threads, bool records,
+	intervalLog *intervals){
+	memset(sim, 0, sizeof(*sim));
+	sim->hierarchy = hierarchy;
+	sim->intervals = intervals;
+	sim->shardCount = threads;
+	sim->records = records;
+	size_t itemBytes = records ? sizeof(traceRecord) : sizeof(uint32_t);
+	uint32_t low = 0;
+	uint32_t high = 64;
+	for (int level = 0; level < hierarchy->levelCount; level++) {
+		NarrowKeyRange(&hierarchy->levels[level].config, &low, &high);
+	}
+	sim->keyShift = low;
+	sim->keyBits = high > low ? high - low : 0;
+	sim->workers = calloc(threads, sizeof(shardWorker));
+	if (sim->workers == NULL) {
+		return false;
+	}
+
+	for (int i = 0; i < threads; i++) {
+		shardWorker *worker = &sim->workers[i];
+		// Same arrays, private counters
+		worker->hierarchy = *hierarchy;
+		for (int level = 0; level < hierarchy->levelCount; level++) {
+			cacheLevel *cache = &worker->hierarchy.levels[level];
+			cache->hits = cache->misses = cache->fills = cache->evictions = 0;
+			cache->writebacks = cache->writebackBytes = cache->writeThroughBytes = 0;
+			worker->hierarchy.backInvalidations[level] = 0;
+		}
+		worker->records = records;
+		pthread_mutex_init(&worker->lock, NULL);
+		pthread_cond_init(&worker->changed, NULL);
+		bool ready = intervals == NULL || buildIntervalLog(&worker->intervals, intervals->length,
+			hierarchy->levelCount);
+		for (int slot = 0; ready && slot < ShardBuffers_Nbr; slot++) {
+			worker->buffers[slot] = malloc(ShardBuffer_Addresses * itemBytes);
+			ready = worker->buffers[slot] != NULL;
+		}
+		if (!ready || pthread_create(&worker->thread, NULL, ShardWorkerMain, worker) != 0) {
+			AbandonShards(sim, i + 1, i);
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: the reader has filled count addresses into the worker's open buffer
+//@post: the buffer is handed to the worker; waits if the ring is full
+//@return: none
+static void PublishBuffer(shardWorker *worker, size_t count){
+	pthread_mutex_lock(&worker->lock);
+	worker->counts[worker->published % ShardBuffers_Nbr] = count;
+	worker->published++;
+	pthread_cond_broadcast(&worker->changed);
+	while (worker->published - worker->consumed == ShardBuffers_Nbr) {
+		pthread_cond_wait(&worker->changed, &worker->lock);
+	}
+	pthread_mutex_unlock(&worker->lock);
+}
+
+//@pre: started shards
+//@post: the worker's open buffer is handed over if it is full
+//@return: none
+static inline void QueuedItem(shardWorker *worker, size_t *fill){
+	if (++*fill == ShardBuffer_Addresses) {
+		PublishBuffer(worker, *fill);
+		worker->counts[worker->published % ShardBuffers_Nbr] = 0;
+		worker->intervalEnds[worker->published % ShardBuffers_Nbr] = false;
+	}
+}
+
+//@pre: shards started for the kind of trace the batch came from
+//@post: every address or record is queued for the worker owning its set, in order
+//@return: none
+void ShardBatch(shardedSim *sim, const traceBatch *batch){
+	// The open buffer is never visible to the worker until published
+	if (batch->records != NULL) {
+		for (size_t i = 0; i < batch->count; i++) {
+			shardWorker *worker = &sim->workers[ShardOf(sim, batch->records[i].address)];
+			int slot = (int)(worker->published % ShardBuffers_Nbr);
+			traceRecord *buffer = worker->buffers[slot];
+			buffer[worker->counts[slot]] = batch->records[i];
+			QueuedItem(worker, &worker->counts[slot]);
+		}
+		return;
+	}
+	for (size_t i = 0; i < batch->count; i++) {
+		shardWorker *worker = &sim->workers[ShardOf(sim, batch->addresses[i])];
+		int slot = (int)(worker->published % ShardBuffers_Nbr);
+		uint32_t *buffer = worker->buffers[slot];
+		buffer[worker->counts[slot]] = batch->addresses[i];
+		QueuedItem(worker, &worker->counts[slot]);
+	}
+}
+
+//@pre: started shards keeping interval statistics
+//@post: every worker's open buffer, even an empty one, is handed over marked
+//       as the end of an interval
+//@return: none
+void ShardInterval(shardedSim *sim){
+	for (int i = 0; i < sim->shardCount; i++) {
+		shardWorker *worker = &sim->workers[i];
+		int slot = (int)(worker->published % ShardBuffers_Nbr);
+		worker->intervalEnds[slot] = true;
+		PublishBuffer(worker, worker->counts[slot]);
+		slot = (int)(worker->published % ShardBuffers_Nbr);
+		worker->counts[slot] = 0;
+		worker->intervalEnds[slot] = false;
+	}
+}
+
+//@pre: started shards
+//@post: every queued address is simulated, the workers are stopped and
+//       their counters and interval snapshots are added into the shared
+//       hierarchy and log
+//@return: false (with a message) if the interval statistics ran out of memory
+bool FinishShards(shardedSim *sim){
+	cacheHierarchy *hierarchy = sim->hierarchy;
+	for (int i = 0; i < sim->shardCount; i++) {
+		shardWorker *worker = &sim->workers[i];
+		size_t fill = worker->counts[worker->published % ShardBuffers_Nbr];
+		pthread_mutex_lock(&worker->lock);
+		if (fill > 0) {
+			worker->published++;
+		}
+		worker->done = true;
+		pthread_cond_broadcast(&worker->changed);
+		pthread_mutex_unlock(&worker->lock);
+	}
+
+	bool merged = true;
+	for (int i = 0; i < sim->shardCount; i++) {
+		shardWorker *worker = &sim->workers[i];
+		pthread_join(worker->thread, NULL);
+		if (sim->intervals != NULL) {
+			merged = !worker->intervalsLost && MergeIntervals(sim->intervals, &worker->intervals) && merged;
+			destroyIntervalLog(&worker->intervals);
+		}
+		for (int level = 0; level < hierarchy->levelCount; level++) {
+			const cacheLevel *shard = &worker->hierarchy.levels[level];
+			cacheLevel *cache = &hierarchy->levels[level];
+			cache->hits += shard->hits;
+			cache->misses += shard->misses;
+			cache->fills += shard->fills;
+			cache->evictions += shard->evictions;
+			cache->writebacks += shard->writebacks;
+			cache->writebackBytes += shard->writebackBytes;
+			cache->writeThroughBytes += shard->writeThroughBytes;
+			hierarchy->backInvalidations[level] += worker->hierarchy.backInvalidations[level];
+		}
+		for (int slot = 0; slot < ShardBuffers_Nbr; slot++) {
+			free(worker->buffers[slot]);
+		}
+		pthread_mutex_destroy(&worker->lock);
+		pthread_cond_destroy(&worker->changed);
+	}
+	free(sim->workers);
+	sim->workers = NULL;
+	if (!merged) {
+		fprintf(stderr, "Out of memory for the interval statistics\n");
+	}
+	return merged;
+}
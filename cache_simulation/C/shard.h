@@ -0,0 +1,77 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Set-sharded multithreaded simulation of one configuration
+//
+//	Description:
+//			Sets are independent under per-set replacement, so the sets of a
+//			hierarchy are split into contiguous ranges, one per worker thread.
+//			The reading thread routes every address (or record) to the worker
+//			owning its set through a small ring of buffers per worker. Workers
+//			share the tag, valid and policy arrays (each only touches its own
+//			sets) and count hits and misses in their own copy of the level
+//			structs, which are summed when the run finishes.
+//
+//			An address must land on the same worker at every level, so the
+//			shard is taken from the address bits that are part of the set
+//			index of every level. Policies with state shared between sets
+//			(brrip, drrip) and prefetchers cannot be sharded.
+//
+//			Per-set counters live in the shared arrays like the tags. For
+//			interval statistics the reader marks the buffer that ends an
+//			interval in every worker (ShardInterval), and each worker
+//			snapshots its own counters into its own log when it gets there.
+//
+
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include <pthread.h>
+
+#include "hierarchy.h"
+#include "stats.h"
+
+#define  ShardBuffers_Nbr        8
+#define  ShardBuffer_Addresses   ( 1 << 14 )
+
+typedef struct shardWorker
+{
+	pthread_t thread;
+	cacheHierarchy hierarchy;
+
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	//uint32_t addresses, or traceRecords for a record trace
+	void *buffers[ShardBuffers_Nbr];
+	bool records;
+	size_t counts[ShardBuffers_Nbr];
+	//set on the buffers that end an interval
+	bool intervalEnds[ShardBuffers_Nbr];
+	uint64_t published;
+	uint64_t consumed;
+	bool done;
+
+	intervalLog intervals;
+	uint64_t processed;
+	bool intervalsLost;
+} shardWorker;
+
+typedef struct shardedSim
+{
+	cacheHierarchy *hierarchy;
+	int shardCount;
+	uint32_t keyShift;
+	uint32_t keyBits;
+	bool records;
+	shardWorker *workers;
+	//NULL unless interval statistics are kept
+	intervalLog *intervals;
+} shardedSim;
+
+bool FindSetKey(const hierarchyConfig *config, const char *used, uint32_t *shift, uint32_t *bits);
+bool CheckSharding(const hierarchyConfig *config, int *threads);
+bool StartShards(shardedSim *sim, cacheHierarchy *hierarchy, int threads, bool records,
+	intervalLog *intervals);
+void ShardBatch(shardedSim *sim, const traceBatch *batch);
+void ShardInterval(shardedSim *sim);
+bool FinishShards(shardedSim *sim);
+
+#endif /* SHARD_H_ */
@@ -0,0 +1,262 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Mattson stack distance analysis with Fenwick trees
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stackdist.h"
+
+#define  StackInitial_Nbr  64
+#define  MapInitial_Nbr    ( 1 << 16 )
+#define  EmptyKey          UINT64_MAX
+
+//=============================================================================
+// BLOCK MAP
+//
+
+static inline size_t HashBlock(uint64_t block, size_t mask){
+	block ^= block >> 33;
+	block *= 0xff51afd7ed558ccdull;
+	block ^= block >> 33;
+	return (size_t)block & mask;
+}
+
+//@return: the slot holding block, or the empty slot where it belongs
+static inline size_t FindBlockSlot(const stackProfile *profile, uint64_t block){
+	size_t mask = profile->mapCapacity - 1;
+	size_t slot = HashBlock(block, mask);
+	while (profile->keys[slot] != block && profile->keys[slot] != EmptyKey) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+//@post: the map has twice the slots, with every block rehashed
+//@return: false if the larger map could not be allocated
+static bool GrowBlockMap(stackProfile *profile){
+	uint64_t *oldKeys = profile->keys;
+	uint32_t *oldTimes = profile->times;
+	size_t oldCapacity = profile->mapCapacity;
+
+	profile->mapCapacity = oldCapacity ? 2 * oldCapacity : MapInitial_Nbr;
+	profile->keys = malloc(profile->mapCapacity * sizeof(uint64_t));
+	profile->times = malloc(profile->mapCapacity * sizeof(uint32_t));
+	if (profile->keys == NULL || profile->times == NULL) {
+		return false;
+	}
+	memset(profile->keys, 0xff, profile->mapCapacity * sizeof(uint64_t));
+	for (size_t i = 0; i < oldCapacity; i++) {
+		if (oldKeys[i] != EmptyKey) {
+			size_t slot = FindBlockSlot(profile, oldKeys[i]);
+			profile->keys[slot] = oldKeys[i];
+			profile->times[slot] = oldTimes[i];
+		}
+	}
+	free(oldKeys);
+	free(oldTimes);
+	return true;
+}
+
+//=============================================================================
+// FENWICK TREE
+//
+
+static inline void TreeAdd(uint32_t *tree, uint32_t capacity, uint32_t time, int32_t delta){
+	for (uint32_t i = time + 1; i <= capacity; i += i & -i) {
+		tree[i] += (uint32_t)delta;
+	}
+}
+
+//@return: the number of marked times in [0, time]
+static inline uint32_t TreePrefix(const uint32_t *tree, uint32_t time){
+	uint32_t sum = 0;
+	for (uint32_t i = time + 1; i > 0; i -= i & -i) {
+		sum += tree[i];
+	}
+	return sum;
+}
+
+//@pre: the set's clock has reached the end of its tree
+//@post: live times are renumbered 0..live-1 in order, the tree is rebuilt
+//       and has room for at least as many new accesses as live blocks
+//@return: false if the stack could not be grown
+static bool CompactStack(stackProfile *profile, distanceStack *stack){
+	uint32_t rank = 0;
+	for (uint32_t time = 0; time < stack->now; time++) {
+		uint64_t block = stack->owner[time];
+		if (block == EmptyKey) {
+			continue;
+		}
+		stack->owner[rank] = block;
+		profile->times[FindBlockSlot(profile, block)] = rank;
+		rank++;
+	}
+	stack->now = rank;
+
+	uint32_t capacity = stack->capacity ? stack->capacity : StackInitial_Nbr;
+	while (capacity < 2 * rank || capacity < StackInitial_Nbr) {
+		capacity *= 2;
+	}
+	if (capacity != stack->capacity || stack->tree == NULL) {
+		uint32_t *tree = realloc(stack->tree, (capacity + 1) * sizeof(uint32_t));
+		uint64_t *owner = realloc(stack->owner, capacity * sizeof(uint64_t));
+		if (tree != NULL) {
+			stack->tree = tree;
+		}
+		if (owner != NULL) {
+			stack->owner = owner;
+		}
+		if (tree == NULL || owner == NULL) {
+			return false;
+		}
+		stack->capacity = capacity;
+	}
+
+	// Linear-time build of a tree with a 1 at every time below rank
+	memset(stack->tree, 0, (stack->capacity + 1) * sizeof(uint32_t));
+	for (uint32_t i = 1; i <= stack->capacity; i++) {
+		stack->tree[i] += i <= rank;
+		uint32_t parent = i + (i & -i);
+		if (parent <= stack->capacity) {
+			stack->tree[parent] += stack->tree[i];
+		}
+	}
+	for (uint32_t time = rank; time < stack->capacity; time++) {
+		stack->owner[time] = EmptyKey;
+	}
+	return true;
+}
+
+//=============================================================================
+// PROFILE
+//
+
+//@pre: lines is a power of two (1 for fully associative)
+//@post: an empty profile for caches of that many sets and block size
+//@return: false if the profile could not be allocated
+bool buildStackProfile(stackProfile *profile, uint32_t lines, uint32_t blockSize_Exp){
+	memset(profile, 0, sizeof(*profile));
+	profile->blockSize_Exp = blockSize_Exp;
+	profile->lines_Exp = __builtin_ctz(lines);
+	profile->stacks = calloc(lines, sizeof(distanceStack));
+	profile->histogramLength = StackInitial_Nbr;
+	profile->histogram = calloc(profile->histogramLength, sizeof(uint64_t));
+	if (profile->stacks == NULL || profile->histogram == NULL || !GrowBlockMap(profile)) {
+		destroyStackProfile(profile);
+		return false;
+	}
+	return true;
+}
+
+//@pre: profile was built by buildStackProfile
+//@post: all memory held by the profile is released
+//@return: none
+void destroyStackProfile(stackProfile *profile){
+	if (profile->stacks != NULL) {
+		for (uint32_t i = 0; i < (1u << profile->lines_Exp); i++) {
+			free(profile->stacks[i].tree);
+			free(profile->stacks[i].owner);
+		}
+	}
+	free(profile->stacks);
+	free(profile->keys);
+	free(profile->times);
+	free(profile->histogram);
+	memset(profile, 0, sizeof(*profile));
+}
+
+//@pre: a built profile
+//@post: the access is added to the distance histogram
+//@return: false if the profile ran out of memory
+static bool ProfileAccess(stackProfile *profile, uint64_t address){
+	uint64_t block = address >> profile->blockSize_Exp;
+	distanceStack *stack = &profile->stacks[block & ((1u << profile->lines_Exp) - 1)];
+	if (stack->now == stack->capacity && !CompactStack(profile, stack)) {
+		return false;
+	}
+
+	size_t slot = FindBlockSlot(profile, block);
+	if (profile->keys[slot] == block) {
+		uint32_t last = profile->times[slot];
+		uint32_t distance = TreePrefix(stack->tree, stack->now - 1) - TreePrefix(stack->tree, last);
+		if (distance >= profile->histogramLength) {
+			size_t length = profile->histogramLength;
+			while (length <= distance) {
+				length *= 2;
+			}
+			uint64_t *histogram = realloc(profile->histogram, length * sizeof(uint64_t));
+			if (histogram == NULL) {
+				return false;
+			}
+			memset(histogram + profile->histogramLength, 0,
+				(length - profile->histogramLength) * sizeof(uint64_t));
+			profile->histogram = histogram;
+			profile->histogramLength = length;
+		}
+		profile->histogram[distance]++;
+		TreeAdd(stack->tree, stack->capacity, last, -1);
+		stack->owner[last] = EmptyKey;
+		stack->live--;
+	}
+	else {
+		profile->coldMisses++;
+		profile->keys[slot] = block;
+		if (++profile->mapCount * 2 > profile->mapCapacity) {
+			if (!GrowBlockMap(profile)) {
+				return false;
+			}
+			slot = FindBlockSlot(profile, block);
+		}
+	}
+
+	profile->times[slot] = stack->now;
+	stack->owner[stack->now] = block;
+	TreeAdd(stack->tree, stack->capacity, stack->now, 1);
+	stack->now++;
+	stack->live++;
+	profile->accesses++;
+	return true;
+}
+
+//@pre: a built profile
+//@post: every address of the batch is added to the distance histogram
+//@return: false (with a message) if memory ran out
+//@brief: Loads and stores of a record trace are profiled alike
+bool ProfileBatch(stackProfile *profile, const traceBatch *batch){
+	for (size_t i = 0; i < batch->count; i++) {
+		uint64_t address = batch->records != NULL ? batch->records[i].address : batch->addresses[i];
+		if (!ProfileAccess(profile, address)) {
+			fprintf(stderr, "Out of memory in the stack distance profile\n");
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: a built profile
+//@post: the LRU miss ratio curve is written to out as CSV
+//@return: none
+//@brief: The curve is a step function of the ways per set. A row is written
+//        for 1 way and for every way count where the curve steps; past the
+//        last row only cold misses are left.
+void ReportMissRatioCurve(const stackProfile *profile, FILE *out){
+	size_t last = profile->histogramLength;
+	while (last > 0 && profile->histogram[last - 1] == 0) {
+		last--;
+	}
+
+	uint64_t misses = profile->accesses;
+	uint64_t setBytes = 1ull << (profile->lines_Exp + profile->blockSize_Exp);
+	fprintf(out, "ways,capacity_bytes,misses,miss_ratio\n");
+	for (size_t ways = 1; ways <= (last > 0 ? last : 1); ways++) {
+		uint64_t hits = ways <= last ? profile->histogram[ways - 1] : 0;
+		misses -= hits;
+		if (ways == 1 || hits != 0) {
+			fprintf(out, "%zu,%llu,%llu,%.6f\n", ways, (unsigned long long)(ways * setBytes),
+				(unsigned long long)misses,
+				profile->accesses ? (double)misses / profile->accesses : 0.0);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: One-pass LRU stack distance profiling
+//
+//	Description:
+//			The stack distance of an access is the number of distinct blocks
+//			touched in the same set since the last access to its block. An LRU
+//			cache with w ways per set hits exactly the accesses with distance
+//			below w, so one histogram of distances gives the miss ratio of
+//			every capacity with the same number of sets and block size.
+//
+//			Every set keeps a Fenwick tree over its own access times with a 1
+//			at the latest access of each block, so a distance is the sum of
+//			the tree between two times: O(log n) per access. When a set's
+//			clock reaches the end of its tree the live times are renumbered
+//			from zero and the tree is rebuilt, so memory stays proportional to
+//			the number of distinct blocks rather than the trace length.
+//
+
+#ifndef STACKDIST_H_
+#define STACKDIST_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+//Access times of one set
+typedef struct distanceStack
+{
+	uint32_t *tree;
+	uint64_t *owner;
+	uint32_t capacity;
+	uint32_t now;
+	uint32_t live;
+} distanceStack;
+
+typedef struct stackProfile
+{
+	uint32_t blockSize_Exp;
+	uint32_t lines_Exp;
+	distanceStack *stacks;
+
+	//last access time of every block seen, open addressing
+	uint64_t *keys;
+	uint32_t *times;
+	size_t mapCapacity;
+	size_t mapCount;
+
+	//histogram[d] counts accesses with stack distance d
+	uint64_t *histogram;
+	size_t histogramLength;
+	uint64_t coldMisses;
+	uint64_t accesses;
+} stackProfile;
+
+bool buildStackProfile(stackProfile *profile, uint32_t lines, uint32_t blockSize_Exp);
+void destroyStackProfile(stackProfile *profile);
+
+bool ProfileBatch(stackProfile *profile, const traceBatch *batch);
+void ReportMissRatioCurve(const stackProfile *profile, FILE *out);
+
+#endif /* STACKDIST_H_ */
@@ -0,0 +1,244 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Interval statistics and per-set access histograms
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+//@return: the words of one snapshot of a log
+static inline size_t SnapshotWords(const intervalLog *log){
+	return 2 + 2 * (size_t)log->levelCount;
+}
+
+//=============================================================================
+// INTERVALS
+//
+
+//@pre: a zeroed log, a length of at least 1
+//@post: the log is empty and takes a snapshot every length accesses
+//@return: false if memory is short
+bool buildIntervalLog(intervalLog *log, uint64_t length, int levelCount){
+	memset(log, 0, sizeof(*log));
+	log->length = length;
+	log->levelCount = levelCount;
+	log->capacity = IntervalLog_InitialNbr;
+	log->snapshots = malloc(log->capacity * SnapshotWords(log) * sizeof(uint64_t));
+	return log->snapshots != NULL;
+}
+
+//@pre: a built or zeroed log
+//@post: all memory is freed
+//@return: none
+void destroyIntervalLog(intervalLog *log){
+	free(log->snapshots);
+	memset(log, 0, sizeof(*log));
+}
+
+//@pre: a log
+//@post: the CSV header of the interval rows is written
+//@return: none
+static void WriteIntervalHeader(const intervalLog *log, FILE *output){
+	fprintf(output, log->records ? "interval,accesses,instructions" : "interval,accesses");
+	for (int level = 1; level <= log->levelCount; level++) {
+		fprintf(output, ",L%d_hits,L%d_misses,L%d_hit_ratio,L%d_mpka", level, level, level, level);
+		if (log->records) {
+			fprintf(output, ",L%d_mpki", level);
+		}
+	}
+	fprintf(output, "\n");
+}
+
+//@pre: a log of cumulative snapshots, i one of them
+//@post: the CSV row of snapshot i is written, with each level's hits, misses,
+//       hit ratio and misses per thousand accesses of the trace in that
+//       interval, and per thousand instructions for a record trace
+//@return: none
+static void WriteIntervalRow(const intervalLog *log, size_t i, FILE *output){
+	size_t words = SnapshotWords(log);
+	const uint64_t *now = log->snapshots + i * words;
+	const uint64_t *before = i > 0 ? now - words : NULL;
+	uint64_t accesses = now[0] - (before != NULL ? before[0] : 0);
+	uint64_t instructions = now[1] - (before != NULL ? before[1] : 0);
+	fprintf(output, "%zu,%llu", log->first + i, (unsigned long long)accesses);
+	if (log->records) {
+		fprintf(output, ",%llu", (unsigned long long)instructions);
+	}
+	for (int level = 0; level < log->levelCount; level++) {
+		uint64_t hits = now[2 + 2 * level] - (before != NULL ? before[2 + 2 * level] : 0);
+		uint64_t misses = now[3 + 2 * level] - (before != NULL ? before[3 + 2 * level] : 0);
+		fprintf(output, ",%llu,%llu,%.6f,%.3f", (unsigned long long)hits, (unsigned long long)misses,
+			hits + misses ? (double)hits / (hits + misses) : 0.0,
+			accesses ? 1000.0 * misses / accesses : 0.0);
+		if (log->records) {
+			fprintf(output, ",%.3f", instructions ? 1000.0 * misses / instructions : 0.0);
+		}
+	}
+	fprintf(output, "\n");
+}
+
+//@pre: a built log
+//@post: the instructions of the records of batch, gap + 1 each, are added to
+//       the log's count; raw addresses add none
+//@return: none
+void CountInstructions(intervalLog *log, const traceBatch *batch){
+	if (batch->records == NULL) {
+		return;
+	}
+	uint64_t instructions = batch->count;
+	for (size_t i = 0; i < batch->count; i++) {
+		instructions += batch->records[i].gap;
+	}
+	log->instructions += instructions;
+}
+
+//@pre: a built log and a batch with offset items already taken
+//@post: the items of the returned chunk are counted toward the interval
+//@return: the items from offset up to the next interval boundary or the end
+//         of the batch; *boundary is set if the chunk ends an interval
+traceBatch NextIntervalChunk(intervalLog *log, const traceBatch *batch, size_t offset, bool *boundary){
+	size_t count = batch->count - offset;
+	if (count > log->length - log->pending) {
+		count = (size_t)(log->length - log->pending);
+	}
+	traceBatch chunk = {
+		batch->addresses != NULL ? batch->addresses + offset : NULL,
+		batch->records != NULL ? batch->records + offset : NULL,
+		count
+	};
+	CountInstructions(log, &chunk);
+	log->pending += count;
+	*boundary = log->pending == log->length;
+	if (*boundary) {
+		log->pending = 0;
+	}
+	return chunk;
+}
+
+//@pre: a built log
+//@post: a snapshot of accesses, the instructions counted so far and the
+//       hierarchy's hit and miss counters is appended, and written out if the
+//       log is streamed
+//@return: false if memory is short
+bool RecordInterval(intervalLog *log, const cacheHierarchy *hierarchy, uint64_t accesses){
+	size_t words = SnapshotWords(log);
+	if (log->count == log->capacity) {
+		uint64_t *grown = realloc(log->snapshots, 2 * log->capacity * words * sizeof(uint64_t));
+		if (grown == NULL) {
+			return false;
+		}
+		log->snapshots = grown;
+		log->capacity *= 2;
+	}
+	uint64_t *snapshot = log->snapshots + log->count * words;
+	snapshot[0] = accesses;
+	snapshot[1] = log->instructions;
+	for (int i = 0; i < log->levelCount; i++) {
+		snapshot[2 + 2 * i] = hierarchy->levels[i].hits;
+		snapshot[3 + 2 * i] = hierarchy->levels[i].misses;
+	}
+	log->count++;
+
+	// A streamed log only needs the snapshot before the next interval
+	if (log->live != NULL) {
+		WriteIntervalRow(log, log->count - 1, log->live);
+		fflush(log->live);
+		if (log->count == 2) {
+			memcpy(log->snapshots, snapshot, words * sizeof(uint64_t));
+			log->count = 1;
+			log->first++;
+		}
+	}
+	return true;
+}
+
+//@pre: two logs of the same hierarchy, part taken over a subset of the sets
+//@post: the snapshots of part are added into those of log; intervals log does
+//       not have yet are appended
+//@return: false if memory is short
+bool MergeIntervals(intervalLog *log, const intervalLog *part){
+	size_t words = SnapshotWords(log);
+	if (part->count > log->capacity) {
+		uint64_t *grown = realloc(log->snapshots, part->count * words * sizeof(uint64_t));
+		if (grown == NULL) {
+			return false;
+		}
+		log->snapshots = grown;
+		log->capacity = part->count;
+	}
+	if (part->count > log->count) {
+		memset(log->snapshots + log->count * words, 0, (part->count - log->count) * words * sizeof(uint64_t));
+		log->count = part->count;
+	}
+	for (size_t i = 0; i < part->count * words; i++) {
+		log->snapshots[i] += part->snapshots[i];
+	}
+	return true;
+}
+
+//@pre: a log of cumulative snapshots
+//@post: one CSV row per interval, with each level's hits, misses, hit ratio
+//       and misses per thousand accesses (and instructions) in that interval
+//@return: none
+void WriteIntervals(const intervalLog *log, FILE *output){
+	WriteIntervalHeader(log, output);
+	for (size_t i = 0; i < log->count; i++) {
+		WriteIntervalRow(log, i, output);
+	}
+}
+
+//@pre: an empty log
+//@post: the CSV header is written to output, and from now on every interval
+//       is written and flushed there as it is recorded
+//@return: none
+void StreamIntervals(intervalLog *log, FILE *output){
+	log->live = output;
+	WriteIntervalHeader(log, output);
+	fflush(output);
+}
+
+//=============================================================================
+// SET HISTOGRAMS
+//
+
+//@pre: a hierarchy counting set accesses (CountHierarchySets)
+//@post: path holds the accesses and misses of every set, as CSV rows of
+//       level, set, accesses, misses or in the binary layout of stats.h
+//@return: false (with a message) if the file cannot be written
+bool WriteSetStats(const cacheHierarchy *hierarchy, const char *path, bool binary){
+	FILE *file = fopen(path, binary ? "wb" : "w");
+	if (file == NULL) {
+		perror(path);
+		return false;
+	}
+	bool written = true;
+	if (binary) {
+		uint32_t levels = (uint32_t)hierarchy->levelCount;
+		written = fwrite(SetStatsMagic, 8, 1, file) == 1 && fwrite(&levels, sizeof(levels), 1, file) == 1;
+		for (int i = 0; written && i < hierarchy->levelCount; i++) {
+			written = fwrite(&hierarchy->levels[i].config.lines_Nbr, sizeof(uint32_t), 1, file) == 1;
+		}
+		for (int i = 0; written && i < hierarchy->levelCount; i++) {
+			const cacheLevel *cache = &hierarchy->levels[i];
+			written = fwrite(cache->setStats, sizeof(setStat), cache->config.lines_Nbr, file)
+				== cache->config.lines_Nbr;
+		}
+	}
+	else {
+		fprintf(file, "level,set,accesses,misses\n");
+		for (int i = 0; i < hierarchy->levelCount; i++) {
+			const cacheLevel *cache = &hierarchy->levels[i];
+			for (uint32_t set = 0; set < cache->config.lines_Nbr; set++) {
+				fprintf(file, "%d,%u,%llu,%llu\n", i + 1, set,
+					(unsigned long long)cache->setStats[set].accesses,
+					(unsigned long long)cache->setStats[set].misses);
+			}
+		}
+	}
+	if (fclose(file) != 0 || !written) {
+		perror(path);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,73 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Interval statistics and per-set access histograms
+//
+//	Description:
+//			An interval log takes a snapshot of the running counters of a
+//			hierarchy every length accesses of the trace: the accesses and
+//			instructions so far and the hits and misses of every level. The
+//			reader splits trace batches at interval boundaries
+//			(NextIntervalChunk), so the simulation loops themselves are
+//			untouched. A record counts as its gap + 1 instructions, and the
+//			rows of a record trace give misses per thousand instructions as
+//			well as per thousand accesses. Raw traces carry no instruction
+//			counts, so their rows give only the latter. A sharded run keeps
+//			one log per worker, snapshotted when the worker reaches the
+//			boundary in its own stream, and the logs are summed at the end.
+//			A streamed log (StreamIntervals) writes every interval as soon as
+//			it is recorded and keeps only the last snapshot, so a live trace
+//			can run for as long as its input lasts.
+//
+//			Per-set histograms count the demand accesses and misses of every
+//			set of every level (CountHierarchySets). They are written
+//			as CSV, or as a binary file: SetStatsMagic, the 32-bit level count,
+//			the 32-bit set count of each level, then for each level and set
+//			the 64-bit accesses and misses. All words are little-endian.
+//
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hierarchy.h"
+#include "trace.h"
+
+#define  SetStatsMagic            "CSSETS01"
+#define  IntervalLog_InitialNbr   64
+
+typedef struct intervalLog
+{
+	uint64_t length;
+	int levelCount;
+	//accesses since the last boundary, as seen by the reader
+	uint64_t pending;
+	//set if the trace is of records, so the rows report instructions
+	bool records;
+	//instructions of the items counted so far
+	uint64_t instructions;
+	//per interval, the cumulative accesses, instructions, then hits and
+	//misses of each level
+	uint64_t *snapshots;
+	size_t count;
+	size_t capacity;
+	//number of the interval in the first snapshot kept
+	size_t first;
+	//NULL unless every interval is written here as it is recorded
+	FILE *live;
+} intervalLog;
+
+bool buildIntervalLog(intervalLog *log, uint64_t length, int levelCount);
+void destroyIntervalLog(intervalLog *log);
+void CountInstructions(intervalLog *log, const traceBatch *batch);
+traceBatch NextIntervalChunk(intervalLog *log, const traceBatch *batch, size_t offset, bool *boundary);
+bool RecordInterval(intervalLog *log, const cacheHierarchy *hierarchy, uint64_t accesses);
+bool MergeIntervals(intervalLog *log, const intervalLog *part);
+void StreamIntervals(intervalLog *log, FILE *output);
+void WriteIntervals(const intervalLog *log, FILE *output);
+
+bool WriteSetStats(const cacheHierarchy *hierarchy, const char *path, bool binary);
+
+#endif /* STATS_H_ */
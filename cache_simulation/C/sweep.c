@@ -0,0 +1,175 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Single-pass multi-configuration simulation
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sweep.h"
+
+//@pre: none
+//@post: sweep holds no configurations
+//@return: none
+void initSweep(cacheSweep *sweep){
+	memset(sweep, 0, sizeof(*sweep));
+}
+
+//@pre: a configuration that has been through ConfigureHierarchy and the spec
+//      it is reported as
+//@post: the configuration is appended to the sweep
+//@return: false (with a message) if memory is short
+bool AddSweepConfig(cacheSweep *sweep, const char *spec, const hierarchyConfig *config){
+	if (sweep->count == sweep->capacity) {
+		int capacity = sweep->capacity ? 2 * sweep->capacity : 16;
+		char **specs = realloc(sweep->specs, capacity * sizeof(char *));
+		if (specs != NULL) {
+			sweep->specs = specs;
+		}
+		hierarchyConfig *configs = realloc(sweep->configs, capacity * sizeof(hierarchyConfig));
+		if (configs != NULL) {
+			sweep->configs = configs;
+		}
+		if (specs == NULL || configs == NULL) {
+			fprintf(stderr, "Out of memory for configurations\n");
+			return false;
+		}
+		sweep->capacity = capacity;
+	}
+	sweep->configs[sweep->count] = *config;
+	sweep->specs[sweep->count++] = strdup(spec);
+	return true;
+}
+
+//@pre: spec describes a hierarchy, levels separated by ';'
+//@post: the configuration is appended to the sweep
+//@return: false (with a message) if spec is not a valid hierarchy
+bool AddSweepSpec(cacheSweep *sweep, const char *spec){
+	hierarchyConfig config;
+	if (!ParseHierarchySpec(&config, spec) || !ConfigureHierarchy(&config)) {
+		fprintf(stderr, "(in configuration \"%s\")\n", spec);
+		return false;
+	}
+	return AddSweepConfig(sweep, spec, &config);
+}
+
+//@pre: path names a file with one configuration per line; '#' starts a comment
+//@post: every configuration in the file is appended to the sweep
+//@return: false if the file cannot be read or holds a bad configuration
+bool LoadSweepFile(cacheSweep *sweep, const char *path){
+	FILE *file = fopen(path, "r");
+	if (file == NULL) {
+		perror(path);
+		return false;
+	}
+
+	char text[1024];
+	bool ok = true;
+	while (ok && fgets(text, sizeof(text), file) != NULL) {
+		text[strcspn(text, "#\r\n")] = '\0';
+		char *start = text + strspn(text, " \t");
+		size_t length = strlen(start);
+		while (length > 0 && (start[length - 1] == ' ' || start[length - 1] == '\t')) {
+			start[--length] = '\0';
+		}
+		if (length > 0) {
+			ok = AddSweepSpec(sweep, start);
+		}
+	}
+	fclose(file);
+	return ok;
+}
+
+//@pre: every configuration was added with AddSweepSpec
+//@post: a hierarchy is built for every configuration
+//@return: false if any hierarchy could not be allocated
+bool buildSweep(cacheSweep *sweep){
+	sweep->hierarchies = calloc(sweep->count, sizeof(cacheHierarchy));
+	if (sweep->hierarchies == NULL) {
+		return false;
+	}
+	for (int i = 0; i < sweep->count; i++) {
+		if (!buildHierarchy(&sweep->hierarchies[i], &sweep->configs[i])) {
+			fprintf(stderr, "Unable to allocate configuration \"%s\"\n", sweep->specs[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: sweep was set up by initSweep
+//@post: all configurations and hierarchies are released
+//@return: none
+void destroySweep(cacheSweep *sweep){
+	for (int i = 0; i < sweep->count; i++) {
+		if (sweep->hierarchies != NULL) {
+			destroyHierarchy(&sweep->hierarchies[i]);
+		}
+		free(sweep->specs[i]);
+	}
+	free(sweep->hierarchies);
+	free(sweep->specs);
+	free(sweep->configs);
+	initSweep(sweep);
+}
+
+//@pre: a built sweep
+//@post: the batch has been run through every configuration
+//@return: none
+void SimulateSweep(cacheSweep *sweep, const traceBatch *batch){
+	for (int i = 0; i < sweep->count; i++) {
+		SimulateHierarchy(&sweep->hierarchies[i], batch);
+	}
+}
+
+//@pre: an open output
+//@post: the CSV columns of a configuration with up to levels levels are
+//       written, without a line end
+//@return: none
+void WriteSweepColumns(FILE *out, int levels){
+	fprintf(out, "config,accesses");
+	for (int level = 1; level <= levels; level++) {
+		fprintf(out, ",L%d_hits,L%d_misses,L%d_hit_ratio,L%d_writeback_bytes,L%d_writethrough_bytes"
+			",L%d_prefetches,L%d_prefetch_useful", level, level, level, level, level, level, level);
+	}
+}
+
+//@pre: a hierarchy of at most levels levels that has simulated a trace
+//@post: its CSV row under WriteSweepColumns is written, without a line end
+//@return: none
+void WriteSweepRow(FILE *out, const char *spec, const cacheHierarchy *hierarchy, int levels){
+	const cacheLevel *l1 = &hierarchy->levels[0];
+	fprintf(out, "\"%s\",%llu", spec, (unsigned long long)(l1->hits + l1->misses));
+	for (int level = 0; level < levels; level++) {
+		if (level >= hierarchy->levelCount) {
+			fprintf(out, ",,,,,,,");
+			continue;
+		}
+		const cacheLevel *cache = &hierarchy->levels[level];
+		uint64_t accesses = cache->hits + cache->misses;
+		fprintf(out, ",%llu,%llu,%.6f,%llu,%llu", (unsigned long long)cache->hits,
+			(unsigned long long)cache->misses, accesses ? (double)cache->hits / accesses : 0.0,
+			(unsigned long long)cache->writebackBytes, (unsigned long long)cache->writeThroughBytes);
+		fprintf(out, ",%llu,%llu", (unsigned long long)hierarchy->prefetchers[level].issued,
+			(unsigned long long)hierarchy->prefetchers[level].useful);
+	}
+}
+
+//@pre: a built sweep
+//@post: one CSV row per configuration is written to out
+//@return: none
+void ReportSweep(const cacheSweep *sweep, FILE *out){
+	int levels = 1;
+	for (int i = 0; i < sweep->count; i++) {
+		if (sweep->hierarchies[i].levelCount > levels) {
+			levels = sweep->hierarchies[i].levelCount;
+		}
+	}
+
+	WriteSweepColumns(out, levels);
+	fprintf(out, "\n");
+	for (int i = 0; i < sweep->count; i++) {
+		WriteSweepRow(out, sweep->specs[i], &sweep->hierarchies[i], levels);
+		fprintf(out, "\n");
+	}
+}
@@ -0,0 +1,42 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Several cache configurations simulated over one pass of a trace
+//
+//	Description:
+//			Each configuration is a full hierarchy given as one line such as
+//
+//			    size=32K,ways=8 ; size=256K,ways=8,inclusion=nine
+//
+//			where ';' separates levels. Every batch read from the trace is run
+//			through every configuration before the next batch is read, so the
+//			trace is read and decoded once however many configurations there are.
+//
+
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include <stdio.h>
+
+#include "hierarchy.h"
+
+typedef struct cacheSweep
+{
+	int count;
+	int capacity;
+	char **specs;
+	hierarchyConfig *configs;
+	cacheHierarchy *hierarchies;
+} cacheSweep;
+
+void initSweep(cacheSweep *sweep);
+bool AddSweepConfig(cacheSweep *sweep, const char *spec, const hierarchyConfig *config);
+bool AddSweepSpec(cacheSweep *sweep, const char *spec);
+bool LoadSweepFile(cacheSweep *sweep, const char *path);
+bool buildSweep(cacheSweep *sweep);
+void destroySweep(cacheSweep *sweep);
+
+void SimulateSweep(cacheSweep *sweep, const traceBatch *batch);
+void WriteSweepColumns(FILE *out, int levels);
+void WriteSweepRow(FILE *out, const char *spec, const cacheHierarchy *hierarchy, int levels);
+void ReportSweep(const cacheSweep *sweep, FILE *out);
+
+#endif /* SWEEP_H_ */
@@ -0,0 +1,273 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Issue, MSHR and window timing of the accesses of a hierarchy
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "timing.h"
+
+//=============================================================================
+// CONFIGURATION
+//
+
+//@pre: none
+//@post: config holds the default core
+//@return: none
+void DefaultTimingConfig(timingConfig *config){
+	memset(config, 0, sizeof(*config));
+	config->issueWidth = Default_IssueWidth;
+	config->window = Default_Window;
+	config->mshrs = Default_Mshrs;
+	config->gap = Default_AccessGap;
+	config->latencies[0] = 4;
+	config->latencies[1] = 14;
+	config->latencies[2] = 40;
+	config->latencies[3] = 60;
+	config->memoryLatency = Default_MemoryCycles;
+}
+
+//@pre: key and value of one timing option
+//@post: config holds the option
+//@return: false if the key is unknown or the value malformed
+static bool SetTimingOption(timingConfig *config, const char *key, const char *value){
+	if (strcasecmp(key, "mshrs") == 0) {
+		return ParseCount(value, 1, Mshrs_Max, &config->mshrs);
+	}
+	if (strcasecmp(key, "width") == 0) {
+		return ParseCount(value, 1, 64, &config->issueWidth);
+	}
+	if (strcasecmp(key, "window") == 0) {
+		return ParseCount(value, 1, 1u << 20, &config->window);
+	}
+	if (strcasecmp(key, "gap") == 0) {
+		return ParseCount(value, 0, UINT32_MAX, &config->gap);
+	}
+	if (strcasecmp(key, "latency") == 0) {
+		return ParseNumberList(value, config->latencies, MaxLevels_Nbr);
+	}
+	if (strcasecmp(key, "memory_latency") == 0) {
+		return ParseCount(value, 0, UINT32_MAX, &config->memoryLatency);
+	}
+	return false;
+}
+
+//@pre: spec is an optional MSHR count followed by key=value options, e.g.
+//      "16,window=192,latency=4:12:36"
+//@post: config holds the options of spec
+//@return: false (with a message) if an option is unknown or malformed
+bool ParseTimingSpec(timingConfig *config, const char *spec){
+	char *copy = strdup(spec);
+	char *saveptr = NULL;
+	bool ok = true;
+	for (char *item = strtok_r(copy, ", \t", &saveptr); ok && item != NULL;
+		item = strtok_r(NULL, ", \t", &saveptr)) {
+		char *value = strchr(item, '=');
+		if (value == NULL) {
+			ok = item == copy && (strcasecmp(item, "default") == 0
+				|| ParseCount(item, 1, Mshrs_Max, &config->mshrs));
+		}
+		else {
+			*value++ = '\0';
+			ok = SetTimingOption(config, item, value);
+		}
+		if (!ok) {
+			fprintf(stderr, "Bad timing option: %s%s%s\n", item, value != NULL ? "=" : "",
+				value != NULL ? value : "");
+		}
+	}
+	free(copy);
+	return ok;
+}
+
+//=============================================================================
+// BUILD
+//
+
+//@pre: a configuration from ParseTimingSpec and the configured L1
+//@post: the core is idle at cycle 0 with every MSHR free
+//@return: false (with a message) if memory is short
+bool buildTimingModel(timingModel *timing, const timingConfig *config, const cacheConfig *l1){
+	memset(timing, 0, sizeof(*timing));
+	timing->config = *config;
+	timing->blockSize_Exp = l1->blockSize_Exp;
+	timing->mshrs = calloc(config->mshrs, sizeof(mshrEntry));
+	// Every load in the window is a distinct instruction
+	timing->loads = malloc(((size_t)config->window + 1) * sizeof(windowEntry));
+	if (timing->mshrs == NULL || timing->loads == NULL) {
+		fprintf(stderr, "Unable to allocate the timing model\n");
+		destroyTimingModel(timing);
+		return false;
+	}
+	return true;
+}
+
+//@pre: a built or zeroed model
+//@post: all memory is freed
+//@return: none
+void destroyTimingModel(timingModel *timing){
+	free(timing->mshrs);
+	free(timing->loads);
+	timing->mshrs = NULL;
+	timing->loads = NULL;
+}
+
+//=============================================================================
+// TIMING
+//
+
+//@pre: a built model
+//@post: issue has moved on to cycle, if that is later
+//@return: the cycles issue stalled
+static inline uint64_t StallUntil(timingModel *timing, uint64_t cycle){
+	if (cycle <= timing->clock) {
+		return 0;
+	}
+	uint64_t stalled = cycle - timing->clock;
+	timing->clock = cycle;
+	timing->slot = 0;
+	return stalled;
+}
+
+//@pre: a built model and the window position of the next instruction
+//@post: the completed loads at the head of the window have retired, and issue
+//       has waited for those more than a window older
+//@return: none
+static void RetireLoads(timingModel *timing, uint64_t position){
+	uint32_t capacity = timing->config.window + 1;
+	while (timing->loadCount > 0) {
+		const windowEntry *oldest = &timing->loads[timing->loadHead];
+		if (oldest->ready > timing->clock) {
+			if (oldest->position + timing->config.window > position) {
+				return;
+			}
+			timing->windowStallCycles += StallUntil(timing, oldest->ready);
+		}
+		timing->loadHead = timing->loadHead + 1 == capacity ? 0 : timing->loadHead + 1;
+		timing->loadCount--;
+	}
+}
+
+//@pre: a built model
+//@return: the MSHR still fetching block, or NULL
+static mshrEntry *FindMshr(timingModel *timing, uint64_t block){
+	if (timing->clock >= timing->mshrsBusyUntil) {
+		return NULL;
+	}
+	for (uint32_t i = 0; i < timing->config.mshrs; i++) {
+		if (timing->mshrs[i].block == block && timing->mshrs[i].ready > timing->clock) {
+			return &timing->mshrs[i];
+		}
+	}
+	return NULL;
+}
+
+//@pre: a built model
+//@post: issue has stalled until an MSHR is free, if none was
+//@return: a free MSHR
+static mshrEntry *TakeMshr(timingModel *timing){
+	mshrEntry *first = &timing->mshrs[0];
+	for (uint32_t i = 0; i < timing->config.mshrs; i++) {
+		if (timing->mshrs[i].ready <= timing->clock) {
+			return &timing->mshrs[i];
+		}
+		if (timing->mshrs[i].ready < first->ready) {
+			first = &timing->mshrs[i];
+		}
+	}
+	timing->mshrStallCycles += StallUntil(timing, first->ready);
+	return first;
+}
+
+//@pre: a built model and hierarchy; gap instructions ran since the last access
+//@post: the access has run through the hierarchy, issued after its gap, the
+//       window and a free MSHR if it missed, and is timed to its completion
+//@return: none
+void TimeAccess(timingModel *timing, cacheHierarchy *hierarchy, uint64_t address, accessType type,
+	uint32_t size, uint32_t gap){
+	const timingConfig *config = &timing->config;
+	uint64_t issued = (uint64_t)timing->slot + gap;
+	timing->clock += issued / config->issueWidth;
+	timing->slot = (uint32_t)(issued % config->issueWidth);
+	timing->instructions += (uint64_t)gap + 1;
+	RetireLoads(timing, timing->instructions);
+
+	int served = type == ACCESS_STORE ? StoreHierarchy(hierarchy, address, size)
+		: AccessHierarchy(hierarchy, address);
+
+	uint64_t start = timing->clock;
+	uint64_t latency = served < hierarchy->levelCount ? config->latencies[served] : config->memoryLatency;
+	uint64_t block = address >> timing->blockSize_Exp;
+	uint64_t ready;
+	mshrEntry *inflight = FindMshr(timing, block);
+	if (inflight != NULL) {
+		timing->mergedMisses++;
+		ready = inflight->ready > start + config->latencies[0] ? inflight->ready : start + config->latencies[0];
+	}
+	else if (served == 0 || (type == ACCESS_STORE && !hierarchy->levels[0].config.writeAllocate)) {
+		ready = start + latency;
+	}
+	else {
+		mshrEntry *mshr = TakeMshr(timing);
+		ready = timing->clock + latency;
+		mshr->block = block;
+		mshr->ready = ready;
+		timing->primaryMisses++;
+		timing->missCycles += latency;
+		// Misses start in issue order, so the busy cycles are a running union
+		if (timing->clock >= timing->mshrsBusyUntil) {
+			timing->missBusyCycles += latency;
+		}
+		else if (ready > timing->mshrsBusyUntil) {
+			timing->missBusyCycles += ready - timing->mshrsBusyUntil;
+		}
+		if (ready > timing->mshrsBusyUntil) {
+			timing->mshrsBusyUntil = ready;
+		}
+	}
+
+	timing->accesses++;
+	timing->served[served]++;
+	timing->accessCycles += ready - start;
+	if (ready > timing->finish) {
+		timing->finish = ready;
+	}
+	if (type != ACCESS_STORE) {
+		uint32_t tail = timing->loadHead + timing->loadCount;
+		if (tail > config->window) {
+			tail -= config->window + 1;
+		}
+		timing->loads[tail] = (windowEntry){ timing->instructions, ready };
+		timing->loadCount++;
+	}
+	if (++timing->slot == config->issueWidth) {
+		timing->clock++;
+		timing->slot = 0;
+	}
+}
+
+//@pre: a built model and hierarchy and a batch from NextTraceBatch
+//@post: every address or record is run through the hierarchy and timed, in
+//       order; raw addresses are loads after the configured gap
+//@return: none
+void SimulateTimed(timingModel *timing, cacheHierarchy *hierarchy, const traceBatch *batch){
+	if (batch->records == NULL) {
+		for (size_t i = 0; i < batch->count; i++) {
+			TimeAccess(timing, hierarchy, batch->addresses[i], ACCESS_LOAD, 0, timing->config.gap);
+		}
+		return;
+	}
+	for (size_t i = 0; i < batch->count; i++) {
+		const traceRecord *record = &batch->records[i];
+		TimeAccess(timing, hierarchy, record->address, (accessType)record->type, record->size, record->gap);
+	}
+}
+
+//@pre: a built model
+//@return: the cycles until the last access issued so far has completed
+uint64_t TimedCycles(const timingModel *timing){
+	uint64_t issued = timing->clock + (timing->slot > 0);
+	return issued > timing->finish ? issued : timing->finish;
+}
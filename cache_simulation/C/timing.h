@@ -0,0 +1,125 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Access timing on top of the cache hierarchy
+//
+//	Description:
+//			The cache arrays only say which level served an access. The
+//			timing model turns that into cycles with a simple out-of-order
+//			core in front of the L1:
+//
+//			issue   -- instructions issue width per cycle. Each access is
+//			           one instruction after the gap of its trace record
+//			           (the configured gap for raw traces).
+//			latency -- an access served by level n completes the load
+//			           latency of that level after it issues, or the memory
+//			           latency after it if it came from memory.
+//			MSHRs   -- every L1 miss holds a miss status holding register
+//			           until its block arrives. A later access to a block
+//			           in flight merges into its MSHR and completes with it.
+//			           A miss that finds every MSHR busy stalls issue until
+//			           the first one frees.
+//			window  -- an instruction cannot issue until the loads more
+//			           than window instructions older have completed, as in
+//			           a reorder buffer. Stores retire into a store buffer
+//			           and never hold the window.
+//
+//			Prefetches and write backs are not timed, and a level serves
+//			any number of misses at once. The model reports the average
+//			memory access time (issue to completion, over all accesses),
+//			the memory-level parallelism (the mean number of primary misses
+//			in flight over the cycles with at least one) and the cycles
+//			issue stalled on the MSHRs and on the window.
+//
+
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hierarchy.h"
+#include "trace.h"
+
+//
+//	Default core: a recent x86 core and its load-to-use latencies
+//
+#define  Default_IssueWidth     4
+#define  Default_Window         224
+#define  Default_Mshrs          12
+#define  Default_AccessGap      2
+#define  Default_MemoryCycles   200
+#define  Mshrs_Max              256
+
+typedef struct timingConfig
+{
+	uint32_t issueWidth;
+	//instructions in flight behind the oldest incomplete load
+	uint32_t window;
+	uint32_t mshrs;
+	//instructions before each access of a raw trace
+	uint32_t gap;
+	//load latency of each cache level, and of memory
+	uint32_t latencies[MaxLevels_Nbr];
+	uint32_t memoryLatency;
+} timingConfig;
+
+//One outstanding L1 miss
+typedef struct mshrEntry
+{
+	uint64_t block;
+	uint64_t ready;
+} mshrEntry;
+
+//One load in the window
+typedef struct windowEntry
+{
+	uint64_t position;
+	uint64_t ready;
+} windowEntry;
+
+typedef struct timingModel
+{
+	timingConfig config;
+	uint32_t blockSize_Exp;
+
+	//cycle the next instruction issues in, and the instructions already
+	//issued in it
+	uint64_t clock;
+	uint32_t slot;
+	//the cycle the last MSHR frees
+	uint64_t mshrsBusyUntil;
+	mshrEntry *mshrs;
+	//ring of the loads in the window, oldest first
+	windowEntry *loads;
+	uint32_t loadHead;
+	uint32_t loadCount;
+
+	uint64_t instructions;
+	uint64_t accesses;
+	//cycles from issue to completion, summed over every access
+	uint64_t accessCycles;
+	//accesses by the level that served them; levelCount for memory
+	uint64_t served[MaxLevels_Nbr + 1];
+	uint64_t primaryMisses;
+	uint64_t mergedMisses;
+	//latencies of the primary misses, and the cycles with any in flight
+	uint64_t missCycles;
+	uint64_t missBusyCycles;
+	uint64_t mshrStallCycles;
+	uint64_t windowStallCycles;
+	//the cycle the last access completes
+	uint64_t finish;
+} timingModel;
+
+void DefaultTimingConfig(timingConfig *config);
+bool ParseTimingSpec(timingConfig *config, const char *spec);
+
+bool buildTimingModel(timingModel *timing, const timingConfig *config, const cacheConfig *l1);
+void destroyTimingModel(timingModel *timing);
+
+void TimeAccess(timingModel *timing, cacheHierarchy *hierarchy, uint64_t address, accessType type,
+	uint32_t size, uint32_t gap);
+void SimulateTimed(timingModel *timing, cacheHierarchy *hierarchy, const traceBatch *batch);
+uint64_t TimedCycles(const timingModel *timing);
+
+#endif /* TIMING_H_ */
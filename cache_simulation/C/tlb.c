@@ -0,0 +1,397 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: TLB lookups, page walks and their configuration
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "tlb.h"
+
+static const char *const PageSizeNames[] = {"4K", "2M", "1G"};
+static const uint32_t PageSize_Exp[] = {12, 21, 30};
+static const char *const TlbLevelNames[] = {"dtlb", "stlb"};
+
+//Page table level holding the leaf entry of each page size
+static const int LeafLevel[] = {3, 2, 1};
+
+//Bits of the virtual address above the entries of each level's tables
+#define  TableShift(level)  ( 48 - 9 * (level) )
+//Bits of the virtual address below the entry of a level
+#define  EntryShift(level)  ( 39 - 9 * (level) )
+
+//@return: a well mixed hash of value
+static inline uint64_t MixBits(uint64_t value){
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+//=============================================================================
+// CONFIGURATION
+//
+
+//@pre: none
+//@post: config holds the TLBs of a recent x86 core with 4K pages only
+//@return: none
+void DefaultTlbConfig(tlbConfig *config){
+	memset(config, 0, sizeof(*config));
+	config->arrays[0][PAGE_4K] = (tlbArrayConfig){64, 4};
+	config->arrays[0][PAGE_2M] = (tlbArrayConfig){32, 4};
+	config->arrays[0][PAGE_1G] = (tlbArrayConfig){4, 4};
+	config->arrays[1][PAGE_4K] = (tlbArrayConfig){2048, 16};
+	config->arrays[1][PAGE_2M] = (tlbArrayConfig){1024, 8};
+	config->arrays[1][PAGE_1G] = (tlbArrayConfig){16, 4};
+	config->walkCaches[0] = 2;
+	config->walkCaches[1] = 4;
+	config->walkCaches[2] = 32;
+	config->hugePage = PAGE_4K;
+	config->hugeFraction = 1.0;
+	config->stlbLatency = Default_StlbLatency;
+	config->latencies[0] = 4;
+	config->latencies[1] = 14;
+	config->latencies[2] = 40;
+	config->latencies[3] = 60;
+	config->memoryLatency = Default_MemoryLatency;
+}
+
+//@pre: text such as "4k" or "2M"
+//@post: *size holds the page size it names
+//@return: false if it is not a supported page size
+static bool ParsePageSize(const char *text, pageSize *size){
+	uint64_t bytes = 0;
+	if (!ParseSize(text, &bytes)) {
+		return false;
+	}
+	for (int i = 0; i < PageSizes_Nbr; i++) {
+		if (bytes == 1ull << PageSize_Exp[i]) {
+			*size = (pageSize)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//@pre: text such as "64:4"
+//@post: *array holds the entries and ways; "0" removes the array
+//@return: false unless entries and ways are powers of two, ways at most
+//         entries
+static bool ParseTlbArray(const char *text, tlbArrayConfig *array){
+	char *end = NULL;
+	unsigned long entries = strtoul(text, &end, 10);
+	if (end != text && *end == '\0' && entries == 0) {
+		array->entries = 0;
+		return true;
+	}
+	unsigned long ways = *end == ':' ? strtoul(end + 1, &end, 10) : 0;
+	if (*end != '\0' || ways == 0 || ways > entries || entries > (1ul << 20)
+		|| (entries & (entries - 1)) != 0 || (ways & (ways - 1)) != 0) {
+		return false;
+	}
+	array->entries = (uint32_t)entries;
+	array->ways = (uint32_t)ways;
+	return true;
+}
+
+//@pre: key and value of one TLB option
+//@post: config holds the option
+//@return: false if the key is unknown or the value malformed
+static bool SetTlbOption(tlbConfig *config, const char *key, const char *value){
+	char *end = NULL;
+	if (strcasecmp(key, "page") == 0) {
+		return ParsePageSize(value, &config->hugePage);
+	}
+	if (strcasecmp(key, "huge") == 0) {
+		config->hugeFraction = strtod(value, &end);
+		return end != value && *end == '\0' && config->hugeFraction >= 0.0 && config->hugeFraction <= 1.0;
+	}
+	for (int level = 0; level < TlbLevels_Nbr; level++) {
+		size_t length = strlen(TlbLevelNames[level]);
+		pageSize size;
+		if (strncasecmp(key, TlbLevelNames[level], length) == 0 && key[length] == '_'
+			&& ParsePageSize(key + length + 1, &size)) {
+			return ParseTlbArray(value, &config->arrays[level][size]);
+		}
+	}
+	if (strcasecmp(key, "pwc") == 0) {
+		return ParseNumberList(value, config->walkCaches, WalkCaches_Nbr);
+	}
+	if (strcasecmp(key, "latency") == 0) {
+		return ParseNumberList(value, config->latencies, MaxLevels_Nbr);
+	}
+	if (strcasecmp(key, "stlb_latency") == 0) {
+		config->stlbLatency = (uint32_t)strtoul(value, &end, 10);
+		return end != value && *end == '\0';
+	}
+	if (strcasecmp(key, "memory_latency") == 0) {
+		config->memoryLatency = (uint32_t)strtoul(value, &end, 10);
+		return end != value && *end == '\0';
+	}
+	if (strcasecmp(key, "tables") == 0) {
+		return ParseSize(value, &config->tableBase);
+	}
+	if (strcasecmp(key, "seed") == 0) {
+		config->seed = strtoull(value, &end, 0);
+		return end != value && *end == '\0';
+	}
+	return false;
+}
+
+//@pre: spec is an optional page size followed by key=value options, e.g.
+//      "2m,huge=0.5,dtlb_4k=64:4"
+//@post: config holds the options of spec
+//@return: false (with a message) if the spec is malformed
+bool ParseTlbSpec(tlbConfig *config, const char *spec){
+	char *copy = strdup(spec);
+	char *saveptr = NULL;
+	bool ok = true;
+	for (char *item = strtok_r(copy, ", \t", &saveptr); ok && item != NULL;
+		item = strtok_r(NULL, ", \t", &saveptr)) {
+		char *value = strchr(item, '=');
+		if (value == NULL) {
+			ok = item == copy && ParsePageSize(item, &config->hugePage);
+		}
+		else {
+			*value++ = '\0';
+			ok = SetTlbOption(config, item, value);
+		}
+		if (!ok) {
+			fprintf(stderr, "Bad TLB option: %s%s%s\n", item, value != NULL ? "=" : "",
+				value != NULL ? value : "");
+		}
+	}
+	free(copy);
+	return ok;
+}
+
+//@pre: a valid page size
+//@return: its name
+const char *PageSizeName(pageSize size){
+	return PageSizeNames[size];
+}
+
+//=============================================================================
+// BUILD
+//
+
+//@pre: a zeroed cache; entries and ways are powers of two, ways at most entries
+//@post: the cache is an LRU array of entries translations of 2^blockExp bytes,
+//       with tags wide enough for the address bits above its set index
+//@return: false if memory is short
+static bool buildTlbArray(cacheLevel *cache, uint32_t entries, uint32_t ways, uint32_t blockExp){
+	cacheConfig config;
+	DefaultCacheConfig(&config);
+	uint32_t linesExp = (uint32_t)__builtin_ctz(entries / ways);
+	config.cacheSize_Exp = (uint32_t)__builtin_ctz(entries) + blockExp;
+	config.associativity = ways;
+	config.blockSize_Exp = blockExp;
+	config.replacement = LRU;
+	config.addressSize_Exp = blockExp + linesExp + 32 < 64 ? blockExp + linesExp + 32 : 64;
+	if ((entries & (entries - 1)) != 0 || (ways & (ways - 1)) != 0 || !ConfigureCache(&config)) {
+		return false;
+	}
+	return buildCache(cache, &config);
+}
+
+//@pre: a configuration from ParseTlbSpec and the configured L1
+//@post: every TLB array and paging-structure cache is empty, and the page
+//       tables are placed from the configured base
+//@return: false (with a message) if an array cannot be built
+bool buildTlb(tlbSystem *tlb, const tlbConfig *config, const cacheConfig *l1){
+	memset(tlb, 0, sizeof(*tlb));
+	tlb->config = *config;
+	tlb->tableBase = config->tableBase != 0 ? config->tableBase : 3ull << (l1->addressSize_Exp - 2);
+	for (int level = 0; level < TlbLevels_Nbr; level++) {
+		for (int size = 0; size < PageSizes_Nbr; size++) {
+			const tlbArrayConfig *array = &config->arrays[level][size];
+			if (array->entries > 0
+				&& !buildTlbArray(&tlb->arrays[level][size], array->entries, array->ways, PageSize_Exp[size])) {
+				fprintf(stderr, "Unable to build the %s %s array\n", TlbLevelNames[level], PageSizeNames[size]);
+				destroyTlb(tlb);
+				return false;
+			}
+		}
+	}
+	for (int level = 0; level < WalkCaches_Nbr; level++) {
+		uint32_t entries = config->walkCaches[level];
+		if (entries > 0 && !buildTlbArray(&tlb->walkCaches[level], entries, entries, EntryShift(level))) {
+			fprintf(stderr, "Paging-structure caches need a power of two entries\n");
+			destroyTlb(tlb);
+			return false;
+		}
+	}
+	tlb->tableBits = TableMap_InitialBits;
+	tlb->tables = calloc((size_t)1 << tlb->tableBits, sizeof(tableSlot));
+	if (tlb->tables == NULL) {
+		destroyTlb(tlb);
+		return false;
+	}
+	return true;
+}
+
+//@pre: a built or zeroed TLB
+//@post: all memory is freed
+//@return: none
+void destroyTlb(tlbSystem *tlb){
+	for (int level = 0; level < TlbLevels_Nbr; level++) {
+		for (int size = 0; size < PageSizes_Nbr; size++) {
+			destroyCache(&tlb->arrays[level][size]);
+		}
+	}
+	for (int level = 0; level < WalkCaches_Nbr; level++) {
+		destroyCache(&tlb->walkCaches[level]);
+	}
+	free(tlb->tables);
+	tlb->tables = NULL;
+}
+
+//=============================================================================
+// TRANSLATION
+//
+
+//@return: true if the cache was built (the array exists)
+static inline bool HasArray(const cacheLevel *cache){
+	return cache->tags != NULL;
+}
+
+//@return: the page size backing address
+static pageSize PageSizeOf(const tlbSystem *tlb, uint64_t address){
+	pageSize huge = tlb->config.hugePage;
+	if (huge == PAGE_4K || tlb->config.hugeFraction >= 1.0) {
+		return huge;
+	}
+	uint64_t region = address >> PageSize_Exp[huge];
+	double draw = (double)(MixBits(region ^ tlb->config.seed) >> 11) / (double)(1ull << 53);
+	return draw < tlb->config.hugeFraction ? huge : PAGE_4K;
+}
+
+//@pre: a built TLB
+//@post: the table at level covering prefix has a frame, allocated on first use
+//@return: the physical address of its first entry
+static uint64_t TableAddress(tlbSystem *tlb, int level, uint64_t prefix){
+	uint64_t key = (((uint64_t)level << 56) | prefix) + 1;
+	size_t mask = ((size_t)1 << tlb->tableBits) - 1;
+	size_t slot = (size_t)(MixBits(key) & mask);
+	while (tlb->tables[slot].key != key && tlb->tables[slot].key != 0) {
+		slot = (slot + 1) & mask;
+	}
+	if (tlb->tables[slot].key == key) {
+		return tlb->tableBase + (tlb->tables[slot].frame << TableFrame_Exp);
+	}
+
+	uint64_t frame = tlb->tableCount++;
+	tlb->tables[slot] = (tableSlot){key, frame};
+	if (tlb->tableCount * 2 > mask + 1) {
+		tableSlot *grown = calloc((mask + 1) * 2, sizeof(tableSlot));
+		if (grown != NULL) {
+			size_t grownMask = mask * 2 + 1;
+			for (size_t i = 0; i <= mask; i++) {
+				if (tlb->tables[i].key != 0) {
+					size_t home = (size_t)(MixBits(tlb->tables[i].key) & grownMask);
+					while (grown[home].key != 0) {
+						home = (home + 1) & grownMask;
+					}
+					grown[home] = tlb->tables[i];
+				}
+			}
+			free(tlb->tables);
+			tlb->tables = grown;
+			tlb->tableBits++;
+		}
+	}
+	return tlb->tableBase + (frame << TableFrame_Exp);
+}
+
+//@pre: a built TLB and hierarchy; a translation of address missed both TLB levels
+//@post: the entries of the walk not held by the paging-structure caches are
+//       loaded through the hierarchy, and the caches filled
+//@return: the cycles spent on the loads
+static uint64_t WalkPageTable(tlbSystem *tlb, cacheHierarchy *hierarchy, uint64_t address, pageSize size){
+	int leaf = LeafLevel[size];
+	int start = 0;
+	for (int level = leaf - 1; level >= 0; level--) {
+		if (HasArray(&tlb->walkCaches[level]) && LookupCache(&tlb->walkCaches[level], address)) {
+			tlb->walkCacheHits[level]++;
+			start = level + 1;
+			break;
+		}
+	}
+
+	uint64_t cycles = 0;
+	uint64_t victim = 0;
+	bool victimDirty = false;
+	for (int level = start; level <= leaf; level++) {
+		uint64_t table = TableAddress(tlb, level, address >> TableShift(level));
+		uint64_t entry = table + ((address >> EntryShift(level)) & 511) * TableEntry_Bytes;
+		int served = AccessHierarchy(hierarchy, entry);
+		tlb->walkLoads++;
+		tlb->walkLoadsServed[served]++;
+		cycles += served < hierarchy->levelCount ? tlb->config.latencies[served] : tlb->config.memoryLatency;
+		if (level < leaf && HasArray(&tlb->walkCaches[level])) {
+			FillCache(&tlb->walkCaches[level], address, false, &victim, &victimDirty);
+		}
+	}
+	return cycles;
+}
+
+//@pre: a built TLB and hierarchy
+//@post: address is translated: looked up in the dTLB, then the STLB, then
+//       walked, with the levels that missed filled; walk loads have run
+//       through the hierarchy and the cycles spent are counted
+//@return: none
+void TranslateAddress(tlbSystem *tlb, cacheHierarchy *hierarchy, uint64_t address){
+	pageSize size = PageSizeOf(tlb, address);
+	tlb->accesses[size]++;
+	int level = 0;
+	for (; level < TlbLevels_Nbr; level++) {
+		cacheLevel *array = &tlb->arrays[level][size];
+		if (!HasArray(array)) {
+			continue;
+		}
+		if (LookupCache(array, address)) {
+			array->hits++;
+			break;
+		}
+		array->misses++;
+	}
+	if (level > 0 && HasArray(&tlb->arrays[1][size])) {
+		tlb->cycles += tlb->config.stlbLatency;
+	}
+	if (level == TlbLevels_Nbr) {
+		tlb->walks[size]++;
+		tlb->cycles += WalkPageTable(tlb, hierarchy, address, size);
+	}
+
+	uint64_t victim = 0;
+	bool victimDirty = false;
+	for (int fill = level - 1; fill >= 0; fill--) {
+		if (HasArray(&tlb->arrays[fill][size])) {
+			FillCache(&tlb->arrays[fill][size], address, false, &victim, &victimDirty);
+		}
+	}
+}
+
+//@pre: a built TLB and hierarchy and a batch from NextTraceBatch
+//@post: every address or record is translated and then run through the
+//       hierarchy, in order
+//@return: none
+void SimulateTranslated(tlbSystem *tlb, cacheHierarchy *hierarchy, const traceBatch *batch){
+	if (batch->records == NULL) {
+		for (size_t i = 0; i < batch->count; i++) {
+			TranslateAddress(tlb, hierarchy, batch->addresses[i]);
+			AccessHierarchy(hierarchy, batch->addresses[i]);
+		}
+		return;
+	}
+	for (size_t i = 0; i < batch->count; i++) {
+		const traceRecord *record = &batch->records[i];
+		TranslateAddress(tlb, hierarchy, record->address);
+		if (record->type == ACCESS_STORE) {
+			StoreHierarchy(hierarchy, record->address, record->size);
+		}
+		else {
+			AccessHierarchy(hierarchy, record->address);
+		}
+	}
+}
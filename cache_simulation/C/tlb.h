@@ -0,0 +1,126 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: TLBs and x86-64 page walks in front of the cache hierarchy
+//
+//	Description:
+//			With a TLB the trace holds virtual addresses. Every access is
+//			translated before it reaches the caches:
+//
+//			dTLB  -- the first level, looked up first
+//			STLB  -- the second level, looked up on a dTLB miss; a hit fills
+//			         the dTLB
+//			walk  -- on an STLB miss the four-level page table is walked and
+//			         the translation filled into both levels
+//
+//			Each level has one set-associative array per page size (4K, 2M,
+//			1G), as the L1 dTLBs of current cores do; an array with no
+//			entries does not exist and lookups of its page size go to the
+//			next level. A shared STLB is modeled as separate arrays. The page
+//			size of an address is 4K, or the huge page size for a fraction of
+//			the huge-page regions chosen by a hash of the region number.
+//
+//			A walk loads one 8 byte entry per level from PML4 down to the
+//			leaf (PT for 4K pages, PD for 2M, PDPT for 1G). The loads go
+//			through the simulated cache hierarchy, counted as ordinary loads,
+//			so walks compete with the data for the caches. Paging-structure
+//			caches of PML4, PDPT and PD entries skip the upper levels of a
+//			walk. Page tables are placed frame by frame, in the order they are
+//			first touched, from a base address at three quarters of the L1's
+//			address space; data addresses are used as physical addresses
+//			unchanged.
+//
+//			Translation cost is counted in cycles: the STLB latency on a
+//			dTLB miss, plus the latency of the level that served each walk
+//			load.
+//
+
+#ifndef TLB_H_
+#define TLB_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "hierarchy.h"
+#include "trace.h"
+
+typedef enum {PAGE_4K = 0, PAGE_2M, PAGE_1G} pageSize;
+
+#define  PageSizes_Nbr        3
+#define  TlbLevels_Nbr        2
+//page table levels, PML4 to PT, and the paging-structure caches of the three
+//upper ones
+#define  WalkLevels_Nbr       4
+#define  WalkCaches_Nbr       3
+#define  TableEntry_Bytes     8
+#define  TableFrame_Exp       12
+#define  TableMap_InitialBits 10
+
+//
+//	Default geometry: the dTLB and STLB of a recent x86 core
+//
+#define  Default_StlbLatency     7
+#define  Default_MemoryLatency   200
+
+//Entries and ways of one TLB array; no entries for no array
+typedef struct tlbArrayConfig
+{
+	uint32_t entries;
+	uint32_t ways;
+} tlbArrayConfig;
+
+typedef struct tlbConfig
+{
+	tlbArrayConfig arrays[TlbLevels_Nbr][PageSizes_Nbr];
+	//entries of the PML4E, PDPTE and PDE caches
+	uint32_t walkCaches[WalkCaches_Nbr];
+	pageSize hugePage;
+	double hugeFraction;
+	uint64_t seed;
+	//0 for three quarters of the L1's address space
+	uint64_t tableBase;
+	uint32_t stlbLatency;
+	//load latency of each cache level, and of memory
+	uint32_t latencies[MaxLevels_Nbr];
+	uint32_t memoryLatency;
+} tlbConfig;
+
+//Frame of one page table: level and the address bits above it, + 1 (0 for
+//an empty slot)
+typedef struct tableSlot
+{
+	uint64_t key;
+	uint64_t frame;
+} tableSlot;
+
+typedef struct tlbSystem
+{
+	tlbConfig config;
+	cacheLevel arrays[TlbLevels_Nbr][PageSizes_Nbr];
+	cacheLevel walkCaches[WalkCaches_Nbr];
+	uint64_t tableBase;
+
+	tableSlot *tables;
+	uint32_t tableBits;
+	uint64_t tableCount;
+
+	uint64_t accesses[PageSizes_Nbr];
+	uint64_t walks[PageSizes_Nbr];
+	uint64_t walkCacheHits[WalkCaches_Nbr];
+	uint64_t walkLoads;
+	//walk loads by the level that served them; levelCount for memory
+	uint64_t walkLoadsServed[MaxLevels_Nbr + 1];
+	uint64_t cycles;
+} tlbSystem;
+
+void DefaultTlbConfig(tlbConfig *config);
+bool ParseTlbSpec(tlbConfig *config, const char *spec);
+const char *PageSizeName(pageSize size);
+
+bool buildTlb(tlbSystem *tlb, const tlbConfig *config, const cacheConfig *l1);
+void destroyTlb(tlbSystem *tlb);
+
+void TranslateAddress(tlbSystem *tlb, cacheHierarchy *hierarchy, uint64_t address);
+void SimulateTranslated(tlbSystem *tlb, cacheHierarchy *hierarchy, const traceBatch *batch);
+
+#endif /* TLB_H_ */
@@ -0,0 +1,383 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Memory mapped and streaming trace readers
+//
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "generator.h"
+#include "tracepack.h"
+#include "lzblock.h"
+
+#define  TraceAddress_Bytes  sizeof(uint32_t)
+#define  StreamBuffer_Bytes  ( TraceBatch_Nbr * sizeof(traceRecord) )
+#define  PipeRing_Bytes      ( 1 << 20 )
+
+_Static_assert(sizeof(traceRecord) == 16, "traceRecord must match the file layout");
+
+//@pre: trace->fd is a regular, non-empty file of the given length
+//@post: the whole file is mapped read-only and advised for sequential access
+//@return: false if the file could not be mapped
+static bool MapTrace(traceReader *trace, size_t length){
+	void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, trace->fd, 0);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+	madvise(map, length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	if (trace->flags & TRACE_HUGEPAGES) {
+		madvise(map, length, MADV_HUGEPAGE);
+	}
+#endif
+	trace->map = map;
+	trace->mapLength = length;
+	trace->mapOffset = 0;
+	return true;
+}
+
+//@pre: trace->fd cannot be mapped
+//@post: trace has a buffer for the streaming reader
+//@return: false if the buffer could not be allocated
+static bool BufferTrace(traceReader *trace){
+	void *buffer = mmap(NULL, StreamBuffer_Bytes, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED) {
+		return false;
+	}
+#ifdef MADV_HUGEPAGE
+	if (trace->flags & TRACE_HUGEPAGES) {
+		madvise(buffer, StreamBuffer_Bytes, MADV_HUGEPAGE);
+	}
+#endif
+	trace->buffer = buffer;
+	trace->bufferLength = StreamBuffer_Bytes;
+	trace->bufferFill = 0;
+	return true;
+}
+
+//@pre: an open file descriptor
+//@return: true if a read would not block
+static bool InputReady(int fd){
+	struct pollfd input = { fd, POLLIN, 0 };
+	return poll(&input, 1, 0) > 0;
+}
+
+//@pre: an open trace that is not mapped, least <= count
+//@post: at least least bytes are read into destination, fewer only at the end
+//       of the input, and more up to count as long as they are already there
+//@return: the bytes read
+static size_t ReadInput(traceReader *trace, uint8_t *destination, size_t count, size_t least){
+	size_t fill = 0;
+	while (!trace->eof && fill < count) {
+		if (fill >= least && !InputReady(trace->fd)) {
+			break;
+		}
+		ssize_t got = read(trace->fd, destination + fill, count - fill);
+		if (got > 0) {
+			fill += (size_t)got;
+		}
+		else if (got == 0) {
+			trace->eof = true;
+		}
+		else if (errno != EINTR) {
+			perror("trace read");
+			trace->eof = true;
+			trace->failed = true;
+		}
+	}
+	return fill;
+}
+
+//@pre: trace has a buffer of at least count bytes, least <= count
+//@post: the buffer holds least bytes, fewer only at the end of the input, and
+//       up to count if the input already has them
+//@return: none
+static void FillBuffer(traceReader *trace, size_t count, size_t least){
+	if (trace->bufferFill < count) {
+		size_t needed = trace->bufferFill < least ? least - trace->bufferFill : 0;
+		trace->bufferFill += ReadInput(trace, trace->buffer + trace->bufferFill,
+			count - trace->bufferFill, needed);
+	}
+}
+
+//@pre: header is the header of a packed trace
+//@post: trace decodes packed chunks into its own buffers
+//@return: false (with a message) if the header is bad or the buffers cannot be had
+static bool StartPackedTrace(traceReader *trace, const uint8_t *header){
+	uint32_t flags, chunkItems;
+	memcpy(&flags, header + TraceMagic_Bytes, sizeof(flags));
+	memcpy(&chunkItems, header + TraceMagic_Bytes + 4, sizeof(chunkItems));
+	if ((flags & ~PACK_RECORDS) != 0 || chunkItems == 0 || chunkItems > TraceBatch_Nbr) {
+		fprintf(stderr, "Unsupported packed trace header\n");
+		return false;
+	}
+	trace->packed = true;
+	trace->packFlags = flags;
+	trace->itemBytes = (flags & PACK_RECORDS) ? sizeof(traceRecord) : TraceAddress_Bytes;
+
+	size_t limit = PackChunkLimit(TraceBatch_Nbr, flags);
+	trace->chunk = malloc(limit);
+	trace->scratch = malloc(limit);
+	trace->decoded = malloc(TraceBatch_Nbr * trace->itemBytes);
+	if (trace->chunk == NULL || trace->scratch == NULL || trace->decoded == NULL) {
+		fprintf(stderr, "Unable to allocate the packed trace buffers\n");
+		return false;
+	}
+	return true;
+}
+
+//@pre: header points at the first length bytes of the trace
+//@post: trace->itemBytes is set for a raw or a record trace
+//@return: the bytes of header to skip, or -1 (with a message) for a bad header
+static long ParseTraceHeader(traceReader *trace, const uint8_t *header, size_t length){
+	trace->itemBytes = TraceAddress_Bytes;
+	if (length >= PackHeader_Bytes && memcmp(header, PackMagic, TraceMagic_Bytes) == 0) {
+		return StartPackedTrace(trace, header) ? PackHeader_Bytes : -1;
+	}
+	if (length < TraceHeader_Bytes || memcmp(header, TraceMagic, TraceMagic_Bytes) != 0) {
+		return 0;
+	}
+	uint32_t recordBytes;
+	memcpy(&recordBytes, header + TraceMagic_Bytes, sizeof(recordBytes));
+	if (recordBytes != sizeof(traceRecord)) {
+		fprintf(stderr, "Record trace with %u byte records is not supported\n", recordBytes);
+		return -1;
+	}
+	trace->itemBytes = sizeof(traceRecord);
+	return TraceHeader_Bytes;
+}
+
+//@pre: path names a trace file, or is "-" for stdin
+//@post: trace is ready for NextTraceBatch
+//@return: false (with a message) if the trace cannot be opened
+bool OpenTrace(traceReader *trace, const char *path, unsigned flags){
+	memset(trace, 0, sizeof(*trace));
+	trace->flags = flags;
+	trace->fd = strcmp(path, "-") == 0 ? dup(STDIN_FILENO) : open(path, O_RDONLY);
+	if (trace->fd < 0) {
+		perror(path);
+		return false;
+	}
+
+	long skip;
+	struct stat info;
+	if (!(flags & TRACE_NO_MMAP) && fstat(trace->fd, &info) == 0
+		&& S_ISREG(info.st_mode) && info.st_size > 0
+		&& MapTrace(trace, (size_t)info.st_size)) {
+		skip = ParseTraceHeader(trace, trace->map, trace->mapLength);
+		trace->mapOffset = skip > 0 ? (size_t)skip : 0;
+	}
+	else if (BufferTrace(trace)) {
+#ifdef F_SETPIPE_SZ
+		// Let a live producer run further ahead of the simulation
+		if ((flags & TRACE_LIVE) && fstat(trace->fd, &info) == 0 && S_ISFIFO(info.st_mode)) {
+			fcntl(trace->fd, F_SETPIPE_SZ, PipeRing_Bytes);
+		}
+#endif
+		// Read just enough to tell the formats apart; raw data stays in the buffer
+		FillBuffer(trace, TraceHeader_Bytes, TraceHeader_Bytes);
+		skip = ParseTraceHeader(trace, trace->buffer, trace->bufferFill);
+		if (skip > 0) {
+			trace->bufferFill = 0;
+		}
+	}
+	else {
+		perror("trace buffer");
+		CloseTrace(trace);
+		return false;
+	}
+	if (skip < 0) {
+		CloseTrace(trace);
+		return false;
+	}
+	return true;
+}
+
+//@pre: spec describes a generator, as taken by ParseGeneratorSpec
+//@post: trace produces the generated stream
+//@return: false (with a message) if the spec is bad
+bool OpenGeneratedTrace(traceReader *trace, const char *spec){
+	memset(trace, 0, sizeof(*trace));
+	trace->fd = -1;
+	trace->generator = malloc(sizeof(traceGenerator));
+	if (trace->generator == NULL || !ParseGeneratorSpec(trace->generator, spec)
+		|| !buildGenerator(trace->generator)) {
+		free(trace->generator);
+		trace->generator = NULL;
+		return false;
+	}
+	trace->itemBytes = trace->generator->records ? sizeof(traceRecord) : TraceAddress_Bytes;
+	return true;
+}
+
+//@pre: data points at count addresses or records of the trace
+//@post: batch describes them
+//@return: count
+static size_t SetBatch(const traceReader *trace, traceBatch *batch, const uint8_t *data, size_t count){
+	batch->addresses = NULL;
+	batch->records = NULL;
+	if (trace->itemBytes == sizeof(traceRecord)) {
+		batch->records = (const traceRecord *)data;
+	}
+	else {
+		batch->addresses = (const uint32_t *)data;
+	}
+	batch->count = count;
+	return count;
+}
+
+//@pre: an open packed trace
+//@post: the next chunk is decoded into trace->decoded; trace->failed is set
+//       (with a message) if the trace is corrupt or ends inside a chunk
+//@return: the number of items in *batch, 0 at the end of the trace or on failure
+static size_t NextPackedBatch(traceReader *trace, traceBatch *batch){
+	const uint8_t *header;
+	const uint8_t *stored;
+	uint8_t headerBytes[PackChunk_Bytes];
+	packChunk chunk;
+	size_t headerFill;
+	if (trace->map != NULL) {
+		headerFill = trace->mapLength - trace->mapOffset;
+		header = trace->map + trace->mapOffset;
+	}
+	else {
+		headerFill = ReadInput(trace, headerBytes, PackChunk_Bytes, PackChunk_Bytes);
+		header = headerBytes;
+	}
+	if (headerFill == 0 || trace->failed) {
+		return 0;
+	}
+	if (headerFill < PackChunk_Bytes) {
+		fprintf(stderr, "Packed trace ends inside a chunk header\n");
+		trace->failed = true;
+		return 0;
+	}
+	if (!ParsePackChunk(header, trace->packFlags, &chunk)) {
+		trace->failed = true;
+		return 0;
+	}
+
+	if (trace->map != NULL) {
+		trace->mapOffset += PackChunk_Bytes;
+		if (trace->mapLength - trace->mapOffset < chunk.storedBytes) {
+			fprintf(stderr, "Packed trace ends inside a chunk\n");
+			trace->failed = true;
+			return 0;
+		}
+		stored = trace->map + trace->mapOffset;
+		trace->mapOffset += chunk.storedBytes;
+	}
+	else {
+		if (ReadInput(trace, trace->chunk, chunk.storedBytes, chunk.storedBytes) < chunk.storedBytes) {
+			if (!trace->failed) {
+				fprintf(stderr, "Packed trace ends inside a chunk\n");
+				trace->failed = true;
+			}
+			return 0;
+		}
+		stored = trace->chunk;
+	}
+
+	const uint8_t *encoded = stored;
+	if (chunk.flags & CHUNK_LZ) {
+		if (!LzDecompress(stored, chunk.storedBytes, trace->scratch, chunk.encodedBytes)) {
+			fprintf(stderr, "Corrupt compressed chunk in packed trace\n");
+			trace->failed = true;
+			return 0;
+		}
+		encoded = trace->scratch;
+	}
+	if (!UnpackChunk(encoded, chunk.encodedBytes, chunk.items, trace->packFlags, trace->decoded)) {
+		trace->failed = true;
+		return 0;
+	}
+	trace->addressesRead += chunk.items;
+	return SetBatch(trace, batch, trace->decoded, chunk.items);
+}
+
+//@pre: an open trace
+//@post: the trace is advanced past the returned addresses or records
+//@return: the number of addresses or records in *batch, 0 at the end of the trace
+//@brief: The batch stays valid until the next call. A trailing partial
+//        address or record at the end of the trace is ignored.
+size_t NextTraceBatch(traceReader *trace, traceBatch *batch){
+	size_t count;
+	size_t itemBytes = trace->itemBytes;
+	if (trace->packed) {
+		return NextPackedBatch(trace, batch);
+	}
+	if (trace->generator != NULL) {
+		count = NextGeneratedBatch(trace->generator, batch);
+		trace->addressesRead += count;
+		return count;
+	}
+	if (trace->map != NULL) {
+		size_t remaining = (trace->mapLength - trace->mapOffset) / itemBytes;
+		count = remaining < TraceBatch_Nbr ? remaining : TraceBatch_Nbr;
+		SetBatch(trace, batch, trace->map + trace->mapOffset, count);
+		trace->mapOffset += count * itemBytes;
+		trace->addressesRead += count;
+		return count;
+	}
+
+	// Keep the partial item left over from the last read at the front. A live
+	// trace takes whatever whole items have arrived rather than a full batch.
+	memmove(trace->buffer, trace->buffer + trace->bufferUsed, trace->bufferFill - trace->bufferUsed);
+	trace->bufferFill -= trace->bufferUsed;
+	size_t wanted = TraceBatch_Nbr * itemBytes;
+	FillBuffer(trace, wanted, (trace->flags & TRACE_LIVE) ? itemBytes : wanted);
+
+	count = trace->bufferFill / itemBytes;
+	trace->bufferUsed = count * itemBytes;
+	trace->addressesRead += count;
+	return SetBatch(trace, batch, trace->buffer, count);
+}
+
+//@pre: an open trace
+//@return: true if the trace is read in place from a mapping
+bool TraceIsMapped(const traceReader *trace){
+	return trace->map != NULL;
+}
+
+//@pre: an open trace
+//@return: true if the trace holds traceRecords rather than raw addresses
+bool TraceHasRecords(const traceReader *trace){
+	return trace->itemBytes == sizeof(traceRecord);
+}
+
+//@pre: trace was opened by OpenTrace
+//@post: the file is closed and every mapping released
+//@return: none
+void CloseTrace(traceReader *trace){
+	if (trace->map != NULL) {
+		munmap((void *)trace->map, trace->mapLength);
+	}
+	if (trace->buffer != NULL) {
+		munmap(trace->buffer, trace->bufferLength);
+	}
+	free(trace->chunk);
+	free(trace->scratch);
+	free(trace->decoded);
+	if (trace->generator != NULL) {
+		destroyGenerator(trace->generator);
+		free(trace->generator);
+	}
+	if (trace->fd >= 0) {
+		close(trace->fd);
+	}
+	trace->map = NULL;
+	trace->buffer = NULL;
+	trace->chunk = trace->scratch = trace->decoded = NULL;
+	trace->generator = NULL;
+	trace->fd = -1;
+}
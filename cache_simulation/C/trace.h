@@ -0,0 +1,117 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Address trace input for the cache simulation
+//
+//	Description:
+//			A trace is a file of little-endian 32-bit addresses. Regular files
+//			are memory mapped and handed to the simulator in place, in batches
+//			that point straight into the mapping. Pipes, FIFOs and "-" (stdin)
+//			cannot be mapped and are read into a buffer instead.
+//
+//			A live trace (TRACE_LIVE) is a pipe fed by a running program:
+//			its kernel buffer is enlarged so the writer can run ahead, and
+//			every batch holds whatever whole items have arrived, so the
+//			simulation keeps up with the writer instead of waiting for it to
+//			fill a batch.
+//
+//			A trace that starts with the TraceMagic header is a record trace
+//			instead: after the 16 byte header come 16 byte traceRecords that
+//			carry a 64-bit address, the access type and the access size.
+//			Every record is charged to the block holding its first byte.
+//
+//			Either kind may also be packed (tracepack.h): delta encoded in
+//			chunks, which are decoded one batch at a time as they are read.
+//			A trace may also come from a generator (generator.h) instead of
+//			a file.
+//
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+//	Addresses handed out per batch
+//
+#define  TraceBatch_Nbr  ( 1 << 16 )
+
+//
+//	Flags for OpenTrace
+//
+#define  TRACE_HUGEPAGES  0x1   // ask for transparent huge pages on the trace memory
+#define  TRACE_NO_MMAP    0x2   // always use the streaming reader
+#define  TRACE_LIVE       0x4   // hand out what a pipe has delivered without waiting for a full batch
+
+//
+//	Record trace header: magic, then the record size and flags as 32-bit words
+//
+#define  TraceMagic          "CSTRACE1"
+#define  TraceMagic_Bytes    8
+#define  TraceHeader_Bytes   16
+
+typedef enum {ACCESS_LOAD = 0, ACCESS_STORE, ACCESS_IFETCH} accessType;
+
+//One access of a record trace, as stored in the file
+typedef struct traceRecord
+{
+	uint64_t address;
+	uint32_t gap;      //instructions since the previous access
+	uint16_t core;     //issuing core
+	uint8_t type;      //accessType
+	uint8_t size;      //bytes accessed
+} traceRecord;
+
+//A batch of either raw addresses or records; the other pointer is NULL
+typedef struct traceBatch
+{
+	const uint32_t *addresses;
+	const traceRecord *records;
+	size_t count;
+} traceBatch;
+
+struct traceGenerator;
+
+typedef struct traceReader
+{
+	int fd;
+	unsigned flags;
+	//bytes per address or record
+	size_t itemBytes;
+
+	//memory mapped input
+	const uint8_t *map;
+	size_t mapLength;
+	size_t mapOffset;
+
+	//streaming input
+	uint8_t *buffer;
+	size_t bufferLength;
+	size_t bufferFill;
+	size_t bufferUsed;
+	bool eof;
+
+	//packed input: stored bytes of a streamed chunk, LZ output, decoded items
+	bool packed;
+	unsigned packFlags;
+	uint8_t *chunk;
+	uint8_t *scratch;
+	uint8_t *decoded;
+
+	//generated input
+	struct traceGenerator *generator;
+
+	uint64_t addressesRead;
+
+	//set when the trace stops short: a read error, or a corrupt or truncated packed trace
+	bool failed;
+} traceReader;
+
+bool OpenTrace(traceReader *trace, const char *path, unsigned flags);
+bool OpenGeneratedTrace(traceReader *trace, const char *spec);
+size_t NextTraceBatch(traceReader *trace, traceBatch *batch);
+bool TraceIsMapped(const traceReader *trace);
+bool TraceHasRecords(const traceReader *trace);
+void CloseTrace(traceReader *trace);
+
+#endif /* TRACE_H_ */
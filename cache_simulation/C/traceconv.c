@@ -0,0 +1,125 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Converts traces between the raw, record and packed formats
+//
+//	Description:
+//			Reads any trace cachesim reads (raw addresses, records, packed)
+//			or a generated stream, and writes it packed, or unpacked with -u.
+//			Raw addresses stay raw and records stay records either way.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "tracepack.h"
+
+void PrintUsage (const char *program) {
+	printf("USAGE: %s [options] <input trace | -> <output trace | ->\n", program);
+	printf("       %s [options] -g <generator spec> <output trace | ->\n", program);
+	printf("  -z          LZ compress every chunk\n");
+	printf("  -c <n>      items per chunk (at most %d, the default)\n", TraceBatch_Nbr);
+	printf("  -u          write an unpacked trace instead of a packed one\n");
+	printf("  -g <spec>   convert a generated stream (see cachesim -h)\n");
+}
+
+//@pre: an open trace and output file
+//@post: the rest of the trace is written to output unpacked
+//@return: false (with a message) if the trace could not be read or a write failed
+bool WriteUnpacked (traceReader *trace, FILE *output) {
+	traceBatch batch;
+	bool records = TraceHasRecords(trace);
+	if (records) {
+		uint8_t header[TraceHeader_Bytes] = { 0 };
+		uint32_t recordBytes = sizeof(traceRecord);
+		memcpy(header, TraceMagic, TraceMagic_Bytes);
+		memcpy(header + TraceMagic_Bytes, &recordBytes, sizeof(recordBytes));
+		if (fwrite(header, sizeof(header), 1, output) != 1) {
+			perror("output");
+			return false;
+		}
+	}
+	while (NextTraceBatch(trace, &batch) > 0) {
+		const void *items = records ? (const void *)batch.records : (const void *)batch.addresses;
+		size_t itemBytes = records ? sizeof(traceRecord) : sizeof(uint32_t);
+		if (fwrite(items, itemBytes, batch.count, output) != batch.count) {
+			perror("output");
+			return false;
+		}
+	}
+	return !trace->failed;
+}
+
+//@pre: an open trace and output file
+//@post: the rest of the trace is written to output packed
+//@return: false (with a message) if the trace could not be read or a write failed
+bool WritePacked (traceReader *trace, FILE *output, bool compress, uint32_t chunkItems) {
+	packWriter writer;
+	traceBatch batch;
+	bool ok = OpenPackWriter(&writer, output, TraceHasRecords(trace), compress, chunkItems);
+	while (ok && NextTraceBatch(trace, &batch) > 0) {
+		ok = PackBatch(&writer, &batch);
+	}
+	ok = ClosePackWriter(&writer) && ok && !trace->failed;
+	if (ok) {
+		fprintf(stderr, "%llu items packed into %llu bytes (%.2f bytes per item)\n",
+			(unsigned long long)writer.itemsWritten, (unsigned long long)writer.bytesWritten,
+			writer.itemsWritten ? (double)writer.bytesWritten / writer.itemsWritten : 0.0);
+	}
+	return ok;
+}
+
+int main (int argc, char * const argv[]) {
+	bool compress = false;
+	bool unpack = false;
+	long chunkItems = TraceBatch_Nbr;
+	const char *generatorSpec = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "zc:ug:h")) != -1) {
+		switch (option) {
+			case 'g': generatorSpec = optarg; break;
+			case 'z': compress = true; break;
+			case 'u': unpack = true; break;
+			case 'c': {
+				char *end = NULL;
+				chunkItems = strtol(optarg, &end, 10);
+				if (end == optarg || *end != '\0' || chunkItems < 1 || chunkItems > TraceBatch_Nbr) {
+					fprintf(stderr, "Chunks hold between 1 and %d items\n", TraceBatch_Nbr);
+					return 2;
+				}
+				break;
+			}
+			case 'h': PrintUsage(argv[0]); return 0;
+			default: return 2;
+		}
+	}
+	int inputs = generatorSpec != NULL ? 0 : 1;
+	if (argc - optind != inputs + 1) {
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	traceReader trace;
+	bool opened = generatorSpec != NULL ? OpenGeneratedTrace(&trace, generatorSpec)
+		: OpenTrace(&trace, argv[optind], 0);
+	if (!opened) {
+		return 2;
+	}
+	const char *outputName = argv[optind + inputs];
+	FILE *output = strcmp(outputName, "-") == 0 ? stdout : fopen(outputName, "wb");
+	if (output == NULL) {
+		perror(outputName);
+		CloseTrace(&trace);
+		return 2;
+	}
+
+	bool ok = unpack ? WriteUnpacked(&trace, output)
+		: WritePacked(&trace, output, compress, (uint32_t)chunkItems);
+	if (output != stdout && fclose(output) != 0) {
+		perror(outputName);
+		ok = false;
+	}
+	CloseTrace(&trace);
+	return ok ? 0 : 2;
+}
@@ -0,0 +1,316 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Packed trace encoding and decoding
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "lzblock.h"
+#include "tracepack.h"
+
+//
+//	Kind byte of an encoded record: the access type and the fields that follow
+//
+#define  KIND_TYPE_MASK  0x07
+#define  KIND_SIZE       0x08
+#define  KIND_CORE       0x10
+#define  KIND_GAP        0x20
+
+//=============================================================================
+// VARINTS
+//
+
+static inline uint64_t ZigZag(int64_t value){
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t UnZigZag(uint64_t value){
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+//@pre: out has room for PackAddress_MaxBytes
+//@return: the byte after the varint
+static inline uint8_t *PutVarint(uint8_t *out, uint64_t value){
+	while (value >= 0x80) {
+		*out++ = (uint8_t)value | 0x80;
+		value >>= 7;
+	}
+	*out++ = (uint8_t)value;
+	return out;
+}
+
+//@pre: *in points into an encoded chunk ending at end
+//@post: *value holds the varint and *in is advanced past it
+//@return: false if the chunk ends inside the varint or it is too long
+static inline bool GetVarint(const uint8_t **in, const uint8_t *end, uint64_t *value){
+	uint64_t result = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		if (*in == end) {
+			return false;
+		}
+		uint8_t byte = *(*in)++;
+		result |= (uint64_t)(byte & 0x7f) << shift;
+		if (byte < 0x80) {
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+//@pre: at least 8 bytes can be read at *in
+//@post: *value holds the varint and *in is advanced past it
+//@return: false, with *in unchanged, if the varint is longer than 8 bytes
+//@brief: Finds the last byte from the cleared high bits and gathers the 7-bit
+//        groups with one pext, so the varint length costs no branch. Without
+//        BMI2 this is the plain loop.
+static inline bool GetVarintFast(const uint8_t **in, uint64_t *value){
+#if defined(__BMI2__)
+	uint64_t word;
+	memcpy(&word, *in, sizeof(word));
+	uint64_t stops = ~word & 0x8080808080808080ull;
+	if (stops == 0) {
+		return false;
+	}
+	uint32_t bits = (uint32_t)__builtin_ctzll(stops) + 1;
+	uint64_t mask = bits == 64 ? ~0ull : (1ull << bits) - 1;
+	*value = _pext_u64(word & mask, 0x7f7f7f7f7f7f7f7full);
+	*in += bits / 8;
+	return true;
+#else
+	return GetVarint(in, *in + 8, value);
+#endif
+}
+
+//=============================================================================
+// DECODING
+//
+
+//@pre: flags are the trace's flags
+//@return: the most bytes a chunk of that many items can encode or store to
+size_t PackChunkLimit(uint32_t items, unsigned flags){
+	return (size_t)items * ((flags & PACK_RECORDS) ? PackRecord_MaxBytes : PackAddress_MaxBytes);
+}
+
+//@pre: bytes points at a chunk header of a trace with the given flags
+//@post: chunk holds the header
+//@return: false (with a message) if the header cannot be right
+bool ParsePackChunk(const uint8_t *bytes, unsigned flags, packChunk *chunk){
+	memcpy(&chunk->items, bytes, sizeof(uint32_t));
+	memcpy(&chunk->encodedBytes, bytes + 4, sizeof(uint32_t));
+	memcpy(&chunk->storedBytes, bytes + 8, sizeof(uint32_t));
+	memcpy(&chunk->flags, bytes + 12, sizeof(uint32_t));
+	size_t limit = PackChunkLimit(chunk->items, flags);
+	if (chunk->items == 0 || chunk->items > TraceBatch_Nbr || chunk->encodedBytes > limit
+		|| chunk->storedBytes > limit || (chunk->flags & ~CHUNK_LZ) != 0) {
+		fprintf(stderr, "Corrupt packed trace chunk header\n");
+		return false;
+	}
+	return true;
+}
+
+//@return: false if the chunk does not decode to exactly items addresses
+static bool DecodeAddresses(const uint8_t *in, const uint8_t *end, uint32_t items, uint32_t *addresses){
+	uint64_t address = 0;
+	uint64_t value;
+	for (uint32_t i = 0; i < items; i++) {
+		bool fast = end - in >= 8 && GetVarintFast(&in, &value);
+		if (!fast && !GetVarint(&in, end, &value)) {
+			return false;
+		}
+		address += (uint64_t)UnZigZag(value);
+		addresses[i] = (uint32_t)address;
+	}
+	return in == end;
+}
+
+//@return: false if the chunk does not decode to exactly items records
+static bool DecodeRecords(const uint8_t *in, const uint8_t *end, uint32_t items, traceRecord *records){
+	traceRecord last = { 0 };
+	uint64_t value;
+	for (uint32_t i = 0; i < items; i++) {
+		bool fast = end - in >= 8 && GetVarintFast(&in, &value);
+		if ((!fast && !GetVarint(&in, end, &value)) || in == end) {
+			return false;
+		}
+		last.address += (uint64_t)UnZigZag(value);
+		uint8_t kind = *in++;
+		last.type = kind & KIND_TYPE_MASK;
+		last.gap = 0;
+		if (kind & KIND_SIZE) {
+			if (in == end) {
+				return false;
+			}
+			last.size = *in++;
+		}
+		if (kind & KIND_CORE) {
+			if (!GetVarint(&in, end, &value)) {
+				return false;
+			}
+			last.core = (uint16_t)value;
+		}
+		if (kind & KIND_GAP) {
+			if (!GetVarint(&in, end, &value)) {
+				return false;
+			}
+			last.gap = (uint32_t)value;
+		}
+		records[i] = last;
+	}
+	return in == end;
+}
+
+//@pre: out has room for items addresses (uint32_t) or records
+//@post: out holds the decoded chunk
+//@return: false (with a message) if the chunk does not decode to exactly items
+bool UnpackChunk(const uint8_t *encoded, size_t bytes, uint32_t items, unsigned flags, void *out){
+	bool ok = (flags & PACK_RECORDS)
+		? DecodeRecords(encoded, encoded + bytes, items, out)
+		: DecodeAddresses(encoded, encoded + bytes, items, out);
+	if (!ok) {
+		fprintf(stderr, "Corrupt packed trace chunk\n");
+	}
+	return ok;
+}
+
+//=============================================================================
+// ENCODING
+//
+
+//@pre: file is open for writing; chunkItems is between 1 and TraceBatch_Nbr
+//@post: the trace header is written and writer is ready for PackBatch
+//@return: false (with a message) if the buffers or header cannot be made
+bool OpenPackWriter(packWriter *writer, FILE *file, bool records, bool compress, uint32_t chunkItems){
+	memset(writer, 0, sizeof(*writer));
+	writer->file = file;
+	writer->flags = records ? PACK_RECORDS : 0;
+	writer->compress = compress;
+	writer->chunkItems = chunkItems;
+	size_t limit = PackChunkLimit(chunkItems, writer->flags);
+	writer->encoded = malloc(limit);
+	writer->stored = malloc(limit);
+	if (writer->encoded == NULL || writer->stored == NULL) {
+		fprintf(stderr, "Unable to allocate the chunk buffers\n");
+		return false;
+	}
+
+	uint8_t header[PackHeader_Bytes];
+	uint32_t flags = writer->flags;
+	memcpy(header, PackMagic, 8);
+	memcpy(header + 8, &flags, sizeof(flags));
+	memcpy(header + 12, &chunkItems, sizeof(chunkItems));
+	if (fwrite(header, sizeof(header), 1, file) != 1) {
+		perror("packed trace");
+		return false;
+	}
+	writer->bytesWritten = sizeof(header);
+	return true;
+}
+
+//@pre: an open writer
+//@post: the chunk being encoded, if any, is written and a new one started
+//@return: false (with a message) if the write failed
+static bool FlushChunk(packWriter *writer){
+	if (writer->items == 0) {
+		return true;
+	}
+	packChunk chunk = { writer->items, (uint32_t)writer->encodedBytes, (uint32_t)writer->encodedBytes, 0 };
+	const uint8_t *payload = writer->encoded;
+	if (writer->compress) {
+		// Keep the LZ form only when it is smaller
+		size_t stored = LzCompress(writer->encoded, writer->encodedBytes, writer->stored, writer->encodedBytes - 1);
+		if (stored > 0) {
+			chunk.storedBytes = (uint32_t)stored;
+			chunk.flags = CHUNK_LZ;
+			payload = writer->stored;
+		}
+	}
+
+	uint8_t header[PackChunk_Bytes];
+	memcpy(header, &chunk.items, sizeof(uint32_t));
+	memcpy(header + 4, &chunk.encodedBytes, sizeof(uint32_t));
+	memcpy(header + 8, &chunk.storedBytes, sizeof(uint32_t));
+	memcpy(header + 12, &chunk.flags, sizeof(uint32_t));
+	if (fwrite(header, sizeof(header), 1, writer->file) != 1
+		|| fwrite(payload, 1, chunk.storedBytes, writer->file) != chunk.storedBytes) {
+		perror("packed trace");
+		return false;
+	}
+
+	writer->bytesWritten += sizeof(header) + chunk.storedBytes;
+	writer->itemsWritten += writer->items;
+	writer->items = 0;
+	writer->encodedBytes = 0;
+	writer->previous = 0;
+	memset(&writer->last, 0, sizeof(writer->last));
+	return true;
+}
+
+//@pre: an open writer
+//@post: the record is appended to the chunk being encoded
+//@return: none
+static void PackRecord(packWriter *writer, const traceRecord *record){
+	uint8_t *out = writer->encoded + writer->encodedBytes;
+	out = PutVarint(out, ZigZag((int64_t)(record->address - writer->previous)));
+	uint8_t *kind = out++;
+	*kind = record->type & KIND_TYPE_MASK;
+	if (record->size != writer->last.size) {
+		*kind |= KIND_SIZE;
+		*out++ = record->size;
+	}
+	if (record->core != writer->last.core) {
+		*kind |= KIND_CORE;
+		out = PutVarint(out, record->core);
+	}
+	if (record->gap != 0) {
+		*kind |= KIND_GAP;
+		out = PutVarint(out, record->gap);
+	}
+	writer->previous = record->address;
+	writer->last = *record;
+	writer->encodedBytes = (size_t)(out - writer->encoded);
+}
+
+//@pre: an open writer; the batch holds records exactly if the writer does
+//@post: every item of the batch is encoded, and full chunks are written
+//@return: false (with a message) if a write failed or a record cannot be packed
+bool PackBatch(packWriter *writer, const traceBatch *batch){
+	for (size_t i = 0; i < batch->count; i++) {
+		if (batch->records != NULL) {
+			if (batch->records[i].type > KIND_TYPE_MASK) {
+				fprintf(stderr, "Access type %u cannot be packed\n", batch->records[i].type);
+				return false;
+			}
+			PackRecord(writer, &batch->records[i]);
+		}
+		else {
+			uint64_t address = batch->addresses[i];
+			uint8_t *out = writer->encoded + writer->encodedBytes;
+			out = PutVarint(out, ZigZag((int64_t)(address - writer->previous)));
+			writer->previous = address;
+			writer->encodedBytes = (size_t)(out - writer->encoded);
+		}
+		if (++writer->items == writer->chunkItems && !FlushChunk(writer)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//@pre: an open writer
+//@post: the last chunk is written and the buffers released; the file is
+//       left open
+//@return: false if the last write failed
+bool ClosePackWriter(packWriter *writer){
+	bool ok = FlushChunk(writer) && fflush(writer->file) == 0;
+	free(writer->encoded);
+	free(writer->stored);
+	writer->encoded = NULL;
+	writer->stored = NULL;
+	return ok;
+}
@@ -0,0 +1,84 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Packed traces: chunked, delta encoded and optionally LZ compressed
+//
+//	Description:
+//			A packed trace starts with a 16 byte header: PackMagic, 32-bit
+//			flags (PACK_RECORDS if it holds traceRecords rather than raw
+//			addresses) and the item count of a full chunk. Chunks follow,
+//			each a 16 byte header (items, encoded bytes, stored bytes, chunk
+//			flags) and the stored bytes. All words are little-endian.
+//
+//			The encoded form of a chunk stores every address as the zigzag
+//			varint of its difference from the previous one, starting from 0
+//			at the chunk boundary so chunks decode independently. A record
+//			adds a kind byte holding the access type and flags for the fields
+//			that follow it: the size and core when they differ from the
+//			previous record, and the gap when it is not zero. A chunk with
+//			CHUNK_LZ is stored LZ compressed (lzblock.h), otherwise stored as
+//			encoded.
+//
+
+#ifndef TRACEPACK_H_
+#define TRACEPACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace.h"
+
+#define  PackMagic          "CSTRACEZ"
+#define  PackHeader_Bytes   16
+#define  PackChunk_Bytes    16
+
+//
+//	Trace and chunk flags
+//
+#define  PACK_RECORDS       0x1
+#define  CHUNK_LZ           0x1
+
+//
+//	Largest encoded item: a 64-bit varint address delta, plus the kind byte,
+//	size, 16-bit core and 32-bit gap of a record
+//
+#define  PackAddress_MaxBytes  10
+#define  PackRecord_MaxBytes   ( PackAddress_MaxBytes + 1 + 1 + 3 + 5 )
+
+//Header of one chunk as read from the trace
+typedef struct packChunk
+{
+	uint32_t items;
+	uint32_t encodedBytes;
+	uint32_t storedBytes;
+	uint32_t flags;
+} packChunk;
+
+typedef struct packWriter
+{
+	FILE *file;
+	unsigned flags;
+	bool compress;
+	uint32_t chunkItems;
+
+	//the chunk being encoded
+	uint8_t *encoded;
+	size_t encodedBytes;
+	uint8_t *stored;
+	uint32_t items;
+	uint64_t previous;
+	traceRecord last;
+
+	uint64_t itemsWritten;
+	uint64_t bytesWritten;
+} packWriter;
+
+size_t PackChunkLimit(uint32_t items, unsigned flags);
+bool ParsePackChunk(const uint8_t *bytes, unsigned flags, packChunk *chunk);
+bool UnpackChunk(const uint8_t *encoded, size_t bytes, uint32_t items, unsigned flags, void *out);
+
+bool OpenPackWriter(packWriter *writer, FILE *file, bool records, bool compress, uint32_t chunkItems);
+bool PackBatch(packWriter *writer, const traceBatch *batch);
+bool ClosePackWriter(packWriter *writer);
+
+#endif /* TRACEPACK_H_ */
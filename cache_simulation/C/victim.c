@@ -0,0 +1,164 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Victim and miss cache buffers
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "victim.h"
+
+static const char *VictimNames[] = {"none", "victim", "miss"};
+
+#define  VictimKinds_Nbr  ( sizeof(VictimNames) / sizeof(VictimNames[0]) )
+
+//@pre: none
+//@post: config holds no buffer with the default entry count
+//@return: none
+void DefaultVictimConfig(victimConfig *config){
+	memset(config, 0, sizeof(*config));
+	config->kind = VICTIM_NONE;
+	config->entries = Default_VictimEntries;
+}
+
+//@pre: name is a buffer kind such as "victim"
+//@post: *kind holds the matching kind
+//@return: false if the name is not known
+bool ParseVictimKind(const char *name, victimKind *kind){
+	for (size_t i = 0; i < VictimKinds_Nbr; i++) {
+		if (strcasecmp(name, VictimNames[i]) == 0) {
+			*kind = (victimKind)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//@pre: spec is a buffer kind optionally followed by entries=n, e.g.
+//      "victim,entries=4"
+//@post: config holds the options of spec
+//@return: false (with a message) if the spec is malformed
+bool ParseVictimSpec(victimConfig *config, const char *spec){
+	char *copy = strdup(spec);
+	char *saveptr = NULL;
+	char *item = strtok_r(copy, ", \t", &saveptr);
+	bool ok = item != NULL && ParseVictimKind(item, &config->kind);
+	if (!ok) {
+		fprintf(stderr, "Unknown victim buffer: %s\n", item != NULL ? item : "");
+	}
+	while (ok && (item = strtok_r(NULL, ", \t", &saveptr)) != NULL) {
+		ok = strncasecmp(item, "entries=", 8) == 0
+			&& ParseCount(item + 8, 1, VictimEntries_Max, &config->entries);
+		if (!ok) {
+			fprintf(stderr, "Bad victim buffer option: %s\n", item);
+		}
+	}
+	free(copy);
+	return ok;
+}
+
+//@pre: a valid buffer kind
+//@return: its name
+const char *VictimKindName(victimKind kind){
+	return VictimNames[kind];
+}
+
+//@pre: level has been through ConfigureCache
+//@post: the geometry of the buffer is a single LRU set of entries blocks of
+//       the level's block size
+//@return: false (with a message) if the buffer cannot be built
+bool ConfigureVictimBuffer(victimConfig *config, const cacheConfig *level){
+	if (config->kind == VICTIM_NONE) {
+		return true;
+	}
+	if (config->entries < 1 || config->entries > VictimEntries_Max) {
+		fprintf(stderr, "A victim buffer holds 1 to %d entries\n", VictimEntries_Max);
+		return false;
+	}
+	cacheConfig *geometry = &config->geometry;
+	DefaultCacheConfig(geometry);
+	geometry->associativity = config->entries;
+	geometry->blockSize_Exp = level->blockSize_Exp;
+	geometry->addressSize_Exp = level->addressSize_Exp;
+	geometry->replacement = LRU;
+	// The smallest power of two holding every entry leaves room for one set
+	uint32_t entriesExp = 0;
+	while ((1u << entriesExp) < config->entries) {
+		entriesExp++;
+	}
+	geometry->cacheSize_Exp = level->blockSize_Exp + entriesExp;
+	return ConfigureCache(geometry);
+}
+
+//@pre: config has been through ConfigureVictimBuffer
+//@post: the buffer is empty; with no buffer nothing is allocated
+//@return: false if memory is short
+bool buildVictimBuffer(victimBuffer *buffer, const victimConfig *config){
+	memset(buffer, 0, sizeof(*buffer));
+	buffer->config = *config;
+	if (config->kind == VICTIM_NONE) {
+		return true;
+	}
+	return buildCache(&buffer->blocks, &config->geometry);
+}
+
+//@pre: a built or zeroed buffer
+//@post: all memory is freed
+//@return: none
+void destroyVictimBuffer(victimBuffer *buffer){
+	if (buffer->config.kind != VICTIM_NONE) {
+		destroyCache(&buffer->blocks);
+	}
+	memset(buffer, 0, sizeof(*buffer));
+}
+
+//@pre: a built buffer beside a level that has just missed on address
+//@post: the probe is counted. A victim cache gives up the block on a hit; a
+//       miss cache keeps its copy, now most recently used.
+//@return: true on a hit, whether the block was dirty in *dirty
+bool TakeFromBuffer(victimBuffer *buffer, uint64_t address, bool *dirty){
+	buffer->probes++;
+	*dirty = false;
+	bool hit = buffer->config.kind == VICTIM_CACHE ? InvalidateCache(&buffer->blocks, address, dirty)
+		: LookupCache(&buffer->blocks, address);
+	buffer->hits += hit;
+	return hit;
+}
+
+//@pre: a built buffer; address is a victim of the level for a victim cache,
+//      or a block filled into it for a miss cache
+//@post: the block is in the buffer, clean in a miss cache; a block a miss
+//       cache already holds is only left in place
+//@return: true if a block was evicted, its address in *evicted and whether it
+//         was dirty in *evictedDirty
+bool PutInBuffer(victimBuffer *buffer, uint64_t address, bool dirty, uint64_t *evicted, bool *evictedDirty){
+	if (buffer->config.kind == MISS_CACHE) {
+		if (ProbeCache(&buffer->blocks, address)) {
+			return false;
+		}
+		dirty = false;
+	}
+	return FillCache(&buffer->blocks, address, dirty, evicted, evictedDirty);
+}
+
+//@pre: a built buffer
+//@return: true if a victim cache holds the block of address in place of its
+//         level; the copies in a miss cache do not count
+bool HoldsVictim(const victimBuffer *buffer, uint64_t address){
+	return buffer->config.kind == VICTIM_CACHE && ProbeCache(&buffer->blocks, address);
+}
+
+//@pre: a built buffer
+//@post: the buffer no longer holds the block of address
+//@return: true if it did, and in *dirty (if not NULL) whether it was dirty
+bool InvalidateVictim(victimBuffer *buffer, uint64_t address, bool *dirty){
+	return buffer->config.kind != VICTIM_NONE && InvalidateCache(&buffer->blocks, address, dirty);
+}
+
+//@pre: a built buffer
+//@post: the block of address, if a victim cache holds it, is dirty
+//@return: true if the block was held
+bool MarkVictimDirty(victimBuffer *buffer, uint64_t address){
+	return buffer->config.kind == VICTIM_CACHE && MarkDirty(&buffer->blocks, address);
+}
@@ -0,0 +1,75 @@
+//@author: Patrick Canny, Andrew Growney, Liam Ormiston
+//@brief: Victim caches and miss caches beside a cache level
+//
+//	Description:
+//			A level may have a small fully associative LRU buffer of whole
+//			blocks beside it, looked up when the level misses (Jouppi, 1990):
+//
+//			victim -- holds the blocks the level evicts. A hit swaps the
+//			          block back into the level, and the level's victim
+//			          takes its place in the buffer. A block is in the level
+//			          or in its victim cache, never both, so the blocks the
+//			          buffer evicts are handled as the level's own victims
+//			          (written back if dirty, moved into an exclusive level
+//			          below, back-invalidated above an inclusive level).
+//			miss   -- holds a clean copy of every block filled into the
+//			          level. A hit copies the block back into the level and
+//			          the copy stays; the level's victims are handled as if
+//			          there were no buffer.
+//
+//			A hit in the buffer is counted as a hit of the level and the
+//			access goes no further down, so the level's misses are those
+//			that missed both. The buffer keeps its own probe, hit, fill and
+//			eviction counters.
+//
+
+#ifndef VICTIM_H_
+#define VICTIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cache.h"
+
+typedef enum {VICTIM_NONE = 0, VICTIM_CACHE, MISS_CACHE} victimKind;
+
+#define  Default_VictimEntries  8
+//the LRU ranks of the buffer are 8 bits
+#define  VictimEntries_Max      256
+
+//Kind and size of a level's buffer. geometry is derived from the level by
+//ConfigureVictimBuffer.
+typedef struct victimConfig
+{
+	victimKind kind;
+	uint32_t entries;
+
+	cacheConfig geometry;
+} victimConfig;
+
+typedef struct victimBuffer
+{
+	victimConfig config;
+	//a single set of entries ways
+	cacheLevel blocks;
+	//misses of the level that looked in the buffer, and the ones it served
+	uint64_t probes;
+	uint64_t hits;
+} victimBuffer;
+
+void DefaultVictimConfig(victimConfig *config);
+bool ParseVictimKind(const char *name, victimKind *kind);
+bool ParseVictimSpec(victimConfig *config, const char *spec);
+const char *VictimKindName(victimKind kind);
+bool ConfigureVictimBuffer(victimConfig *config, const cacheConfig *level);
+
+bool buildVictimBuffer(victimBuffer *buffer, const victimConfig *config);
+void destroyVictimBuffer(victimBuffer *buffer);
+
+bool TakeFromBuffer(victimBuffer *buffer, uint64_t address, bool *dirty);
+bool PutInBuffer(victimBuffer *buffer, uint64_t address, bool dirty, uint64_t *evicted, bool *evictedDirty);
+bool HoldsVictim(const victimBuffer *buffer, uint64_t address);
+bool InvalidateVictim(victimBuffer *buffer, uint64_t address, bool *dirty);
+bool MarkVictimDirty(victimBuffer *buffer, uint64_t address);
+
+#endif /* VICTIM_H_ */